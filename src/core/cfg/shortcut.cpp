@@ -53,7 +53,19 @@ const std::unordered_map<const c8*, ShortcutKey, StrHash, StrCmp>
         //
         {"redo", ShortcutKey::ACTION_REDO},
         //
-        {"unselect", ShortcutKey::ACTION_UNSELECT}};
+        {"branch", ShortcutKey::ACTION_BRANCH},
+        //
+        {"unselect", ShortcutKey::ACTION_UNSELECT},
+        //
+        {"grow_brush", ShortcutKey::ACTION_GROW_BRUSH},
+        //
+        {"shrink_brush", ShortcutKey::ACTION_SHRINK_BRUSH},
+        //
+        {"brush_shape", ShortcutKey::ACTION_BRUSH_SHAPE},
+        //
+        {"fill_mode", ShortcutKey::ACTION_FILL_MODE},
+        //
+        {"fill_scope", ShortcutKey::ACTION_FILL_SCOPE}};
 
 ShortcutKey inline convert_str_to_key_map(const c8* str) noexcept {
   auto it = str_to_key_map.find(str);
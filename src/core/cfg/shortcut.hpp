@@ -25,7 +25,13 @@ enum class ShortcutKey {
 
   ACTION_UNDO,
   ACTION_REDO,
+  ACTION_BRANCH,
   ACTION_UNSELECT,
+  ACTION_GROW_BRUSH,
+  ACTION_SHRINK_BRUSH,
+  ACTION_BRUSH_SHAPE,
+  ACTION_FILL_MODE,
+  ACTION_FILL_SCOPE,
 };
 
 class Shortcut {
@@ -6,58 +6,83 @@
  *==========================*/
 
 #include "./anim.hpp"
+#include "./pool.hpp"
 #include "math.hpp"
+#include <algorithm>
 #include <cstdio>
-#include <cstdlib>
 #include <cstring>
+#include <new>
+#include <unordered_set>
 
 namespace draw {
 
 const i32 FRAME_CAPACITY_START = 4;
 const i32 LAYER_CAPACITY_START = 4;
+// Capacity is shrunk once the count drops to 1/SHRINK_FACTOR of it
+const i32 SHRINK_FACTOR = 4;
+
+Error Anim::init(ivec size, ColorType type) noexcept {
+  this->clear();
 
-// NOTE: Too many multiplication, chance of having an overflow somewhere
-// TODO: Implement a b+ tree instead for this
-void Anim::init(ivec size, ColorType type) noexcept {
   this->type = type;
   this->size = size;
   this->frame_count = this->layer_count = 1;
   this->frame_capacity = FRAME_CAPACITY_START;
   this->layer_capacity = LAYER_CAPACITY_START;
+  this->next_frame = LAYER_CAPACITY_START;
 
-  this->next_layer = size.x * size.y * this->get_datatype_size();
-  this->next_frame = this->next_layer * LAYER_CAPACITY_START;
-  this->max_size =
-      FRAME_CAPACITY_START * LAYER_CAPACITY_START * this->next_layer;
-  // NOLINTNEXTLINE
-  this->ptr = (data_ptr)std::calloc(this->max_size, 1);
-  if (this->ptr == nullptr) {
-    // TODO: return an error instead
-    std::abort();
+  // Slots start empty, cels are only created on the first paint
+  this->cels = (Cel**)get_buffer_pool().allocate_zeroed(
+      FRAME_CAPACITY_START * LAYER_CAPACITY_START * sizeof(Cel*)
+  );
+  if (this->cels == nullptr) {
+    this->clear();
+    return Error::BAD_ALLOC;
+  }
+
+  if (type == INDEXED8) {
+    this->palette = new (std::nothrow) Palette{};
+    if (this->palette == nullptr) {
+      this->clear();
+      return Error::BAD_ALLOC;
+    }
   }
+  return Error::OK;
 }
 
-void Anim::copy(const Anim& other) noexcept {
-  // Reuse the size
-  if (!this->ptr) {
-    // NOLINTNEXTLINE
-    this->ptr = (data_ptr)std::calloc(other.max_size, 1);
-    if (this->ptr == nullptr) {
-      // TODO: return an error instead
-      std::abort();
+Error Anim::copy(const Anim& other) noexcept {
+  if (this == &other) {
+    return Error::OK;
+  }
+
+  i64 capacity = (i64)other.frame_capacity * other.layer_capacity;
+
+  // Reuse the table if it has the same capacity
+  if ((i64)this->frame_capacity * this->layer_capacity == capacity) {
+    for (i64 i = 0; i < capacity; ++i) {
+      release_cel(this->cels[i]);
     }
-  } else if (this->max_size < other.max_size) {
-    // NOLINTNEXTLINE
-    auto new_ptr = (data_ptr)std::realloc(this->ptr, other.max_size);
-    if (new_ptr == nullptr) {
-      // TODO: return an error instead
-      std::abort();
+  } else {
+    this->clear();
+    // Snapshots get a recycled table from the pool
+    this->cels = (Cel**)get_buffer_pool().allocate(capacity * sizeof(Cel*));
+    if (this->cels == nullptr) {
+      return Error::BAD_ALLOC;
     }
-    this->ptr = new_ptr;
   }
 
-  std::memcpy(this->ptr, other.ptr, other.max_size);
-  this->max_size = other.max_size;
+  // Cels are shared, these are only copied once painted on.
+  // Empty cels are dropped, these are recreated on the first paint
+  for (i64 i = 0; i < capacity; ++i) {
+    Cel* cel = other.cels[i];
+    if (cel && cel->is_empty()) {
+      cel = nullptr;
+    }
+    if (cel) {
+      cel->acquire();
+    }
+    this->cels[i] = cel;
+  }
 
   this->frame_capacity = other.frame_capacity;
   this->frame_count = other.frame_count;
@@ -65,24 +90,41 @@ void Anim::copy(const Anim& other) noexcept {
 
   this->layer_capacity = other.layer_capacity;
   this->layer_count = other.layer_count;
-  this->next_layer = other.next_layer;
 
   this->type = other.type;
   this->size = other.size;
+
+  if (other.palette) {
+    if (!this->palette) {
+      this->palette = new (std::nothrow) Palette{};
+      if (this->palette == nullptr) {
+        this->clear();
+        return Error::BAD_ALLOC;
+      }
+    }
+    *this->palette = *other.palette;
+  } else {
+    delete this->palette;
+    this->palette = nullptr;
+  }
+
+  return Error::OK;
 }
 
 Anim::Anim(Anim&& rhs) noexcept
-    : ptr(rhs.ptr),
-      max_size(rhs.max_size),
+    : cels(rhs.cels),
       frame_capacity(rhs.frame_capacity),
       frame_count(rhs.frame_count),
       next_frame(rhs.next_frame),
       layer_capacity(rhs.layer_capacity),
       layer_count(rhs.layer_count),
-      next_layer(rhs.next_layer),
       type(rhs.type),
-      size(rhs.size) {
-  rhs.ptr = nullptr;
+      size(rhs.size),
+      palette(rhs.palette),
+      tiles(std::move(rhs.tiles)) {
+  rhs.cels = nullptr;
+  rhs.palette = nullptr;
+  rhs.frame_capacity = rhs.layer_capacity = 0;
 }
 
 Anim& Anim::operator=(Anim&& rhs) noexcept {
@@ -90,10 +132,10 @@ Anim& Anim::operator=(Anim&& rhs) noexcept {
     return *this;
   }
 
-  this->ptr = rhs.ptr;
-  rhs.ptr = nullptr;
+  this->clear();
 
-  this->max_size = rhs.max_size;
+  this->cels = rhs.cels;
+  rhs.cels = nullptr;
 
   this->frame_capacity = rhs.frame_capacity;
   this->frame_count = rhs.frame_count;
@@ -101,24 +143,21 @@ Anim& Anim::operator=(Anim&& rhs) noexcept {
 
   this->layer_capacity = rhs.layer_capacity;
   this->layer_count = rhs.layer_count;
-  this->next_layer = rhs.next_layer;
+  rhs.frame_capacity = rhs.layer_capacity = 0;
 
   this->type = rhs.type;
   this->size = rhs.size;
 
+  this->palette = rhs.palette;
+  rhs.palette = nullptr;
+
+  this->tiles = std::move(rhs.tiles);
+
   return *this;
 }
 
 Anim::~Anim() noexcept {
-  if (this->ptr) {
-    // NOLINTNEXTLINE
-    std::free(this->ptr);
-    this->ptr = nullptr;
-  }
-}
-
-data_ptr Anim::get_ptr() noexcept {
-  return this->ptr;
+  this->clear();
 }
 
 ColorType Anim::get_type() const noexcept {
@@ -133,6 +172,27 @@ i32 Anim::get_layer_count() const noexcept {
   return this->layer_count;
 }
 
+Cel* Anim::get_cel(i32 frame, i32 layer) const noexcept {
+  assert(frame >= 0 && frame < this->frame_count);
+  assert(layer >= 0 && layer < this->layer_count);
+
+  // NOLINTNEXTLINE
+  return this->cels[frame * this->next_frame + layer];
+}
+
+void Anim::set_cel(i32 frame, i32 layer, Cel* cel) noexcept {
+  assert(frame >= 0 && frame < this->frame_count);
+  assert(layer >= 0 && layer < this->layer_count);
+
+  if (cel) {
+    cel->acquire();
+  }
+  // NOLINTNEXTLINE
+  Cel*& slot = this->cels[frame * this->next_frame + layer];
+  release_cel(slot);
+  slot = cel;
+}
+
 i32 Anim::get_frame_capacity() const noexcept {
   return this->frame_capacity;
 }
@@ -145,6 +205,10 @@ ivec Anim::get_size() const noexcept {
   return this->size;
 }
 
+Palette* Anim::get_palette() noexcept {
+  return this->palette;
+}
+
 i32 Anim::get_width() const noexcept {
   return this->size.x;
 }
@@ -159,176 +223,360 @@ bool Anim::has_point(ivec point) const noexcept {
 }
 
 void Anim::clear() noexcept {
-  if (this->ptr) {
-    // NOLINTNEXTLINE
-    std::free(this->ptr);
-    this->ptr = nullptr;
+  if (this->cels) {
+    i64 capacity = (i64)this->frame_capacity * this->layer_capacity;
+    for (i64 i = 0; i < capacity; ++i) {
+      release_cel(this->cels[i]);
+    }
+    get_buffer_pool().free(this->cels, capacity * sizeof(Cel*));
+    this->cels = nullptr;
   }
 
-  this->max_size = 0;
   this->frame_capacity = 0;
   this->frame_count = 0;
-  this->next_layer = 0;
+  this->next_frame = 0;
   this->layer_capacity = 0;
   this->layer_count = 0;
-  this->next_layer = 0;
   this->type = ColorType::NONE;
+
+  delete this->palette;
+  this->palette = nullptr;
+
+  this->tiles.clear();
+}
+
+void Anim::dedup_tiles() noexcept {
+  this->tiles.dedup_cels();
+}
+
+MemoryStats Anim::get_memory_stats() const noexcept {
+  MemoryStats stats{};
+  std::unordered_set<const Cel*> cels{};
+  std::unordered_set<const Tile*> tiles{};
+
+  i64 capacity = (i64)this->frame_capacity * this->layer_capacity;
+  for (i64 i = 0; i < capacity; ++i) {
+    const Cel* cel = this->cels[i];
+    if (!cel || !cels.insert(cel).second) {
+      continue;
+    }
+
+    cel->for_each_tile([&](const Tile* tile) {
+      ++stats.tile_refs;
+      if (tiles.insert(tile).second) {
+        stats.tile_bytes += cel->get_tile_bytes();
+      }
+    });
+  }
+
+  stats.cel_count = (i64)cels.size();
+  stats.tile_count = (i64)tiles.size();
+  if (stats.tile_count > 0) {
+    i64 bytes_per_tile = stats.tile_bytes / stats.tile_count;
+    stats.bytes_saved = (stats.tile_refs - stats.tile_count) * bytes_per_tile;
+    stats.dedup_ratio = (f64)stats.tile_refs / (f64)stats.tile_count;
+  }
+  return stats;
 }
 
 i32 Anim::get_datatype_size() const noexcept {
   return 0x0000'ffff & this->type;
 }
 
-void Anim::insert_frame(i32 index) noexcept {
+Error Anim::insert_frame(i32 index) noexcept {
+  return this->insert_frames(index, 1);
+}
+
+Error Anim::insert_layer(i32 index) noexcept {
+  return this->insert_layers(index, 1);
+}
+
+Error Anim::insert_frames(i32 index, i32 count) noexcept {
   assert(index >= 0 && index <= this->frame_count);
 
-  if (this->frame_count == this->frame_capacity) {
-    // TODO: May fail due to bad alloc
-    this->resize_frame(math::get_next_pow2(this->frame_capacity));
+  if (this->frame_count + count > this->frame_capacity &&
+      this->resize_frame(math::get_next_pow2(this->frame_count + count)) !=
+          Error::OK) {
+    return Error::BAD_ALLOC;
   }
 
   // NOLINTNEXTLINE
-  auto* cursor = this->ptr + index * this->next_frame;
-  i32 shift = (this->frame_count - index) * this->next_frame;
-  std::memmove(cursor + this->next_frame, cursor, shift); // Rotate
-  std::memset(cursor, 0, this->next_frame);               // Clear
+  auto* cursor = this->cels + index * this->next_frame;
+  i64 shift = (this->frame_count - index) * this->next_frame;
+  i64 size = count * this->next_frame;
+  std::memmove(cursor + size, cursor, shift * sizeof(Cel*)); // Rotate
+  std::memset(cursor, 0, size * sizeof(Cel*));               // Clear
 
-  ++this->frame_count;
+  this->frame_count += count;
+  return Error::OK;
 }
 
-void Anim::insert_layer(i32 index) noexcept {
+Error Anim::insert_layers(i32 index, i32 count) noexcept {
   assert(index >= 0 && index <= this->layer_count);
 
-  if (this->layer_count == this->layer_capacity) {
-    // TODO: May fail due to bad alloc
-    this->resize_layer(math::get_next_pow2(this->layer_capacity));
+  if (this->layer_count + count > this->layer_capacity &&
+      this->resize_layer(math::get_next_pow2(this->layer_count + count)) !=
+          Error::OK) {
+    return Error::BAD_ALLOC;
   }
 
   // NOLINTNEXTLINE
-  auto* cursor = this->ptr + index * this->next_layer;
-  i32 shift = (this->layer_count - index) * this->next_layer;
+  auto* cursor = this->cels + index;
+  i32 shift = this->layer_count - index;
   // Loop thru all the frames to add the layer
   for (i32 i = 0; i < this->frame_count; ++i) {
-    std::memmove(cursor + this->next_layer, cursor, shift); // Rotate
-    std::memset(cursor, 0, this->next_layer);               // Clear
+    std::memmove(cursor + count, cursor, shift * sizeof(Cel*)); // Rotate
+    std::memset(cursor, 0, count * sizeof(Cel*));               // Clear
     cursor += this->next_frame;
   }
 
-  ++this->layer_count;
+  this->layer_count += count;
+  return Error::OK;
 }
 
-void Anim::insert_frames(i32 index, i32 count) noexcept {
-  assert(index >= 0 && index <= this->frame_count);
+void Anim::remove_frame(i32 index) noexcept {
+  this->remove_frames(index, 1);
+}
 
-  if (this->frame_count + count > this->frame_capacity) {
-    // TODO: May fail due to bad alloc
-    this->resize_frame(math::get_next_pow2(this->frame_count + count));
-  }
+void Anim::remove_layer(i32 index) noexcept {
+  this->remove_layers(index, 1);
+}
+
+void Anim::remove_frames(i32 index, i32 count) noexcept {
+  assert(index >= 0 && count > 0 && index + count <= this->frame_count);
+  // Should always contain at least 1 frame
+  assert(count < this->frame_count);
 
   // NOLINTNEXTLINE
-  auto* cursor = this->ptr + index * this->next_frame;
-  i32 shift = (this->frame_count - index) * this->next_frame;
-  i32 size = count * this->next_frame;
-  std::memmove(cursor + size, cursor, shift);
-  std::memset(cursor, 0, size);
+  auto* cursor = this->cels + index * this->next_frame;
+  i64 size = count * this->next_frame;
+  for (i32 i = 0; i < size; ++i) {
+    release_cel(cursor[i]);
+  }
 
-  this->frame_count += count;
-}
+  i64 shift = (this->frame_count - index - count) * this->next_frame;
+  std::memmove(cursor, cursor + size, shift * sizeof(Cel*)); // Rotate
+  std::memset(cursor + shift, 0, size * sizeof(Cel*));       // Clear
 
-void Anim::insert_layers(i32 index, i32 count) noexcept {
-  assert(index >= 0 && index <= this->layer_count);
+  this->frame_count -= count;
+  this->shrink();
+}
 
-  if (this->layer_count + count > this->layer_capacity) {
-    // TODO: May fail due to bad alloc
-    this->resize_layer(math::get_next_pow2(this->layer_count + count));
-  }
+void Anim::remove_layers(i32 index, i32 count) noexcept {
+  assert(index >= 0 && count > 0 && index + count <= this->layer_count);
+  // Should always contain at least 1 layer
+  assert(count < this->layer_count);
 
   // NOLINTNEXTLINE
-  auto* cursor = this->ptr + index * this->next_layer;
-  i32 shift = (this->layer_count - index) * this->next_layer;
-  i32 size = count * this->next_layer;
-  // Loop thru all the frames to add the layer
+  auto* cursor = this->cels + index;
+  i32 shift = this->layer_count - index - count;
+  // Loop thru all the frames to remove the layer
   for (i32 i = 0; i < this->frame_count; ++i) {
-    std::memmove(cursor + size, cursor, shift); // Rotate
-    std::memset(cursor, 0, size);               // Clear
-
+    for (i32 l = 0; l < count; ++l) {
+      release_cel(cursor[l]);
+    }
+    std::memmove(cursor, cursor + count, shift * sizeof(Cel*)); // Rotate
+    std::memset(cursor + shift, 0, count * sizeof(Cel*));       // Clear
     cursor += this->next_frame;
   }
 
-  this->layer_count += count;
+  this->layer_count -= count;
+  this->shrink();
 }
 
-void Anim::resize_frame(i32 new_frame_capacity) noexcept {
+void Anim::move_frame(i32 from, i32 to) noexcept {
+  assert(from >= 0 && from < this->frame_count);
+  assert(to >= 0 && to < this->frame_count);
+
+  // Rotate the frames in between by one frame
   // NOLINTNEXTLINE
-  auto* new_ptr = (data_ptr)std::realloc(
-      // NOLINTNEXTLINE
-      this->ptr, new_frame_capacity * this->layer_capacity * this->next_layer
-  );
+  auto* first = this->cels + std::min(from, to) * this->next_frame;
+  // NOLINTNEXTLINE
+  auto* last = this->cels + (std::max(from, to) + 1) * this->next_frame;
+  if (from < to) {
+    std::rotate(first, first + this->next_frame, last);
+  } else if (from > to) {
+    std::rotate(first, last - this->next_frame, last);
+  }
+}
+
+void Anim::move_layer(i32 from, i32 to) noexcept {
+  assert(from >= 0 && from < this->layer_count);
+  assert(to >= 0 && to < this->layer_count);
 
-  if (!new_ptr) {
-    // TODO: Handle bad alloc
+  if (from == to) {
     return;
   }
 
-  if (new_ptr != this->ptr) {
-    this->ptr = new_ptr;
+  // NOLINTNEXTLINE
+  auto* first = this->cels + std::min(from, to);
+  // NOLINTNEXTLINE
+  auto* last = this->cels + std::max(from, to) + 1;
+  // Loop thru all the frames to move the layer
+  for (i32 i = 0; i < this->frame_count; ++i) {
+    if (from < to) {
+      std::rotate(first, first + 1, last);
+    } else {
+      std::rotate(first, last - 1, last);
+    }
+    first += this->next_frame;
+    last += this->next_frame;
   }
+}
 
-  // No need to shift the data, data is already placed correctly
+Error Anim::duplicate_frame(i32 index) noexcept {
+  assert(index >= 0 && index < this->frame_count);
 
-  this->frame_capacity = new_frame_capacity;
+  if (this->insert_frames(index + 1, 1) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  // Only the references are copied, cels are copied once painted on
+  // NOLINTNEXTLINE
+  auto* src_cursor = this->cels + index * this->next_frame;
+  auto* dst_cursor = src_cursor + this->next_frame;
+  for (i32 i = 0; i < this->layer_count; ++i) {
+    if (src_cursor[i]) {
+      src_cursor[i]->acquire();
+    }
+    dst_cursor[i] = src_cursor[i];
+  }
+  return Error::OK;
 }
 
-void Anim::resize_layer(i32 new_layer_capacity) noexcept {
+Error Anim::duplicate_layer(i32 index) noexcept {
+  assert(index >= 0 && index < this->layer_count);
+
+  if (this->insert_layers(index + 1, 1) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  // Only the references are copied, cels are copied once painted on
   // NOLINTNEXTLINE
-  auto* new_ptr = (data_ptr)std::realloc(
-      // NOLINTNEXTLINE
-      this->ptr, new_layer_capacity * this->frame_capacity * this->next_layer
+  auto* cursor = this->cels + index;
+  for (i32 i = 0; i < this->frame_count; ++i) {
+    if (cursor[0]) {
+      cursor[0]->acquire();
+    }
+    cursor[1] = cursor[0];
+    cursor += this->next_frame;
+  }
+  return Error::OK;
+}
+
+void Anim::shrink() noexcept {
+  // Failing to shrink is fine, the bigger table is still valid
+  if (this->frame_capacity > FRAME_CAPACITY_START &&
+      this->frame_count * SHRINK_FACTOR <= this->frame_capacity) {
+    static_cast<void>(this->resize_frame(std::max(
+        FRAME_CAPACITY_START, math::get_next_pow2(this->frame_count)
+    )));
+  }
+
+  if (this->layer_capacity > LAYER_CAPACITY_START &&
+      this->layer_count * SHRINK_FACTOR <= this->layer_capacity) {
+    static_cast<void>(this->resize_layer(std::max(
+        LAYER_CAPACITY_START, math::get_next_pow2(this->layer_count)
+    )));
+  }
+}
+
+Error Anim::resize_frame(i32 new_frame_capacity) noexcept {
+  auto* new_cels = (Cel**)get_buffer_pool().reallocate(
+      this->cels,
+      (i64)this->frame_capacity * this->layer_capacity * sizeof(Cel*),
+      (i64)new_frame_capacity * this->layer_capacity * sizeof(Cel*)
   );
 
-  if (!new_ptr) {
-    // TODO: Handle bad alloc
-    return;
+  if (!new_cels) {
+    return Error::BAD_ALLOC;
   }
 
-  if (new_ptr != this->ptr) {
-    this->ptr = new_ptr;
+  // No need to shift the slots, slots are already placed correctly
+  if (new_frame_capacity > this->frame_capacity) {
+    std::memset(
+        // NOLINTNEXTLINE
+        new_cels + (i64)this->frame_capacity * this->layer_capacity, 0,
+        (i64)(new_frame_capacity - this->frame_capacity) *
+            this->layer_capacity * sizeof(Cel*)
+    );
   }
 
-  // Shift the data
-  i32 shift = this->layer_count * this->next_layer;
-  i32 new_next_frame = this->next_layer * new_layer_capacity;
-  // NOLINTNEXTLINE
-  auto* src_cursor = this->ptr + (this->frame_count - 1) * this->next_frame;
-  // NOLINTNEXTLINE
-  auto* dst_cursor = this->ptr + (this->frame_count - 1) * new_next_frame;
-  while (src_cursor > this->ptr) {
-    std::memmove(dst_cursor, src_cursor, shift);
-    std::memset(src_cursor, 0, shift);
+  this->cels = new_cels;
+  this->frame_capacity = new_frame_capacity;
+  return Error::OK;
+}
+
+Error Anim::resize_layer(i32 new_layer_capacity) noexcept {
+  bool is_shrinking = new_layer_capacity < this->layer_capacity;
+  if (is_shrinking) {
+    // Shift the slots starting from the first frame before shrinking
+    for (i64 f = 1; f < this->frame_capacity; ++f) {
+      std::memmove(
+          // NOLINTNEXTLINE
+          this->cels + f * new_layer_capacity,
+          // NOLINTNEXTLINE
+          this->cels + f * this->layer_capacity,
+          new_layer_capacity * sizeof(Cel*)
+      );
+    }
+  }
+
+  auto* new_cels = (Cel**)get_buffer_pool().reallocate(
+      this->cels,
+      (i64)this->layer_capacity * this->frame_capacity * sizeof(Cel*),
+      (i64)new_layer_capacity * this->frame_capacity * sizeof(Cel*)
+  );
+
+  if (!new_cels) {
+    if (is_shrinking) {
+      // Keep using the bigger table, shift the slots back starting from the
+      // last frame so nothing is overwritten
+      i32 diff = this->layer_capacity - new_layer_capacity;
+      for (i64 f = this->frame_capacity - 1; f >= 0; --f) {
+        // NOLINTNEXTLINE
+        auto* src_cursor = this->cels + f * new_layer_capacity;
+        // NOLINTNEXTLINE
+        auto* dst_cursor = this->cels + f * this->layer_capacity;
+        std::memmove(dst_cursor, src_cursor, new_layer_capacity * sizeof(Cel*));
+        std::memset(dst_cursor + new_layer_capacity, 0, diff * sizeof(Cel*));
+      }
+    }
+    return Error::BAD_ALLOC;
   }
 
-  this->next_frame = new_next_frame;
+  if (new_layer_capacity > this->layer_capacity) {
+    // Shift the slots starting from the last frame, so nothing is overwritten
+    i32 diff = new_layer_capacity - this->layer_capacity;
+    for (i64 f = this->frame_capacity - 1; f >= 0; --f) {
+      // NOLINTNEXTLINE
+      auto* src_cursor = new_cels + f * this->layer_capacity;
+      // NOLINTNEXTLINE
+      auto* dst_cursor = new_cels + f * new_layer_capacity;
+      std::memmove(dst_cursor, src_cursor, this->layer_capacity * sizeof(Cel*));
+      std::memset(dst_cursor + this->layer_capacity, 0, diff * sizeof(Cel*));
+    }
+  }
+
+  this->cels = new_cels;
+  this->next_frame = new_layer_capacity;
   this->layer_capacity = new_layer_capacity;
+  return Error::OK;
 }
 
 void Anim::print() const noexcept {
-  auto* curr_ptr = this->ptr;
   for (i32 f = 0; f < this->frame_count; ++f) {
+    // NOLINTNEXTLINE
+    const auto* cel = this->cels[f * this->next_frame];
     for (i32 y = 0; y < this->size.y; ++y) {
       printf("%3dy: ", y);
       for (i32 x = 0; x < this->size.x; ++x) {
-        printf(
-            "%08X ",
-            // NOLINTNEXTLINE
-            curr_ptr[(x + y * this->size.x) * this->get_datatype_size()]
-        );
+        printf("%08X ", cel ? *(const u32*)cel->get_pixel({x, y}) : 0U);
       }
       printf("\n");
     }
     printf("=== \n");
-    curr_ptr += this->next_frame;
   }
 }
 
 } // namespace draw
-
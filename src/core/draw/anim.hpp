@@ -8,13 +8,29 @@
 #ifndef PXL_DRAW_ANIM_HPP
 #define PXL_DRAW_ANIM_HPP
 
+#include "./cel.hpp"
 #include "./frame.hpp"
+#include "./palette.hpp"
+#include "./tile_table.hpp"
 #include "./types.hpp"
 #include "types.hpp"
 #include <cassert>
 
 namespace draw {
 
+struct MemoryStats {
+  // Unique cels and tiles, shared ones are only counted once
+  i64 cel_count = 0;
+  i64 tile_count = 0;
+  // How many times the tiles are referenced by the cels
+  i64 tile_refs = 0;
+  i64 tile_bytes = 0;
+  // Bytes that would be used if none of the tiles were shared
+  i64 bytes_saved = 0;
+  // tile_refs / tile_count, 1.0 if nothing is shared
+  f64 dedup_ratio = 1.0;
+};
+
 // NOTE: have a file cache in the future
 /**
  * Contains the animation data
@@ -29,16 +45,28 @@ public:
 
   ~Anim() noexcept;
 
-  void init(ivec size, ColorType type) noexcept;
-  void copy(const Anim& other) noexcept;
+  Error init(ivec size, ColorType type) noexcept;
+
+  // Shares the cels of the other animation, cels are copied on write
+  Error copy(const Anim& other) noexcept;
+
+  /**
+   * Shares identical tiles across all the frames and layers.
+   * Only the cels written to through a layer since the last call are
+   * visited, and only their new tiles are hashed
+   **/
+  void dedup_tiles() noexcept;
+
+  [[nodiscard]] MemoryStats get_memory_stats() const noexcept;
 
-  [[nodiscard]] data_ptr get_ptr() noexcept;
   [[nodiscard]] ColorType get_type() const noexcept;
   [[nodiscard]] i32 get_frame_count() const noexcept;
   [[nodiscard]] i32 get_layer_count() const noexcept;
   [[nodiscard]] i32 get_frame_capacity() const noexcept;
   [[nodiscard]] i32 get_layer_capacity() const noexcept;
   [[nodiscard]] ivec get_size() const noexcept;
+  // nullptr if the animation is not INDEXED8
+  [[nodiscard]] Palette* get_palette() noexcept;
   [[nodiscard]] i32 get_width() const noexcept;
   [[nodiscard]] i32 get_height() const noexcept;
 
@@ -49,20 +77,46 @@ public:
 
   void clear() noexcept;
 
-  void insert_frame(i32 index) noexcept;
-  void insert_layer(i32 index) noexcept;
+  Error insert_frame(i32 index) noexcept;
+  Error insert_layer(i32 index) noexcept;
 
   // Inserts (count) number of frames at the index
-  void insert_frames(i32 index, i32 count) noexcept;
+  Error insert_frames(i32 index, i32 count) noexcept;
   // Inserts (count) number of layers at the index
-  void insert_layers(i32 index, i32 count) noexcept;
+  Error insert_layers(i32 index, i32 count) noexcept;
+
+  void remove_frame(i32 index) noexcept;
+  void remove_layer(i32 index) noexcept;
+
+  // Removes (count) number of frames starting from the index
+  void remove_frames(i32 index, i32 count) noexcept;
+  // Removes (count) number of layers starting from the index
+  void remove_layers(i32 index, i32 count) noexcept;
+
+  // Moves the frame at from, so it ends up at the to index
+  void move_frame(i32 from, i32 to) noexcept;
+  // Moves the layer at from, so it ends up at the to index
+  void move_layer(i32 from, i32 to) noexcept;
+
+  /**
+   * Inserts a copy of the frame after it. The copy shares the cels of the
+   * original frame until any of them is painted on.
+   **/
+  Error duplicate_frame(i32 index) noexcept;
+
+  /**
+   * Inserts a copy of the layer after it. The copy shares the cels of the
+   * original layer until any of them is painted on.
+   **/
+  Error duplicate_layer(i32 index) noexcept;
 
   [[nodiscard]] Frame get_frame(i32 index) noexcept {
     assert(index >= 0 && index < this->frame_count);
 
-    return Frame{// NOLINTNEXTLINE
-                 this->ptr + index * this->next_frame, this->next_layer,
-                 this->size, this->type};
+    return Frame{
+        // NOLINTNEXTLINE
+        this->cels + index * this->next_frame, this->layer_count, this->size,
+        this->type, this->palette, &this->tiles};
   }
 
   [[nodiscard]] Layer get_layer(i32 frame, i32 layer) noexcept {
@@ -71,37 +125,49 @@ public:
 
     return Layer{
         // NOLINTNEXTLINE
-        this->ptr + frame * this->next_frame + layer * this->next_layer,
-        this->size, this->type};
+        this->cels + frame * this->next_frame + layer, this->size, this->type,
+        this->palette, &this->tiles};
   }
 
+  // Cel of a frame and layer, nullptr if nothing was painted on it
+  [[nodiscard]] Cel* get_cel(i32 frame, i32 layer) const noexcept;
+
+  /**
+   * Shares the cel with the frame and layer, releasing the previous cel.
+   * nullptr makes the cel empty
+   **/
+  void set_cel(i32 frame, i32 layer, Cel* cel) noexcept;
+
   // === Debugging === //
   void print() const noexcept;
 
 private:
-  // NOTE: check if there is a need for multiple data pointers
-  data_ptr ptr = nullptr;
-  i32 max_size = 0;
-  // how many frames can fit in the total allocated memory
+  // Indirection table of frame_capacity * layer_capacity cel slots, grouped by
+  // frame. Empty slots (nullptr) are treated as transparent cels, structural
+  // changes only shuffle these pointers around.
+  Cel** cels = nullptr;
+  // how many frames can fit in the table
   i32 frame_capacity = 0;
   i32 frame_count = 0;
-  // what to add to get the next frame data
-  i32 next_frame = 0;
-  // how many layers can fit in the total allocated memory
+  // what to add to get the next frame slots
+  i64 next_frame = 0;
+  // how many layers can fit in the table
   i32 layer_capacity = 0;
   i32 layer_count = 0;
-  // what to add to get the next layer data
-  i32 next_layer = 0;
   ColorType type = ColorType::NONE;
   ivec size{};
+  // Only allocated for INDEXED8, kept on the heap so layers stay valid
+  Palette* palette = nullptr;
+  // Tiles shared by dedup_tiles(), not copied by copy()
+  TileTable tiles{};
 
   [[nodiscard]] i32 get_datatype_size() const noexcept;
 
   // === Resize Logic === //
-  // TODO: May error, bad alloc
-  void resize_frame(i32 new_frame_capacity) noexcept;
-  // TODO: May error, bad alloc
-  void resize_layer(i32 new_layer_capacity) noexcept;
+  // Shrinks the table if the counts are too far below the capacities
+  void shrink() noexcept;
+  Error resize_frame(i32 new_frame_capacity) noexcept;
+  Error resize_layer(i32 new_layer_capacity) noexcept;
 };
 
 } // namespace draw
@@ -0,0 +1,499 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./cel.hpp"
+#include "./color.hpp"
+#include "./pool.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace draw {
+
+alignas(64) const u8 ZERO_TILE[TILE_SIZE * TILE_SIZE * MAX_PIXEL_SIZE]{};
+
+void Cel::init(ivec size, ColorType type) noexcept {
+  this->clear();
+  this->size = size;
+  this->type = type;
+  this->bounds = {};
+  this->loose_bounds = false;
+  this->tiles_size = {
+      .x = (size.x + TILE_MASK) >> TILE_SHIFT,
+      .y = (size.y + TILE_MASK) >> TILE_SHIFT};
+}
+
+Error Cel::copy(const Cel& other) noexcept {
+  this->init(other.size, other.type);
+  this->bounds = other.bounds;
+  this->loose_bounds = other.loose_bounds;
+  if (!other.tiles) {
+    return Error::OK;
+  }
+
+  if (this->allocate_table() != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  i32 count = this->tiles_size.x * this->tiles_size.y;
+  for (i32 i = 0; i < count; ++i) {
+    if (other.tiles[i]) {
+      ++other.tiles[i]->refs;
+    }
+    this->tiles[i] = other.tiles[i];
+  }
+  // Tiles the other cel did not dedup yet
+  this->written = other.written;
+  return Error::OK;
+}
+
+Cel::~Cel() noexcept {
+  if (this->table) {
+    this->table->remove_cel(this);
+  }
+  this->clear();
+}
+
+void Cel::clear() noexcept {
+  if (!this->tiles) {
+    return;
+  }
+
+  i32 count = this->tiles_size.x * this->tiles_size.y;
+  for (i32 i = 0; i < count; ++i) {
+    this->release_tile(this->tiles[i]);
+  }
+  get_buffer_pool().free(this->tiles, (i64)count * sizeof(Tile*));
+  this->tiles = nullptr;
+  this->bounds = {};
+  this->loose_bounds = false;
+  this->written.clear();
+}
+
+ivec Cel::get_size() const noexcept {
+  return this->size;
+}
+
+ColorType Cel::get_type() const noexcept {
+  return this->type;
+}
+
+i32 Cel::get_refs() const noexcept {
+  return this->refs;
+}
+
+bool Cel::is_shared() const noexcept {
+  return this->refs > 1;
+}
+
+void Cel::acquire() noexcept {
+  ++this->refs;
+}
+
+bool Cel::release() noexcept {
+  assert(this->refs > 0);
+  return --this->refs == 0;
+}
+
+i32 Cel::get_tile_count() const noexcept {
+  if (!this->tiles) {
+    return 0;
+  }
+
+  i32 count = this->tiles_size.x * this->tiles_size.y;
+  i32 allocated = 0;
+  for (i32 i = 0; i < count; ++i) {
+    allocated += this->tiles[i] != nullptr;
+  }
+  return allocated;
+}
+
+irect Cel::get_bounds() noexcept {
+  if (this->loose_bounds) {
+    this->fit_bounds();
+  }
+  return this->bounds;
+}
+
+bool Cel::is_empty() noexcept {
+  return this->get_bounds().w == 0;
+}
+
+void Cel::update_bounds(ivec pos) noexcept {
+  this->update_bounds(pos, 1);
+}
+
+void Cel::update_bounds(ivec pos, i32 width) noexcept {
+  auto& bounds = this->bounds;
+  bool in_rows = pos.y >= bounds.y && pos.y < bounds.y + bounds.h;
+
+  if (this->is_transparent(this->get_pixel(pos))) {
+    // Only shrink the bounds once these are needed
+    this->loose_bounds =
+        this->loose_bounds || (in_rows && pos.x < bounds.x + bounds.w &&
+                               pos.x + width > bounds.x);
+    return;
+  }
+
+  if (in_rows && pos.x >= bounds.x &&
+      pos.x + width <= bounds.x + bounds.w) {
+    return;
+  }
+
+  if (bounds.w == 0) {
+    bounds = {.x = pos.x, .y = pos.y, .w = width, .h = 1};
+    return;
+  }
+
+  i32 x2 = std::max(bounds.x + bounds.w, pos.x + width);
+  i32 y2 = std::max(bounds.y + bounds.h, pos.y + 1);
+  bounds.x = std::min(bounds.x, pos.x);
+  bounds.y = std::min(bounds.y, pos.y);
+  bounds.w = x2 - bounds.x;
+  bounds.h = y2 - bounds.y;
+}
+
+void Cel::fit_bounds() noexcept {
+  irect old = this->bounds;
+  this->bounds = {};
+  this->loose_bounds = false;
+  if (!this->tiles || old.w == 0) {
+    return;
+  }
+
+  ivec min{old.x + old.w, old.y + old.h};
+  ivec max{-1, -1};
+  for (i32 ty = old.y >> TILE_SHIFT; ty <= (old.y + old.h - 1) >> TILE_SHIFT;
+       ++ty) {
+    for (i32 tx = old.x >> TILE_SHIFT;
+         tx <= (old.x + old.w - 1) >> TILE_SHIFT; ++tx) {
+      // Untouched tiles are fully transparent
+      if (!this->tiles[tx + ty * this->tiles_size.x]) {
+        continue;
+      }
+
+      i32 x1 = std::max(old.x, tx << TILE_SHIFT);
+      i32 x2 = std::min(old.x + old.w, (tx + 1) << TILE_SHIFT);
+      i32 y1 = std::max(old.y, ty << TILE_SHIFT);
+      i32 y2 = std::min(old.y + old.h, (ty + 1) << TILE_SHIFT);
+      for (i32 y = y1; y < y2; ++y) {
+        for (i32 x = x1; x < x2; ++x) {
+          if (!this->is_transparent(this->get_pixel({x, y}))) {
+            min = {std::min(min.x, x), std::min(min.y, y)};
+            max = {std::max(max.x, x), std::max(max.y, y)};
+          }
+        }
+      }
+    }
+  }
+
+  if (max.x >= 0) {
+    this->bounds = {
+        .x = min.x, .y = min.y, .w = max.x - min.x + 1, .h = max.y - min.y + 1};
+  }
+}
+
+void Cel::dedup_tiles(TileTable& table) noexcept {
+  if (!this->tiles) {
+    this->written.clear();
+    return;
+  }
+
+  i32 bytes = this->get_tile_bytes();
+  for (i32 i : this->written) {
+    Tile* tile = this->tiles[i];
+    // Interned tiles were already checked
+    if (!tile || tile->table) {
+      continue;
+    }
+
+    if (std::memcmp(tile->get_ptr(), ZERO_TILE, bytes) == 0) {
+      this->release_tile(tile);
+      this->tiles[i] = nullptr;
+      continue;
+    }
+
+    Tile* shared = table.intern(tile, bytes);
+    if (shared != tile) {
+      ++shared->refs;
+      this->release_tile(tile);
+      this->tiles[i] = shared;
+    }
+  }
+  this->written.clear();
+}
+
+ivec Cel::get_tiles_size() const noexcept {
+  return this->tiles_size;
+}
+
+Tile* Cel::get_tile(i32 index) const noexcept {
+  assert(index >= 0 && index < this->tiles_size.x * this->tiles_size.y);
+  return this->tiles ? this->tiles[index] : nullptr;
+}
+
+Error Cel::set_tile(i32 index, Tile* tile) noexcept {
+  assert(index >= 0 && index < this->tiles_size.x * this->tiles_size.y);
+  if (tile == this->get_tile(index)) {
+    return Error::OK;
+  }
+
+  if (this->allocate_table() != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  if (tile) {
+    ++tile->refs;
+    if (!tile->table) {
+      this->written.push_back(index);
+    }
+  }
+  this->release_tile(this->tiles[index]);
+  this->tiles[index] = tile;
+
+  // Only grow the bounds here, these are fitted once needed
+  i32 x = (index % this->tiles_size.x) << TILE_SHIFT;
+  i32 y = (index / this->tiles_size.x) << TILE_SHIFT;
+  irect rect{
+      .x = x,
+      .y = y,
+      .w = std::min(TILE_SIZE, this->size.x - x),
+      .h = std::min(TILE_SIZE, this->size.y - y)};
+
+  auto& bounds = this->bounds;
+  if (bounds.w == 0) {
+    bounds = rect;
+  } else {
+    i32 x2 = std::max(bounds.x + bounds.w, rect.x + rect.w);
+    i32 y2 = std::max(bounds.y + bounds.h, rect.y + rect.h);
+    bounds.x = std::min(bounds.x, rect.x);
+    bounds.y = std::min(bounds.y, rect.y);
+    bounds.w = x2 - bounds.x;
+    bounds.h = y2 - bounds.y;
+  }
+  this->loose_bounds = true;
+  return Error::OK;
+}
+
+i32 Cel::get_pixel_size() const noexcept {
+  return 0x0000'ffff & this->type;
+}
+
+i32 Cel::get_tile_bytes() const noexcept {
+  return TILE_SIZE * TILE_SIZE * this->get_pixel_size();
+}
+
+i32 Cel::get_tile_index(ivec pos) const noexcept {
+  return (pos.x >> TILE_SHIFT) + (pos.y >> TILE_SHIFT) * this->tiles_size.x;
+}
+
+i64 Cel::get_tile_offset(ivec pos) const noexcept {
+  return (i64)((pos.x & TILE_MASK) + (pos.y & TILE_MASK) * TILE_SIZE) *
+         this->get_pixel_size();
+}
+
+bool Cel::is_tile_in_bounds(i32 tx, i32 ty) const noexcept {
+  const auto& bounds = this->bounds;
+  return bounds.w > 0 && (tx << TILE_SHIFT) < bounds.x + bounds.w &&
+         ((tx + 1) << TILE_SHIFT) > bounds.x &&
+         (ty << TILE_SHIFT) < bounds.y + bounds.h &&
+         ((ty + 1) << TILE_SHIFT) > bounds.y;
+}
+
+bool Cel::is_transparent(const_data_ptr pixel) const noexcept {
+  if (this->type == INDEXED8) {
+    // NOLINTNEXTLINE
+    return pixel[0] == 0U;
+  }
+
+  // Alpha is the last channel of the pixel
+  i32 pixel_size = this->get_pixel_size();
+  for (i32 i = pixel_size - pixel_size / 4; i < pixel_size; ++i) {
+    // NOLINTNEXTLINE
+    if (pixel[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const_data_ptr Cel::get_pixel(ivec pos) const noexcept {
+  assert(
+      pos.x >= 0 && pos.y >= 0 && pos.x < this->size.x && pos.y < this->size.y
+  );
+
+  const Tile* tile =
+      this->tiles ? this->tiles[this->get_tile_index(pos)] : nullptr;
+  // NOLINTNEXTLINE
+  return (tile ? tile->get_ptr() : ZERO_TILE) + this->get_tile_offset(pos);
+}
+
+data_ptr Cel::get_pixel_for_write(ivec pos) noexcept {
+  assert(
+      pos.x >= 0 && pos.y >= 0 && pos.x < this->size.x && pos.y < this->size.y
+  );
+
+  i32 index = this->get_tile_index(pos);
+  Tile* tile = this->tiles ? this->tiles[index] : nullptr;
+  if (!tile) {
+    tile = this->allocate_tile(index);
+    if (!tile) {
+      return nullptr;
+    }
+  } else if (tile->refs > 1) {
+    // Copy on write, the other owners keep the old tile
+    Tile* shared = tile;
+    tile = this->allocate_tile(index);
+    if (!tile) {
+      return nullptr;
+    }
+    std::memcpy(tile->get_ptr(), shared->get_ptr(), this->get_tile_bytes());
+    this->release_tile(shared);
+  }
+  // NOLINTNEXTLINE
+  return tile->get_ptr() + this->get_tile_offset(pos);
+}
+
+template <typename CopyRow>
+void Cel::copy_rows(
+    data_ptr dst, i64 dst_pixel_size, i64 pitch, irect rect,
+    CopyRow&& copy_row
+) const noexcept {
+  assert(
+      rect.x >= 0 && rect.y >= 0 && rect.w > 0 && rect.h > 0 &&
+      rect.x + rect.w <= this->size.x && rect.y + rect.h <= this->size.y
+  );
+  i64 pixel_size = this->get_pixel_size();
+  i32 right = rect.x + rect.w;
+  i32 bottom = rect.y + rect.h;
+
+  for (i32 ty = rect.y >> TILE_SHIFT; (ty << TILE_SHIFT) < bottom; ++ty) {
+    i32 top = std::max(rect.y, ty << TILE_SHIFT);
+    i32 rows = std::min(bottom, (ty + 1) << TILE_SHIFT) - top;
+    for (i32 tx = rect.x >> TILE_SHIFT; (tx << TILE_SHIFT) < right; ++tx) {
+      i32 left = std::max(rect.x, tx << TILE_SHIFT);
+      i32 width = std::min(right, (tx + 1) << TILE_SHIFT) - left;
+      // Tiles outside the bounds are only transparent pixels
+      const Tile* tile = this->tiles && this->is_tile_in_bounds(tx, ty)
+                             ? this->tiles[tx + ty * this->tiles_size.x]
+                             : nullptr;
+      // NOLINTNEXTLINE
+      data_ptr cursor = dst + (top - rect.y) * pitch +
+                        (left - rect.x) * dst_pixel_size;
+      i64 offset = (((top & (TILE_SIZE - 1)) << TILE_SHIFT) +
+                    (left & (TILE_SIZE - 1))) *
+                   pixel_size;
+      // NOLINTNEXTLINE
+      const_data_ptr src = tile ? tile->get_ptr() + offset : nullptr;
+
+      for (i32 y = 0; y < rows; ++y) {
+        copy_row(cursor, src, width);
+        cursor += pitch;
+        if (src) {
+          src += TILE_SIZE * pixel_size;
+        }
+      }
+    }
+  }
+}
+
+void Cel::get_pixels(data_ptr dst) const noexcept {
+  i64 pixel_size = this->get_pixel_size();
+  this->copy_rows(
+      dst, pixel_size, this->size.x * pixel_size,
+      {0, 0, this->size.x, this->size.y},
+      [pixel_size](data_ptr row, const_data_ptr src, i32 width) {
+        if (src) {
+          std::memcpy(row, src, width * pixel_size);
+        } else {
+          std::memset(row, 0, width * pixel_size);
+        }
+      }
+  );
+}
+
+void Cel::get_rgba8_pixels(rgba8* dst, const rgba8* palette) const noexcept {
+  this->get_rgba8_pixels(
+      dst, this->size.x * (i64)sizeof(rgba8),
+      {0, 0, this->size.x, this->size.y}, palette
+  );
+}
+
+void Cel::get_rgba8_pixels(
+    rgba8* dst, i64 pitch, irect rect, const rgba8* palette
+) const noexcept {
+  if (this->type == RGBA8) {
+    this->copy_rows(
+        (data_ptr)dst, sizeof(rgba8), pitch, rect,
+        [](data_ptr row, const_data_ptr src, i32 width) {
+          if (src) {
+            std::memcpy(row, src, width * sizeof(rgba8));
+          } else {
+            std::memset(row, 0, width * sizeof(rgba8));
+          }
+        }
+    );
+    return;
+  }
+
+  if (this->type == INDEXED8) {
+    assert(palette != nullptr);
+    this->copy_rows(
+        (data_ptr)dst, sizeof(rgba8), pitch, rect,
+        [palette](data_ptr row, const_data_ptr src, i32 width) {
+          if (src) {
+            to_rgba8(src, (rgba8*)row, width, palette);
+          } else {
+            std::memset(row, 0, width * sizeof(rgba8));
+          }
+        }
+    );
+    return;
+  }
+
+  assert(this->type == RGBA16);
+  this->copy_rows(
+      (data_ptr)dst, sizeof(rgba8), pitch, rect,
+      [](data_ptr row, const_data_ptr src, i32 width) {
+        if (src) {
+          to_rgba8((const rgba16*)src, (rgba8*)row, width);
+        } else {
+          std::memset(row, 0, width * sizeof(rgba8));
+        }
+      }
+  );
+}
+
+Error Cel::allocate_table() noexcept {
+  if (this->tiles) {
+    return Error::OK;
+  }
+
+  this->tiles = (Tile**)get_buffer_pool().allocate_zeroed(
+      (i64)this->tiles_size.x * this->tiles_size.y * sizeof(Tile*)
+  );
+  return this->tiles ? Error::OK : Error::BAD_ALLOC;
+}
+
+Tile* Cel::allocate_tile(i32 index) noexcept {
+  if (this->allocate_table() != Error::OK) {
+    return nullptr;
+  }
+
+  Tile* tile = get_tile_store().allocate(this->get_tile_bytes());
+  if (tile == nullptr) {
+    return nullptr;
+  }
+  this->tiles[index] = tile;
+  this->written.push_back(index);
+  return tile;
+}
+
+void Cel::release_tile(Tile* tile) noexcept {
+  draw::release_tile(tile, this->get_tile_bytes());
+}
+
+} // namespace draw
@@ -0,0 +1,214 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_CEL_HPP
+#define PXL_DRAW_CEL_HPP
+
+#include "./store.hpp"
+#include "./tile_table.hpp"
+#include "./types.hpp"
+#include "types.hpp"
+#include <cassert>
+#include <vector>
+
+namespace draw {
+
+// Shared by all untouched tiles, should never be written to
+extern const u8 ZERO_TILE[TILE_SIZE * TILE_SIZE * MAX_PIXEL_SIZE];
+
+/**
+ * Pixel data of a layer in a frame.
+ * The pixels are split into tiles which are only allocated on the first
+ * write, untouched tiles are read from a shared read-only zero tile.
+ *
+ * Cels are reference counted so frames and snapshots can share them,
+ * use acquire() and release_cel() instead of deleting them directly.
+ *
+ * The bounds of the non-transparent pixels are tracked on every write so
+ * empty regions can be skipped when reading the whole cel.
+ **/
+class Cel {
+public:
+  Cel() noexcept = default;
+  Cel(const Cel&) noexcept = delete;
+  Cel& operator=(const Cel&) noexcept = delete;
+  Cel(Cel&&) noexcept = delete;
+  Cel& operator=(Cel&&) noexcept = delete;
+  ~Cel() noexcept;
+
+  void init(ivec size, ColorType type) noexcept;
+
+  /**
+   * Shares the tiles of the other cel, tiles are only copied once they are
+   * written to
+   **/
+  Error copy(const Cel& other) noexcept;
+
+  // Frees all the tiles, cel is treated as empty
+  void clear() noexcept;
+
+  [[nodiscard]] ivec get_size() const noexcept;
+  [[nodiscard]] ColorType get_type() const noexcept;
+
+  // === Reference Counting === //
+
+  [[nodiscard]] i32 get_refs() const noexcept;
+  [[nodiscard]] bool is_shared() const noexcept;
+  void acquire() noexcept;
+
+  /**
+   * Removes a reference of the cel.
+   * Returns true if it was the last reference and the cel can be deleted
+   **/
+  [[nodiscard]] bool release() noexcept;
+
+  // Number of tiles that are allocated
+  [[nodiscard]] i32 get_tile_count() const noexcept;
+  [[nodiscard]] i32 get_tile_bytes() const noexcept;
+
+  // Calls fn(tile) for every allocated tile
+  template <typename Fn> void for_each_tile(Fn&& fn) const noexcept {
+    if (!this->tiles) {
+      return;
+    }
+
+    i32 count = this->tiles_size.x * this->tiles_size.y;
+    for (i32 i = 0; i < count; ++i) {
+      if (this->tiles[i]) {
+        fn((const Tile*)this->tiles[i]);
+      }
+    }
+  }
+
+  /**
+   * Shares the tiles written to since the last call with the identical
+   * tiles in the table, tiles that are fully zeroed are released
+   **/
+  void dedup_tiles(TileTable& table) noexcept;
+
+  // === Tile Access === //
+
+  // How many tiles horizontally and vertically
+  [[nodiscard]] ivec get_tiles_size() const noexcept;
+
+  // Returns the tile at the index, nullptr if it is untouched
+  [[nodiscard]] Tile* get_tile(i32 index) const noexcept;
+
+  /**
+   * Shares the tile at the index, nullptr makes the tile untouched again.
+   * The bounds are loosened to cover the tile.
+   * Errors if the table of the tiles could not be allocated
+   **/
+  Error set_tile(i32 index, Tile* tile) noexcept;
+
+  // === Content Bounds === //
+
+  /**
+   * Returns the smallest rect containing all the non-transparent pixels,
+   * the size is 0 if the cel is empty.
+   * Bounds loosened by erasing are fitted again on this call
+   **/
+  [[nodiscard]] irect get_bounds() noexcept;
+  [[nodiscard]] bool is_empty() noexcept;
+
+  /**
+   * Updates the bounds after the pixel at pos was written to.
+   * Call this after writing through get_pixel_for_write()
+   **/
+  void update_bounds(ivec pos) noexcept;
+
+  // Same as update_bounds() for a row of width pixels of the same color
+  void update_bounds(ivec pos, i32 width) noexcept;
+
+  // Returns the pixel at a specific pos, may point to the zero tile
+  [[nodiscard]] const_data_ptr get_pixel(ivec pos) const noexcept;
+
+  /**
+   * Returns a writable pixel at a specific pos, allocating the tile
+   * if it is still untouched or copying it if it is shared.
+   * Returns nullptr if the tile could not be allocated
+   **/
+  [[nodiscard]] data_ptr get_pixel_for_write(ivec pos) noexcept;
+
+  /**
+   * Copies the whole cel into a contiguous buffer (width * height pixels)
+   **/
+  void get_pixels(data_ptr dst) const noexcept;
+
+  /**
+   * Same as get_pixels() but converts the pixels to rgba8.
+   * @param palette - only needed for INDEXED8 cels
+   **/
+  void get_rgba8_pixels(
+      rgba8* dst, const rgba8* palette = nullptr
+  ) const noexcept;
+
+  /**
+   * Same as get_rgba8_pixels() but only for the pixels in the rect,
+   * dst points to the top left of the rect and its rows are pitch bytes apart
+   **/
+  void get_rgba8_pixels(
+      rgba8* dst, i64 pitch, irect rect, const rgba8* palette = nullptr
+  ) const noexcept;
+
+private:
+  // nullptr if all the tiles are untouched
+  Tile** tiles = nullptr;
+  ivec size{};
+  // how many tiles horizontally and vertically
+  ivec tiles_size{};
+  ColorType type = ColorType::NONE;
+  i32 refs = 1;
+
+  // May be bigger than the content if loose_bounds is set
+  irect bounds{};
+  bool loose_bounds = false;
+
+  // Table the cel is queued in for dedup, see TileTable::add_cel()
+  TileTable* table = nullptr;
+  i32 table_index = -1;
+  // Tiles allocated or set since the last dedup_tiles(), may repeat
+  std::vector<i32> written{};
+
+  [[nodiscard]] i32 get_pixel_size() const noexcept;
+  [[nodiscard]] i32 get_tile_index(ivec pos) const noexcept;
+  [[nodiscard]] i64 get_tile_offset(ivec pos) const noexcept;
+  [[nodiscard]] bool is_tile_in_bounds(i32 tx, i32 ty) const noexcept;
+  [[nodiscard]] bool is_transparent(const_data_ptr pixel) const noexcept;
+
+  void fit_bounds() noexcept;
+
+  /**
+   * Calls copy_row(dst_row, src_row, width) for every row of every tile in
+   * the rect, src_row is nullptr if the tile only has transparent pixels.
+   * dst points to the top left of the rect
+   **/
+  template <typename CopyRow>
+  void copy_rows(
+      data_ptr dst, i64 dst_pixel_size, i64 pitch, irect rect,
+      CopyRow&& copy_row
+  ) const noexcept;
+
+  Error allocate_table() noexcept;
+  // Returns nullptr on bad alloc
+  [[nodiscard]] Tile* allocate_tile(i32 index) noexcept;
+  void release_tile(Tile* tile) noexcept;
+
+  friend class TileTable;
+};
+
+// Releases a reference of the cel, deletes it if it was the last one
+inline void release_cel(Cel* cel) noexcept {
+  if (cel && cel->release()) {
+    delete cel;
+  }
+}
+
+} // namespace draw
+
+#endif
+
@@ -0,0 +1,91 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./color.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The build only assumes SSE2, AVX2 is picked once the cpu is known
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PXL_AVX2_DISPATCH
+#endif
+
+namespace draw {
+
+void to_rgba8(const rgba16* src, rgba8* dst, i64 count) noexcept {
+  // Only the high byte of each channel is kept
+  const auto* in = (const u16*)src;
+  auto* out = (u8*)dst;
+  i64 channels = count * 4;
+  i64 i = 0;
+
+#ifdef __SSE2__
+  // 4 pixels per iteration
+  for (; i + 16 <= channels; i += 16) {
+    // NOLINTNEXTLINE
+    __m128i lo = _mm_loadu_si128((const __m128i*)(in + i));
+    // NOLINTNEXTLINE
+    __m128i hi = _mm_loadu_si128((const __m128i*)(in + i + 8));
+    lo = _mm_srli_epi16(lo, 8);
+    hi = _mm_srli_epi16(hi, 8);
+    // NOLINTNEXTLINE
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+
+  for (; i < channels; ++i) {
+    // NOLINTNEXTLINE
+    out[i] = (u8)(in[i] >> 8);
+  }
+}
+
+#ifdef PXL_AVX2_DISPATCH
+[[nodiscard]] inline bool has_avx2() noexcept {
+  static const bool supported =
+      (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+  return supported;
+}
+
+// Gathers 8 colors from the palette per iteration, returns the pixels done
+__attribute__((target("avx2"))) i64 gather_rgba8(
+    const u8* src, rgba8* dst, i64 count, const rgba8* palette
+) noexcept {
+  i64 i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // NOLINTNEXTLINE
+    __m128i indices = _mm_loadl_epi64((const __m128i*)(src + i));
+    __m256i colors = _mm256_i32gather_epi32(
+        (const int*)palette, _mm256_cvtepu8_epi32(indices), sizeof(rgba8)
+    );
+    // NOLINTNEXTLINE
+    _mm256_storeu_si256((__m256i*)(dst + i), colors);
+  }
+  return i;
+}
+#endif
+
+void to_rgba8(
+    const u8* src, rgba8* dst, i64 count, const rgba8* palette
+) noexcept {
+  i64 i = 0;
+
+#ifdef PXL_AVX2_DISPATCH
+  if (has_avx2()) {
+    i = gather_rgba8(src, dst, count, palette);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    // NOLINTNEXTLINE
+    dst[i] = palette[src[i]];
+  }
+}
+
+} // namespace draw
@@ -0,0 +1,74 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_COLOR_HPP
+#define PXL_DRAW_COLOR_HPP
+
+#include "./types.hpp"
+#include "types.hpp"
+
+namespace draw {
+
+// Maps a pixel type to its ColorType
+template <typename Color> struct ColorTraits;
+
+template <> struct ColorTraits<rgba8> {
+  static constexpr ColorType TYPE = RGBA8;
+};
+
+template <> struct ColorTraits<rgba16> {
+  static constexpr ColorType TYPE = RGBA16;
+};
+
+template <> struct ColorTraits<u8> {
+  static constexpr ColorType TYPE = INDEXED8;
+};
+
+/**
+ * Calls fn with a zeroed pixel of the color type, eg. fn(rgba16{}).
+ * Branch once here so the loops inside fn are specialized per color type
+ **/
+template <typename Fn> decltype(auto) visit(ColorType type, Fn&& fn) noexcept {
+  switch (type) {
+  case RGBA16:
+    return fn(rgba16{});
+
+  case INDEXED8:
+    return fn(u8{});
+
+  case RGBA8:
+  default:
+    return fn(rgba8{});
+  }
+}
+
+/**
+ * Converts a color from the ui to the color type of a layer.
+ * Indexed colors need the palette, use Layer::to_color() instead
+ **/
+template <typename Color> [[nodiscard]] Color from_rgba8(rgba8 color) noexcept;
+
+template <> [[nodiscard]] inline rgba8 from_rgba8(rgba8 color) noexcept {
+  return color;
+}
+
+template <> [[nodiscard]] inline rgba16 from_rgba8(rgba8 color) noexcept {
+  // 0xff -> 0xffff
+  return {
+      (u16)(color.r * 0x0101), (u16)(color.g * 0x0101),
+      (u16)(color.b * 0x0101), (u16)(color.a * 0x0101)};
+}
+
+// Converts the pixels for the textures which are always rgba8
+void to_rgba8(const rgba16* src, rgba8* dst, i64 count) noexcept;
+void to_rgba8(
+    const u8* src, rgba8* dst, i64 count, const rgba8* palette
+) noexcept;
+
+} // namespace draw
+
+#endif
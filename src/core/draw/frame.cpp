@@ -9,8 +9,16 @@
 
 namespace draw {
 
-Frame::Frame(data_ptr ptr, i32 next_layer, ivec size, ColorType type) noexcept
-    : ptr(ptr), next_layer(next_layer), size(size), type(type) {}
+Frame::Frame(
+    Cel** cels, i32 layer_count, ivec size, ColorType type, Palette* palette,
+    TileTable* table
+) noexcept
+    : cels(cels),
+      layer_count(layer_count),
+      size(size),
+      type(type),
+      palette(palette),
+      table(table) {}
 
 ivec Frame::get_size() const noexcept {
   return this->size;
@@ -28,11 +36,16 @@ ColorType Frame::get_type() const noexcept {
   return this->type;
 }
 
+i32 Frame::get_layer_count() const noexcept {
+  return this->layer_count;
+}
+
 Layer Frame::get_layer(i32 index) noexcept {
   assert(index >= 0 && index < this->layer_count);
 
   // NOLINTNEXTLINE
-  return Layer{this->ptr + index * this->next_layer, this->size, this->type};
+  return Layer{
+      this->cels + index, this->size, this->type, this->palette, this->table};
 }
 
 } // namespace draw
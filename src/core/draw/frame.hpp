@@ -9,6 +9,7 @@
 #define PXL_DRAW_FRAME_HPP
 
 #include "./layer.hpp"
+#include "./palette.hpp"
 #include "./types.hpp"
 #include "types.hpp"
 #include <cassert>
@@ -26,7 +27,8 @@ public:
   Frame() noexcept = default;
 
   explicit Frame(
-      data_ptr ptr, i32 next_layer, ivec size, ColorType type
+      Cel** cels, i32 layer_count, ivec size, ColorType type,
+      Palette* palette = nullptr, TileTable* table = nullptr
   ) noexcept;
 
   [[nodiscard]] ivec get_size() const noexcept;
@@ -36,14 +38,17 @@ public:
   // Returns the type, with the size information of bytes
   [[nodiscard]] ColorType get_type() const noexcept;
 
+  [[nodiscard]] i32 get_layer_count() const noexcept;
+
   [[nodiscard]] Layer get_layer(i32 index) noexcept;
 
 private:
-  data_ptr ptr = nullptr;
-  i32 next_layer = 0;
+  Cel** cels = nullptr;
   i32 layer_count = 0;
   ivec size{};
   ColorType type = ColorType::NONE;
+  Palette* palette = nullptr;
+  TileTable* table = nullptr;
 };
 
 } // namespace draw
@@ -6,15 +6,15 @@
  *==========================*/
 
 #include "./layer.hpp"
+#include <cstring>
+#include <new>
 
 namespace draw {
 
-Layer::Layer(data_ptr ptr, ivec size, ColorType type) noexcept
-    : ptr(ptr), size(size), type(type) {}
-
-data_ptr Layer::get_ptr() noexcept {
-  return this->ptr;
-}
+Layer::Layer(
+    Cel** slot, ivec size, ColorType type, Palette* palette, TileTable* table
+) noexcept
+    : slot(slot), size(size), type(type), palette(palette), table(table) {}
 
 ivec Layer::get_size() const noexcept {
   return this->size;
@@ -32,34 +32,145 @@ ColorType Layer::get_type() const noexcept {
   return this->type;
 }
 
-data_ptr Layer::get_pixel(ivec pos) const noexcept {
-  // NOLINTNEXTLINE
-  return this->ptr +
-         (pos.x + pos.y * this->size.x) * (this->type & 0x0000'ffff);
+Palette* Layer::get_palette() const noexcept {
+  return this->palette;
+}
+
+const_data_ptr Layer::get_pixel(ivec pos) const noexcept {
+  assert(this->slot != nullptr);
+  return *this->slot ? (*this->slot)->get_pixel(pos) : ZERO_TILE;
+}
+
+const_data_ptr Layer::get_pixel(i64 index) const noexcept {
+  return this->get_pixel(this->get_pos(index));
+}
+
+const Cel* Layer::get_cel() const noexcept {
+  assert(this->slot != nullptr);
+  return *this->slot;
 }
 
-data_ptr Layer::get_pixel(i32 index) const noexcept {
+Error Layer::set_tile(i32 index, Tile* tile) noexcept {
+  assert(this->slot != nullptr);
+  if (!*this->slot && !tile) {
+    return Error::OK;
+  }
+
+  auto* cel = this->get_cel_for_write();
+  return cel ? cel->set_tile(index, tile) : Error::BAD_ALLOC;
+}
+
+irect Layer::get_bounds() const noexcept {
+  assert(this->slot != nullptr);
+  return *this->slot ? (*this->slot)->get_bounds() : irect{};
+}
+
+bool Layer::is_empty() const noexcept {
+  assert(this->slot != nullptr);
+  return !*this->slot || (*this->slot)->is_empty();
+}
+
+void Layer::get_pixels(data_ptr dst) const noexcept {
+  assert(this->slot != nullptr);
+
+  if (*this->slot) {
+    (*this->slot)->get_pixels(dst);
+    return;
+  }
+
+  std::memset(
+      dst, 0, (i64)this->size.x * this->size.y * (this->type & 0x0000'ffff)
+  );
+}
+
+void Layer::get_rgba8_pixels(rgba8* dst) const noexcept {
+  assert(this->slot != nullptr);
+
+  if (*this->slot) {
+    (*this->slot)->get_rgba8_pixels(
+        dst, this->palette ? this->palette->get_colors() : nullptr
+    );
+    return;
+  }
+
+  std::memset(dst, 0, (i64)this->size.x * this->size.y * sizeof(rgba8));
+}
+
+void Layer::get_rgba8_pixels(
+    rgba8* dst, i64 pitch, irect rect
+) const noexcept {
+  assert(this->slot != nullptr);
+
+  if (*this->slot) {
+    (*this->slot)->get_rgba8_pixels(
+        dst, pitch, rect, this->palette ? this->palette->get_colors() : nullptr
+    );
+    return;
+  }
+
+  for (i32 y = 0; y < rect.h; ++y) {
+    // NOLINTNEXTLINE
+    std::memset((u8*)dst + y * pitch, 0, rect.w * sizeof(rgba8));
+  }
+}
+
+Cel* Layer::get_cel_for_write() noexcept {
+  assert(this->slot != nullptr);
+
+  Cel* cel = *this->slot;
+  if (cel && !cel->is_shared()) {
+    if (this->table) {
+      this->table->add_cel(cel);
+    }
+    return cel;
+  }
+
   // NOLINTNEXTLINE
-  return this->ptr + index * (this->type & 0x0000'ffff);
+  auto* new_cel = new (std::nothrow) Cel{};
+  if (new_cel == nullptr) {
+    return nullptr;
+  }
+
+  if (cel) {
+    // Copy on write, the tiles themselves are only copied once written to
+    if (new_cel->copy(*cel) != Error::OK) {
+      delete new_cel;
+      return nullptr;
+    }
+    release_cel(cel);
+  } else {
+    new_cel->init(this->size, this->type);
+  }
+
+  *this->slot = new_cel;
+  if (this->table) {
+    this->table->add_cel(new_cel);
+  }
+  return new_cel;
+}
+
+Error Layer::paint(ivec pos, rgba8 color) noexcept {
+  return visit(this->type, [&](auto zero) {
+    using Color = decltype(zero);
+    return this->set_color(pos, this->to_color<Color>(color));
+  });
 }
 
-void Layer::paint(ivec pos, rgba8 color) noexcept {
-  assert(this->ptr != nullptr);
-  assert((this->type & 0x0000'ffff) == sizeof(rgba8));
+Error Layer::paint(i64 index, rgba8 color) noexcept {
+  return this->paint(this->get_pos(index), color);
+}
+
+data_ptr Layer::get_pixel_for_write(ivec pos) noexcept {
   assert(
       pos.x >= 0 && pos.y >= 0 && pos.x < this->size.x && pos.y < this->size.y
   );
 
-  ((rgba8*)this->ptr)[pos.x + pos.y * this->size.x] = color;
+  auto* cel = this->get_cel_for_write();
+  return cel ? cel->get_pixel_for_write(pos) : nullptr;
 }
 
-void Layer::paint(i32 index, rgba8 color) noexcept {
-  assert(this->ptr != nullptr);
-  assert((this->type & 0x0000'ffff) == sizeof(rgba8));
-  assert(index >= 0 && index < this->size.x * this->size.y);
-
-  ((rgba8*)this->ptr)[index] = color;
+void Layer::update_bounds(ivec pos) noexcept {
+  (*this->slot)->update_bounds(pos);
 }
 
 } // namespace draw
-
@@ -8,9 +8,14 @@
 #ifndef PXL_DRAW_LAYER_HPP
 #define PXL_DRAW_LAYER_HPP
 
+#include "./cel.hpp"
+#include "./color.hpp"
+#include "./palette.hpp"
 #include "./types.hpp"
 #include "types.hpp"
+#include <algorithm>
 #include <cassert>
+#include <type_traits>
 
 namespace draw {
 
@@ -24,14 +29,16 @@ class Layer {
 public:
   Layer() noexcept = default;
 
-  explicit Layer(data_ptr ptr, ivec size, ColorType type) noexcept;
-
   /**
-   * Returns the ptr which points at the start of the layer.
-   * data_ptr can be converted to any pointer type, but use get_type()
-   * to check whether what datatype was used.
+   * @param slot - where the cel is referenced, an empty slot gets a new cel
+   *   on the first paint and a shared cel gets copied on the first paint
+   * @param palette - palette of the animation, only used by INDEXED8
+   * @param table - tiles of the animation, cels written to are queued in it
    **/
-  [[nodiscard]] data_ptr get_ptr() noexcept;
+  explicit Layer(
+      Cel** slot, ivec size, ColorType type, Palette* palette = nullptr,
+      TileTable* table = nullptr
+  ) noexcept;
 
   [[nodiscard]] ivec get_size() const noexcept;
   [[nodiscard]] i32 get_width() const noexcept;
@@ -39,20 +46,178 @@ public:
 
   // Returns the type, with the size information of bytes
   [[nodiscard]] ColorType get_type() const noexcept;
+  // nullptr if the layer is not INDEXED8
+  [[nodiscard]] Palette* get_palette() const noexcept;
 
-  // Returns the pixel at a specific pos
-  [[nodiscard]] data_ptr get_pixel(ivec pos) const noexcept;
+  /**
+   * Returns the pixel at a specific pos.
+   * const_data_ptr can be converted to any pointer type, but use get_type()
+   * to check whether what datatype was used.
+   **/
+  [[nodiscard]] const_data_ptr get_pixel(ivec pos) const noexcept;
 
   // Returns the pixel at a specific index
-  [[nodiscard]] data_ptr get_pixel(i32 index) const noexcept;
+  [[nodiscard]] const_data_ptr get_pixel(i64 index) const noexcept;
+
+  [[nodiscard]] ivec get_pos(i64 index) const noexcept {
+    return {(i32)(index % this->size.x), (i32)(index / this->size.x)};
+  }
+
+  // Color should match get_type(), use visit() to get the Color
+  template <typename Color>
+  [[nodiscard]] Color get_color(ivec pos) const noexcept {
+    assert(this->type == ColorTraits<Color>::TYPE);
+    return *(const Color*)this->get_pixel(pos);
+  }
+
+  template <typename Color>
+  [[nodiscard]] Color get_color(i64 index) const noexcept {
+    return this->get_color<Color>(this->get_pos(index));
+  }
+
+  // nullptr if the layer was never painted on
+  [[nodiscard]] const Cel* get_cel() const noexcept;
+
+  /**
+   * Replaces the tile at the index of the cel, see Cel::set_tile().
+   * Errors if the cel could not be allocated
+   **/
+  Error set_tile(i32 index, Tile* tile) noexcept;
 
-  void paint(ivec pos, rgba8 color) noexcept;
-  void paint(i32 index, rgba8 color) noexcept;
+  // Bounds of the non-transparent pixels, the size is 0 if empty
+  [[nodiscard]] irect get_bounds() const noexcept;
+  [[nodiscard]] bool is_empty() const noexcept;
+
+  /**
+   * Copies the layer into a contiguous buffer, dst should be able to hold
+   * width * height pixels
+   **/
+  void get_pixels(data_ptr dst) const noexcept;
+
+  // Same as get_pixels() but converts the pixels to rgba8
+  void get_rgba8_pixels(rgba8* dst) const noexcept;
+
+  /**
+   * Same as get_rgba8_pixels() but only for the pixels in the rect,
+   * dst points to the top left of the rect and its rows are pitch bytes apart
+   **/
+  void get_rgba8_pixels(rgba8* dst, i64 pitch, irect rect) const noexcept;
+
+  /**
+   * Converts a color from the ui to the type of the layer.
+   * INDEXED8 layers may add the color to the palette
+   **/
+  template <typename Color> [[nodiscard]] Color to_color(rgba8 color) noexcept {
+    assert(this->type == ColorTraits<Color>::TYPE);
+
+    if constexpr (std::is_same_v<Color, u8>) {
+      assert(this->palette != nullptr);
+      return this->palette->get_index(color);
+    } else {
+      return from_rgba8<Color>(color);
+    }
+  }
+
+  /**
+   * Converts a color of the layer back to the ui, a full palette may have
+   * stored the nearest color instead of the one from to_color()
+   **/
+  template <typename Color>
+  [[nodiscard]] rgba8 to_rgba8(Color color) const noexcept {
+    assert(this->type == ColorTraits<Color>::TYPE);
+
+    rgba8 out{};
+    if constexpr (std::is_same_v<Color, u8>) {
+      assert(this->palette != nullptr);
+      out = this->palette->get_color(color);
+    } else if constexpr (std::is_same_v<Color, rgba16>) {
+      draw::to_rgba8(&color, &out, 1);
+    } else {
+      out = color;
+    }
+    return out;
+  }
+
+  /**
+   * Paints a color from the ui, converting it to the type of the layer.
+   * Errors if the tile of the pixel could not be allocated
+   **/
+  Error paint(ivec pos, rgba8 color) noexcept;
+  Error paint(i64 index, rgba8 color) noexcept;
+
+  /**
+   * Paints the pixel without any conversion, Color should match get_type().
+   * Errors if the tile of the pixel could not be allocated
+   **/
+  template <typename Color> Error set_color(ivec pos, Color color) noexcept {
+    assert(this->type == ColorTraits<Color>::TYPE);
+
+    auto* pixel = this->get_pixel_for_write(pos);
+    if (!pixel) {
+      return Error::BAD_ALLOC;
+    }
+
+    *(Color*)pixel = color;
+    this->update_bounds(pos);
+    return Error::OK;
+  }
+
+  template <typename Color> Error set_color(i64 index, Color color) noexcept {
+    return this->set_color(this->get_pos(index), color);
+  }
+
+  /**
+   * Paints width pixels to the right of pos with the same color, filling
+   * the row of each tile at once. Color should match get_type().
+   * Errors if a tile of the row could not be allocated
+   **/
+  template <typename Color>
+  Error set_span(ivec pos, i32 width, Color color) noexcept {
+    assert(this->type == ColorTraits<Color>::TYPE);
+    assert(
+        pos.x >= 0 && pos.y >= 0 && width > 0 &&
+        pos.x + width <= this->size.x && pos.y < this->size.y
+    );
+
+    auto* cel = this->get_cel_for_write();
+    if (!cel) {
+      return Error::BAD_ALLOC;
+    }
+
+    i32 end = pos.x + width;
+    for (i32 x = pos.x; x < end;) {
+      // The row of a tile is contiguous
+      i32 count = std::min(end, (x | TILE_MASK) + 1) - x;
+      auto* pixels = (Color*)cel->get_pixel_for_write({x, pos.y});
+      if (!pixels) {
+        return Error::BAD_ALLOC;
+      }
+
+      std::fill_n(pixels, count, color);
+      x += count;
+    }
+
+    cel->update_bounds(pos, width);
+    return Error::OK;
+  }
 
 private:
-  data_ptr ptr = nullptr;
+  Cel** slot = nullptr;
   ivec size{};
   ColorType type = ColorType::NONE;
+  Palette* palette = nullptr;
+  TileTable* table = nullptr;
+
+  /**
+   * Returns the cel of the slot, creating or copying it if needed.
+   * The cel is queued in the table for dedup.
+   * Returns nullptr on bad alloc
+   **/
+  [[nodiscard]] Cel* get_cel_for_write() noexcept;
+
+  // Returns nullptr on bad alloc
+  [[nodiscard]] data_ptr get_pixel_for_write(ivec pos) noexcept;
+  void update_bounds(ivec pos) noexcept;
 };
 
 } // namespace draw
@@ -0,0 +1,73 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./palette.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace draw {
+
+i32 Palette::get_count() const noexcept {
+  return this->count;
+}
+
+rgba8 Palette::get_color(u8 index) const noexcept {
+  return this->colors[index];
+}
+
+const rgba8* Palette::get_colors() const noexcept {
+  return this->colors;
+}
+
+void Palette::set_color(u8 index, rgba8 color) noexcept {
+  assert(index > 0 && index < this->count);
+  this->colors[index] = color;
+}
+
+void Palette::set_colors(const rgba8* colors, i32 count) noexcept {
+  assert(count > 0 && count <= PALETTE_SIZE);
+  // NOLINTNEXTLINE
+  std::copy(colors + 1, colors + count, this->colors + 1);
+  // NOLINTNEXTLINE
+  std::fill(this->colors + count, this->colors + PALETTE_SIZE, rgba8{});
+  this->count = count;
+}
+
+u8 Palette::get_index(rgba8 color) noexcept {
+  if (color.a == 0U) {
+    return 0U;
+  }
+
+  for (i32 i = 1; i < this->count; ++i) {
+    if (this->colors[i] == color) {
+      return (u8)i;
+    }
+  }
+
+  if (this->count < PALETTE_SIZE) {
+    this->colors[this->count] = color;
+    return (u8)this->count++;
+  }
+
+  i32 nearest = 1;
+  i32 nearest_distance = 0x7fff'ffff;
+  for (i32 i = 1; i < PALETTE_SIZE; ++i) {
+    i32 distance = 0;
+    for (i32 c = 0; c < 4; ++c) {
+      distance += std::abs(this->colors[i].colors[c] - color.colors[c]);
+    }
+
+    if (distance < nearest_distance) {
+      nearest = i;
+      nearest_distance = distance;
+    }
+  }
+  return (u8)nearest;
+}
+
+} // namespace draw
@@ -0,0 +1,52 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_PALETTE_HPP
+#define PXL_DRAW_PALETTE_HPP
+
+#include "./types.hpp"
+#include "types.hpp"
+
+namespace draw {
+
+const i32 PALETTE_SIZE = 256;
+
+/**
+ * Colors of an INDEXED8 animation, the pixels only store the index.
+ * Index 0 is always the transparent color.
+ *
+ * Recoloring the whole animation only needs a set_color()
+ **/
+class Palette {
+public:
+  [[nodiscard]] i32 get_count() const noexcept;
+  [[nodiscard]] rgba8 get_color(u8 index) const noexcept;
+  // Has PALETTE_SIZE colors, unused colors are transparent
+  [[nodiscard]] const rgba8* get_colors() const noexcept;
+
+  void set_color(u8 index, rgba8 color) noexcept;
+
+  /**
+   * Replaces the colors with the first (count) of colors, the color at
+   * index 0 is skipped as it is always transparent
+   **/
+  void set_colors(const rgba8* colors, i32 count) noexcept;
+
+  /**
+   * Returns the index of the color, adding it if it is not in the palette.
+   * If the palette is full, the index of the nearest color is returned
+   **/
+  [[nodiscard]] u8 get_index(rgba8 color) noexcept;
+
+private:
+  rgba8 colors[PALETTE_SIZE]{};
+  i32 count = 1;
+};
+
+} // namespace draw
+
+#endif
@@ -0,0 +1,134 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./pool.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace draw {
+
+void* allocate_aligned(i64 bytes) noexcept {
+  // Size should be a multiple of the alignment
+  bytes = (bytes + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+#ifdef _WIN32
+  return _aligned_malloc(bytes, BUFFER_ALIGNMENT);
+#else
+  return std::aligned_alloc(BUFFER_ALIGNMENT, bytes);
+#endif
+}
+
+void free_aligned(void* ptr) noexcept {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  // NOLINTNEXTLINE
+  std::free(ptr);
+#endif
+}
+
+// Returns -1 if the buffer is too big to be cached
+[[nodiscard]] inline i32 get_size_class(i64 bytes) noexcept {
+  i32 shift = POOL_MIN_SHIFT;
+  while ((1LL << shift) < bytes) {
+    ++shift;
+  }
+  return shift <= POOL_MAX_SHIFT ? shift - POOL_MIN_SHIFT : -1;
+}
+
+BufferPool::~BufferPool() noexcept {
+  this->clear();
+}
+
+void BufferPool::clear() noexcept {
+  for (i32 i = 0; i < POOL_CLASS_COUNT; ++i) {
+    while (this->buffers[i]) {
+      FreeBuffer* buffer = this->buffers[i];
+      this->buffers[i] = buffer->next;
+      free_aligned(buffer);
+    }
+    this->counts[i] = 0;
+  }
+  this->cached_bytes = 0;
+}
+
+void* BufferPool::allocate(i64 bytes) noexcept {
+  i32 size_class = get_size_class(bytes);
+  if (size_class < 0) {
+    return allocate_aligned(bytes);
+  }
+
+  FreeBuffer* buffer = this->buffers[size_class];
+  if (buffer) {
+    this->buffers[size_class] = buffer->next;
+    --this->counts[size_class];
+    this->cached_bytes -= 1LL << (size_class + POOL_MIN_SHIFT);
+    return buffer;
+  }
+
+  return allocate_aligned(1LL << (size_class + POOL_MIN_SHIFT));
+}
+
+void* BufferPool::allocate_zeroed(i64 bytes) noexcept {
+  void* ptr = this->allocate(bytes);
+  if (ptr) {
+    std::memset(ptr, 0, bytes);
+  }
+  return ptr;
+}
+
+void* BufferPool::reallocate(void* ptr, i64 old_bytes, i64 new_bytes) noexcept {
+  i32 size_class = get_size_class(new_bytes);
+  if (ptr && size_class >= 0 && size_class == get_size_class(old_bytes)) {
+    return ptr;
+  }
+
+  void* new_ptr = this->allocate(new_bytes);
+  if (!new_ptr) {
+    return nullptr;
+  }
+
+  if (ptr) {
+    std::memcpy(new_ptr, ptr, std::min(old_bytes, new_bytes));
+    this->free(ptr, old_bytes);
+  }
+  return new_ptr;
+}
+
+void BufferPool::free(void* ptr, i64 bytes) noexcept {
+  if (!ptr) {
+    return;
+  }
+
+  i32 size_class = get_size_class(bytes);
+  if (size_class < 0 || this->counts[size_class] >= POOL_MAX_CACHED) {
+    free_aligned(ptr);
+    return;
+  }
+
+  auto* buffer = (FreeBuffer*)ptr;
+  buffer->next = this->buffers[size_class];
+  this->buffers[size_class] = buffer;
+  ++this->counts[size_class];
+  this->cached_bytes += 1LL << (size_class + POOL_MIN_SHIFT);
+}
+
+i64 BufferPool::get_cached_bytes() const noexcept {
+  return this->cached_bytes;
+}
+
+BufferPool& get_buffer_pool() noexcept {
+  // Never destroyed, anims of static objects may still be freed at exit
+  static auto* pool = new BufferPool{}; // NOLINT
+  return *pool;
+}
+
+} // namespace draw
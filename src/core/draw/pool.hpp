@@ -0,0 +1,78 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_POOL_HPP
+#define PXL_DRAW_POOL_HPP
+
+#include "types.hpp"
+
+namespace draw {
+
+// Alignment of every buffer from the pool, enough for SIMD loads
+const i64 BUFFER_ALIGNMENT = 64;
+
+// Buffers are rounded up to a power of 2 from 64B to 16MB
+const i32 POOL_MIN_SHIFT = 6;
+const i32 POOL_MAX_SHIFT = 24;
+const i32 POOL_CLASS_COUNT = POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1;
+// How many freed buffers are kept per size class
+const i32 POOL_MAX_CACHED = 32;
+
+// Aligned to BUFFER_ALIGNMENT, returns nullptr on bad alloc
+[[nodiscard]] void* allocate_aligned(i64 bytes) noexcept;
+void free_aligned(void* ptr) noexcept;
+
+/**
+ * Recycles the slot tables of the animations and the tile tables of the
+ * cels, snapshots allocate and free the same sizes over and over.
+ * Buffers bigger than the biggest size class are not cached.
+ **/
+class BufferPool {
+public:
+  BufferPool() noexcept = default;
+  BufferPool(const BufferPool&) noexcept = delete;
+  BufferPool& operator=(const BufferPool&) noexcept = delete;
+  BufferPool(BufferPool&&) noexcept = delete;
+  BufferPool& operator=(BufferPool&&) noexcept = delete;
+  ~BufferPool() noexcept;
+
+  // Frees all the cached buffers
+  void clear() noexcept;
+
+  // Returns nullptr on bad alloc
+  [[nodiscard]] void* allocate(i64 bytes) noexcept;
+  [[nodiscard]] void* allocate_zeroed(i64 bytes) noexcept;
+
+  /**
+   * Keeps the first min(old_bytes, new_bytes) bytes of the buffer.
+   * Returns nullptr on bad alloc, ptr is still valid in that case
+   **/
+  [[nodiscard]] void* reallocate(
+      void* ptr, i64 old_bytes, i64 new_bytes
+  ) noexcept;
+
+  // bytes should be the same size used to allocate the buffer
+  void free(void* ptr, i64 bytes) noexcept;
+
+  [[nodiscard]] i64 get_cached_bytes() const noexcept;
+
+private:
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  FreeBuffer* buffers[POOL_CLASS_COUNT]{};
+  i32 counts[POOL_CLASS_COUNT]{};
+  i64 cached_bytes = 0;
+};
+
+// Every animation and cel table is allocated from this pool
+[[nodiscard]] BufferPool& get_buffer_pool() noexcept;
+
+} // namespace draw
+
+#endif
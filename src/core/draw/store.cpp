@@ -0,0 +1,181 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./store.hpp"
+#include "./pool.hpp"
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace draw {
+
+TileStore::~TileStore() noexcept {
+  // Cels may still reference the mapping
+  if (this->tile_count == 0) {
+    this->clear();
+  }
+}
+
+Error TileStore::init_mapped(const c8* path, i64 reserve_size) noexcept {
+  assert(this->tile_count == 0);
+  this->clear();
+
+#ifdef __unix__
+  // NOLINTNEXTLINE
+  this->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (this->fd < 0) {
+    return Error::IO_ERROR;
+  }
+  // Scratch file, only the mapping keeps it alive
+  unlink(path);
+
+  // Only reserves the address space, the file grows once tiles are needed
+  void* map = mmap(
+      nullptr, reserve_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE,
+      this->fd, 0
+  );
+  if (map == MAP_FAILED) {
+    // Kept for the caller, close() may overwrite it
+    int error = errno;
+    close(this->fd);
+    this->fd = -1;
+    errno = error;
+    return Error::IO_ERROR;
+  }
+
+  this->map = (data_ptr)map;
+  this->reserve_size = reserve_size;
+  return Error::OK;
+#else
+  static_cast<void>(path);
+  static_cast<void>(reserve_size);
+  errno = ENOSYS;
+  return Error::IO_ERROR;
+#endif
+}
+
+void TileStore::clear() noexcept {
+  if (!this->map) {
+    // Only the cached tiles are owned by the store
+    for (i32 i = 0; i <= MAX_PIXEL_SIZE; ++i) {
+      while (Tile* tile = this->pop_free_tile(i)) {
+        free_aligned(tile);
+      }
+    }
+    return;
+  }
+  assert(this->tile_count == 0);
+
+#ifdef __unix__
+  munmap(this->map, this->reserve_size);
+  close(this->fd);
+#endif
+
+  this->map = nullptr;
+  this->fd = -1;
+  this->reserve_size = this->mapped_size = this->used_size = 0;
+  std::memset(this->free_tiles, 0, sizeof(this->free_tiles));
+  std::memset(this->free_counts, 0, sizeof(this->free_counts));
+}
+
+bool TileStore::is_mapped() const noexcept {
+  return this->map != nullptr;
+}
+
+i64 TileStore::get_tile_count() const noexcept {
+  return this->tile_count;
+}
+
+i64 TileStore::get_mapped_size() const noexcept {
+  return this->mapped_size;
+}
+
+Tile* TileStore::allocate(i32 bytes) noexcept {
+  i32 pixel_size = bytes / (TILE_SIZE * TILE_SIZE);
+  assert(pixel_size > 0 && pixel_size <= MAX_PIXEL_SIZE);
+
+  Tile* tile = this->pop_free_tile(pixel_size);
+  if (tile) {
+    std::memset(tile->get_ptr(), 0, bytes);
+  } else if (this->map) {
+    tile = this->allocate_mapped(bytes);
+  } else {
+    tile = (Tile*)allocate_aligned(sizeof(Tile) + bytes);
+    if (tile) {
+      std::memset(tile->get_ptr(), 0, bytes);
+    }
+  }
+
+  if (tile == nullptr) {
+    return nullptr;
+  }
+  *tile = Tile{};
+  ++this->tile_count;
+  return tile;
+}
+
+void TileStore::free(Tile* tile, i32 bytes) noexcept {
+  assert(tile != nullptr);
+  --this->tile_count;
+
+  i32 pixel_size = bytes / (TILE_SIZE * TILE_SIZE);
+  // Mapped tiles can only be reused
+  if (!this->map && this->free_counts[pixel_size] >= STORE_MAX_CACHED) {
+    free_aligned(tile);
+    return;
+  }
+
+  // The next free tile is stored in the pixels
+  std::memcpy(tile->get_ptr(), &this->free_tiles[pixel_size], sizeof(Tile*));
+  this->free_tiles[pixel_size] = tile;
+  ++this->free_counts[pixel_size];
+}
+
+Tile* TileStore::pop_free_tile(i32 pixel_size) noexcept {
+  Tile* tile = this->free_tiles[pixel_size];
+  if (tile) {
+    std::memcpy(&this->free_tiles[pixel_size], tile->get_ptr(), sizeof(Tile*));
+    --this->free_counts[pixel_size];
+  }
+  return tile;
+}
+
+Tile* TileStore::allocate_mapped(i32 bytes) noexcept {
+  i64 block_size = sizeof(Tile) + bytes;
+  if (this->used_size + block_size > this->mapped_size) {
+#ifdef __unix__
+    i64 new_mapped_size = this->mapped_size + STORE_GROW_SIZE;
+    if (new_mapped_size > this->reserve_size ||
+        ftruncate(this->fd, new_mapped_size) != 0) {
+      return nullptr;
+    }
+    this->mapped_size = new_mapped_size;
+#else
+    return nullptr;
+#endif
+  }
+
+  // Newly grown parts of the file are already zeroed
+  // NOLINTNEXTLINE
+  auto* tile = (Tile*)(this->map + this->used_size);
+  this->used_size += block_size;
+  return tile;
+}
+
+TileStore& get_tile_store() noexcept {
+  // Never destroyed, cels of static objects may still be freed at exit
+  static auto* store = new TileStore{}; // NOLINT
+  return *store;
+}
+
+} // namespace draw
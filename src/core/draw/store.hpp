@@ -0,0 +1,127 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_STORE_HPP
+#define PXL_DRAW_STORE_HPP
+
+#include "./types.hpp"
+#include "types.hpp"
+
+namespace draw {
+
+class TileTable;
+
+/**
+ * Header of a block of pixels, the pixels are placed right after it.
+ * Padded to 64 bytes so the pixels are aligned for SIMD.
+ * Tiles can be shared between cels and are copied once a shared tile is
+ * written to.
+ **/
+struct alignas(64) Tile {
+  i32 refs = 1;
+  // Table holding a reference of this tile, nullptr if none
+  TileTable* table = nullptr;
+  // Hash of the pixels, only set while the tile is in a table
+  u64 hash = 0U;
+
+  [[nodiscard]] data_ptr get_ptr() noexcept {
+    return (data_ptr)(this + 1);
+  }
+
+  [[nodiscard]] const_data_ptr get_ptr() const noexcept {
+    return (const_data_ptr)(this + 1);
+  }
+};
+
+// Virtual address space reserved for a mapped store
+const i64 STORE_RESERVE_SIZE = 64LL << 30;
+// How much the backing file grows once the mapped space runs out
+const i64 STORE_GROW_SIZE = 64LL << 20;
+// How many freed heap tiles are kept per pixel size for reuse
+const i32 STORE_MAX_CACHED = 1024;
+
+/**
+ * Where the memory of the tiles come from.
+ * Tiles are allocated on the heap by default, a mapped store places them
+ * in a scratch file instead so the OS can page out the cold frames.
+ * Freed tiles are kept for reuse, tiles are always 64-byte aligned.
+ *
+ * NOTE: Only switch stores while there are no tiles allocated
+ **/
+class TileStore {
+public:
+  TileStore() noexcept = default;
+  TileStore(const TileStore&) noexcept = delete;
+  TileStore& operator=(const TileStore&) noexcept = delete;
+  TileStore(TileStore&&) noexcept = delete;
+  TileStore& operator=(TileStore&&) noexcept = delete;
+  ~TileStore() noexcept;
+
+  /**
+   * Places the tiles in a memory mapped scratch file, the file is removed
+   * once the store is cleared.
+   * Errors with IO_ERROR if the file could not be created or mapped, or if
+   * memory mapping is not supported on the platform, errno has the cause
+   **/
+  Error init_mapped(
+      const c8* path, i64 reserve_size = STORE_RESERVE_SIZE
+  ) noexcept;
+
+  // Unmaps the scratch file and goes back to the heap, frees cached tiles
+  void clear() noexcept;
+
+  [[nodiscard]] bool is_mapped() const noexcept;
+  [[nodiscard]] i64 get_tile_count() const noexcept;
+  // Size of the backing file, 0 if the tiles are on the heap
+  [[nodiscard]] i64 get_mapped_size() const noexcept;
+
+  // Returns a zeroed tile with (bytes) of pixels, nullptr on bad alloc
+  [[nodiscard]] Tile* allocate(i32 bytes) noexcept;
+  void free(Tile* tile, i32 bytes) noexcept;
+
+private:
+  data_ptr map = nullptr;
+  i64 reserve_size = 0;
+  i64 mapped_size = 0;
+  // Start of the unused part of the mapped file
+  i64 used_size = 0;
+  i64 tile_count = 0;
+  i32 fd = -1;
+
+  // Freed tiles, indexed by the pixel size
+  Tile* free_tiles[MAX_PIXEL_SIZE + 1]{};
+  i32 free_counts[MAX_PIXEL_SIZE + 1]{};
+
+  [[nodiscard]] Tile* pop_free_tile(i32 pixel_size) noexcept;
+  [[nodiscard]] Tile* allocate_mapped(i32 bytes) noexcept;
+};
+
+// Every cel allocates its tiles from this store
+[[nodiscard]] TileStore& get_tile_store() noexcept;
+
+// Removes the tile from its table and frees it, see TileTable::erase()
+void erase_tile(Tile* tile) noexcept;
+
+/**
+ * Releases a reference of the tile, frees it if it was the last one or if
+ * only its table still holds it
+ **/
+inline void release_tile(Tile* tile, i32 bytes) noexcept {
+  if (!tile) {
+    return;
+  }
+
+  if (--tile->refs == 0) {
+    get_tile_store().free(tile, bytes);
+  } else if (tile->refs == 1 && tile->table) {
+    erase_tile(tile);
+  }
+}
+
+} // namespace draw
+
+#endif
@@ -0,0 +1,165 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "./tile_table.hpp"
+#include "./cel.hpp"
+#include <cassert>
+#include <cstring>
+
+namespace draw {
+
+TileTable::TileTable(TileTable&& rhs) noexcept
+    : tiles(std::move(rhs.tiles)), cels(std::move(rhs.cels)),
+      bytes(rhs.bytes) {
+  rhs.tiles.clear();
+  rhs.cels.clear();
+  this->adopt();
+}
+
+TileTable& TileTable::operator=(TileTable&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+
+  this->clear();
+  this->tiles = std::move(rhs.tiles);
+  this->cels = std::move(rhs.cels);
+  this->bytes = rhs.bytes;
+  rhs.tiles.clear();
+  rhs.cels.clear();
+  this->adopt();
+
+  return *this;
+}
+
+TileTable::~TileTable() noexcept {
+  this->clear();
+}
+
+void TileTable::adopt() noexcept {
+  for (auto& [hash, tile] : this->tiles) {
+    tile->table = this;
+  }
+  for (Cel* cel : this->cels) {
+    cel->table = this;
+  }
+}
+
+void TileTable::clear() noexcept {
+  for (auto& [hash, tile] : this->tiles) {
+    tile->table = nullptr;
+    if (--tile->refs == 0) {
+      get_tile_store().free(tile, this->bytes);
+    }
+  }
+  this->tiles.clear();
+
+  for (Cel* cel : this->cels) {
+    cel->table = nullptr;
+    cel->table_index = -1;
+  }
+  this->cels.clear();
+}
+
+void TileTable::add_cel(Cel* cel) noexcept {
+  if (cel->table == this) {
+    return;
+  }
+
+  // Cels moved between animations are deduped by the last one written to
+  if (cel->table) {
+    cel->table->remove_cel(cel);
+  }
+  cel->table = this;
+  cel->table_index = (i32)this->cels.size();
+  this->cels.push_back(cel);
+}
+
+void TileTable::remove_cel(Cel* cel) noexcept {
+  assert(cel->table == this);
+  // Swapped with the last cel so nothing is searched
+  Cel* last = this->cels.back();
+  last->table_index = cel->table_index;
+  this->cels[cel->table_index] = last;
+  this->cels.pop_back();
+
+  cel->table = nullptr;
+  cel->table_index = -1;
+}
+
+void TileTable::dedup_cels() noexcept {
+  for (Cel* cel : this->cels) {
+    cel->table = nullptr;
+    cel->table_index = -1;
+    cel->dedup_tiles(*this);
+  }
+  this->cels.clear();
+}
+
+Tile* TileTable::intern(Tile* tile, i32 bytes) noexcept {
+  assert(tile->table == nullptr);
+  assert(this->tiles.empty() || this->bytes == bytes);
+  this->bytes = bytes;
+
+  u64 hash = hash_tile(tile, bytes);
+  auto [begin, end] = this->tiles.equal_range(hash);
+  for (auto it = begin; it != end; ++it) {
+    if (std::memcmp(it->second->get_ptr(), tile->get_ptr(), bytes) == 0) {
+      return it->second;
+    }
+  }
+
+  // Collisions are added too so the tile is never hashed again
+  ++tile->refs;
+  tile->table = this;
+  tile->hash = hash;
+  this->tiles.emplace(hash, tile);
+  return tile;
+}
+
+void TileTable::erase(Tile* tile) noexcept {
+  assert(tile->table == this && tile->refs == 1);
+  auto [begin, end] = this->tiles.equal_range(tile->hash);
+  for (auto it = begin; it != end; ++it) {
+    if (it->second == tile) {
+      this->tiles.erase(it);
+      break;
+    }
+  }
+
+  tile->table = nullptr;
+  tile->refs = 0;
+  get_tile_store().free(tile, this->bytes);
+}
+
+i64 TileTable::get_size() const noexcept {
+  return (i64)this->tiles.size();
+}
+
+void erase_tile(Tile* tile) noexcept {
+  tile->table->erase(tile);
+}
+
+u64 hash_tile(const Tile* tile, i32 bytes) noexcept {
+  // FNV-1a over 8 byte words
+  const u64 prime = 0x0000'0100'0000'01b3ULL;
+  u64 hash = 0xcbf2'9ce4'8422'2325ULL;
+
+  const_data_ptr ptr = tile->get_ptr();
+  for (i32 i = 0; i < bytes; i += 8) {
+    u64 word = 0U;
+    // NOLINTNEXTLINE
+    std::memcpy(&word, ptr + i, sizeof(u64));
+    hash = (hash ^ word) * prime;
+  }
+
+  // Mix the high bits back since the words are xor'd as a whole
+  hash ^= hash >> 32;
+  return hash;
+}
+
+} // namespace draw
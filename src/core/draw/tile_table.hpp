@@ -0,0 +1,73 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#ifndef PXL_DRAW_TILE_TABLE_HPP
+#define PXL_DRAW_TILE_TABLE_HPP
+
+#include "./store.hpp"
+#include "./types.hpp"
+#include "types.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace draw {
+
+class Cel;
+
+/**
+ * Content addressed table of tiles, cels with identical tiles share them.
+ * The table holds a reference to each of its tiles so these are always
+ * shared, writing to one copies it like any other shared tile. A tile is
+ * dropped from the table once no cel holds it anymore.
+ * Cels written to are queued so only their new tiles are hashed.
+ **/
+class TileTable {
+public:
+  TileTable() noexcept = default;
+  TileTable(const TileTable&) noexcept = delete;
+  TileTable& operator=(const TileTable&) noexcept = delete;
+  TileTable(TileTable&& rhs) noexcept;
+  TileTable& operator=(TileTable&& rhs) noexcept;
+  ~TileTable() noexcept;
+
+  // Releases all the tiles of the table and unqueues the cels
+  void clear() noexcept;
+
+  // Queues the cel for the next dedup_cels(), once until it is deduped
+  void add_cel(Cel* cel) noexcept;
+  // Unqueues the cel, called before the cel is deleted
+  void remove_cel(Cel* cel) noexcept;
+  // Calls Cel::dedup_tiles() on the queued cels
+  void dedup_cels() noexcept;
+
+  /**
+   * Returns the tile in the table with the same pixels, the tile itself is
+   * added if there is none. Does not add a reference for the caller
+   **/
+  [[nodiscard]] Tile* intern(Tile* tile, i32 bytes) noexcept;
+
+  // Removes a tile only held by the table and frees it
+  void erase(Tile* tile) noexcept;
+
+  [[nodiscard]] i64 get_size() const noexcept;
+
+private:
+  // Tiles with the same hash but different pixels share the bucket
+  std::unordered_multimap<u64, Tile*> tiles{};
+  // Cels written to since the last dedup_cels()
+  std::vector<Cel*> cels{};
+  i32 bytes = 0;
+
+  // Points the tiles and the cels back to this table after a move
+  void adopt() noexcept;
+};
+
+[[nodiscard]] u64 hash_tile(const Tile* tile, i32 bytes) noexcept;
+
+} // namespace draw
+
+#endif
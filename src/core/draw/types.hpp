@@ -17,9 +17,20 @@ enum ColorType {
   NONE = 0,
   RGBA8 = 0x0001'0004,
   RGBA16 = 0x0002'0008,
+  // Index to the palette of the animation
+  INDEXED8 = 0x0003'0001,
 };
 
 using data_ptr = u8*;
+using const_data_ptr = const u8*;
+
+// Cels are split into square tiles of TILE_SIZE x TILE_SIZE pixels
+const i32 TILE_SIZE = 32;
+const i32 TILE_SHIFT = 5;
+const i32 TILE_MASK = TILE_SIZE - 1;
+
+// Largest pixel size in bytes from all the color types
+const i32 MAX_PIXEL_SIZE = 8;
 
 } // namespace draw
 
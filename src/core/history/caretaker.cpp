@@ -8,103 +8,1006 @@
 #include "./caretaker.hpp"
 #include "core/logger/logger.hpp"
 #include "types.hpp"
+#include <algorithm>
 #include <cassert>
+#include <filesystem>
+#include <string>
 
 namespace history {
 
-Caretaker::Caretaker(i32 capacity) noexcept {
-  this->snapshots.resize(capacity);
+// Smallest rect containing both, empty rects are ignored
+inline irect merge_rects(irect lhs, irect rhs) noexcept {
+  if (lhs.w <= 0 || lhs.h <= 0) {
+    return rhs;
+  }
+  if (rhs.w <= 0 || rhs.h <= 0) {
+    return lhs;
+  }
+
+  i32 left = std::min(lhs.x, rhs.x);
+  i32 top = std::min(lhs.y, rhs.y);
+  return {
+      left, top, std::max(lhs.x + lhs.w, rhs.x + rhs.w) - left,
+      std::max(lhs.y + lhs.h, rhs.y + rhs.h) - top};
 }
 
-void Caretaker::init(Snapshot&& snapshot) noexcept {
+Caretaker::Caretaker(i64 budget) noexcept : budget(budget) {}
+
+Caretaker::~Caretaker() noexcept {
+  if (this->initialized) {
+    this->finish_captures();
+  }
+}
+
+Error Caretaker::init(const Model& model) noexcept {
   this->clear();
-  this->snapshots[0] = std::move(snapshot);
-  this->cursor = this->start_cursor = this->end_cursor = 0;
+  if (this->base.copy(model.anim) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+  this->initialized = true;
+  return Error::OK;
+}
+
+Error Caretaker::init_spill(const c8* path) noexcept {
+  return this->spill.open(path);
+}
+
+Error Caretaker::open_journal(const c8* path, Model& model) noexcept {
+  assert(this->initialized);
+  this->journal.close();
+
+  std::vector<u8> bytes{};
+  if (Journal::read(path, bytes) != Error::OK) {
+    // Never overwrite a file that is not a journal
+    return Error::BAD_ALLOC;
+  }
+
+  // Records only end early at a torn record, a crash while it was written
+  i64 offset = Journal::get_header_size();
+  i64 valid = 0;
+  bool failed = false;
+  Record record{};
+  this->keep_snapshots = true;
+  while (Journal::next(bytes, offset, record)) {
+    // Everything is relative to the animation of the first record
+    if ((valid == 0 && record.type != RecordType::INIT) ||
+        this->replay(record, model) != Error::OK) {
+      failed = true;
+      break;
+    }
+    valid = offset;
+  }
+  this->keep_snapshots = false;
+  logger::debug("Replayed %lld bytes of the history journal", valid);
+
+  // Captures of the replay are not appended again
+  this->finish_captures();
+  this->evict_snapshots();
+
+  if (failed) {
+    // The journal is kept as is to look into, the records after the one
+    // that failed are dropped from the one in use
+    std::string backup = std::string{path} + ".bak";
+    std::error_code error{};
+    std::filesystem::copy_file(
+        path, backup, std::filesystem::copy_options::overwrite_existing, error
+    );
+    if (error) {
+      return Error::BAD_ALLOC;
+    }
+    logger::warn(
+        "Could not replay the history journal past %lld, copied it to %s",
+        valid, backup.c_str()
+    );
+
+    // The failed record may have changed the model partly
+    if (model.anim.copy(this->base) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    model.frame_index =
+        std::min(model.frame_index, model.anim.get_frame_count() - 1);
+    model.layer_index =
+        std::min(model.layer_index, model.anim.get_layer_count() - 1);
+    model.layer = model.anim.get_layer(model.frame_index, model.layer_index);
+  }
+
+  if (this->journal.open(path, valid) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  if (valid == 0) {
+    return this->write_checkpoint(model);
+  }
+  return Error::OK;
+}
+
+void Caretaker::close_journal(Model& model) noexcept {
+  // Moves that could not be appended are kept by writing it again
+  this->sync_journal(model);
+  this->finish_captures();
+  this->journal.close();
+}
+
+Error Caretaker::replay(const Record& record, Model& model) noexcept {
+  switch (record.type) {
+  case RecordType::INIT: {
+    ivec size{};
+    draw::ColorType type = draw::ColorType::NONE;
+    if (Journal::decode_init(record, size, type) != Error::OK ||
+        model.anim.init(size, type) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    model.frame_index = model.layer_index = 0;
+    model.layer = model.anim.get_layer(0, 0);
+    this->journal_palette = draw::Palette{};
+    return this->init(model);
+  }
+
+  case RecordType::ANIM: {
+    u64 seq = 0U;
+    if (Journal::decode_anim(record, model, seq) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    // Snapshots from before it were not kept
+    this->next_seq = this->journal_seq = seq;
+    return this->init(model);
+  }
+
+  case RecordType::PALETTE: {
+    auto* palette = model.anim.get_palette();
+    if (!palette || Journal::decode_palette(record, *palette) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    this->journal_palette = *palette;
+    return Error::OK;
+  }
+
+  case RecordType::PAINT:
+    if (Journal::decode_paint(record, model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    return this->snap(model);
+
+  case RecordType::PAINT_CELS:
+    if (Journal::decode_cels(record, model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    return this->snap_cels(model);
+
+  case RecordType::ACTION: {
+    Action action{};
+    if (Journal::decode_action(record, model.anim, action) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    return this->execute(model, action);
+  }
+
+  case RecordType::UNDO: {
+    // Seqs of paints are only known once captured
+    this->finish_captures();
+    u64 seq = 0U;
+    i32 index = this->find_snapshot(this->current);
+    if (Journal::decode_step(record, seq) != Error::OK || index == -1 ||
+        this->snapshots[index].seq != seq) {
+      return Error::BAD_ALLOC;
+    }
+    return this->undo(model);
+  }
+
+  case RecordType::REDO:
+  case RecordType::BRANCH: {
+    this->finish_captures();
+    u64 seq = 0U;
+    if (Journal::decode_step(record, seq) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    u64 child = this->find_child(this->current, seq);
+    if (child == NO_SNAPSHOT) {
+      return Error::BAD_ALLOC;
+    }
+    this->set_active_child(this->current, child);
+    return record.type == RecordType::REDO ? this->redo(model)
+                                           : Error::OK;
+  }
+
+  default:
+    return Error::BAD_ALLOC;
+  }
+}
+
+void Caretaker::append_record(std::vector<u8>&& record) noexcept {
+  if (this->journal.is_open()) {
+    this->journal.write(std::move(record));
+  }
+}
+
+void Caretaker::append_palette(Model& model) noexcept {
+  const auto* palette = model.anim.get_palette();
+  if (!this->journal.is_open() || !palette) {
+    return;
+  }
+
+  i32 count = palette->get_count();
+  if (count == this->journal_palette.get_count() &&
+      std::equal(
+          palette->get_colors(),
+          // NOLINTNEXTLINE
+          palette->get_colors() + count, this->journal_palette.get_colors()
+      )) {
+    return;
+  }
+
+  this->journal_palette = *palette;
+  std::vector<u8> record{};
+  Journal::encode_palette(*palette, record);
+  this->append_record(std::move(record));
+}
+
+void Caretaker::append_step(RecordType type, u64 seq) noexcept {
+  if (!this->journal.is_open() || this->journal_stale) {
+    return;
+  }
+
+  // Snapshots from before the journal was written have no records to replay
+  // the move on
+  if (seq < this->journal_seq) {
+    this->journal_stale = true;
+    return;
+  }
+
+  std::vector<u8> record{};
+  Journal::encode_step(type, seq, record);
+  this->append_record(std::move(record));
+}
+
+void Caretaker::sync_journal(Model& model) noexcept {
+  bool full = this->journal.get_size() > this->journal_limit;
+  if (!this->journal.is_open() || (!this->journal_stale && !full)) {
+    return;
+  }
+
+  if (this->write_checkpoint(model) != Error::OK) {
+    logger::error("Could not write the history journal again");
+  }
 }
 
-void Caretaker::push_snapshot(Snapshot&& snapshot) noexcept {
-  this->remove_future_snapshots();
+Error Caretaker::write_checkpoint(Model& model) noexcept {
+  // Pending paints are appended first so their seqs are taken. There are
+  // none once stale as the moves wait for the captures
+  this->finish_captures();
+  // Cels are deduped in place, none of the ones read by the journal may be
+  // left to dedup
+  model.anim.dedup_tiles();
+  this->journal_stale = false;
 
-  // Move the cursor and move the new snapshot
-  ++this->cursor;
-  if (this->cursor == this->snapshots.size()) {
-    this->cursor = 0;
+  // The base is the animation at the current snapshot, without the paints
+  // that were not snapped yet. Only the references of the cels are copied,
+  // the records are encoded and written on the journal thread
+  Checkpoint checkpoint{
+      .frame = model.frame_index,
+      .layer = model.layer_index,
+      .seq = this->next_seq};
+  if (checkpoint.anim.copy(this->base) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+  if (auto* palette = checkpoint.anim.get_palette()) {
+    *palette = *model.anim.get_palette();
+    this->journal_palette = *palette;
   }
-  this->snapshots[this->cursor] = std::move(snapshot);
 
-  this->update_cursors();
+  this->journal.checkpoint(std::move(checkpoint));
+  this->journal_seq = this->next_seq;
+  return Error::OK;
+}
+
+Error Caretaker::snap(Model& model) noexcept {
+  assert(this->initialized);
+  assert(
+      this->base.get_frame_count() == model.anim.get_frame_count() &&
+      this->base.get_layer_count() == model.anim.get_layer_count()
+  );
+
+  // Only the cels written since the last snap are deduped, the captures
+  // still running hold none of these so there is no need to wait
+  model.anim.dedup_tiles();
+  // Painting may have added colors
+  this->append_palette(model);
+  // The record of the paint follows the checkpoint
+  this->sync_journal(model);
+
+  i32 frame = model.frame_index;
+  i32 layer = model.layer_index;
+  draw::Cel* before = this->base.get_cel(frame, layer);
+  draw::Cel* after = model.anim.get_cel(frame, layer);
+  if (before == after) {
+    return Error::OK;
+  }
+
+  // The job keeps the cels alive, writes to these are copied from now on
+  if (before) {
+    before->acquire();
+  }
+  if (after) {
+    after->acquire();
+  }
+  // Only the reference of the cel is copied
+  this->base.set_cel(frame, layer, after);
+
+  Entry& entry = this->push_snapshot(Snapshot{});
+  entry.pending = true;
+  ++this->queued_count;
+  this->worker.push(
+      {.type = JobType::CAPTURE,
+       .id = entry.id,
+       .before = before,
+       .after = after,
+       .frame_index = frame,
+       .layer_index = layer,
+       .tile_bytes = (after ? after : before)->get_tile_bytes(),
+       .journal = this->journal.is_open()}
+  );
+  return Error::OK;
+}
+
+Error Caretaker::snap_cels(Model& model) noexcept {
+  assert(this->initialized);
+  assert(
+      this->base.get_frame_count() == model.anim.get_frame_count() &&
+      this->base.get_layer_count() == model.anim.get_layer_count()
+  );
+
+  // The records of the paints still being captured come first
+  this->finish_captures();
+  model.anim.dedup_tiles();
+  this->append_palette(model);
+  this->sync_journal(model);
+
+  // Only the painted cels were replaced since the base was synced. Copies
+  // without changes are left out, replaying would not replace these
+  std::vector<CelDelta> cel_deltas{};
+  std::vector<CelDelta> copies{};
+  std::vector<TileDelta> deltas{};
+  for (i32 f = 0; f < model.anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < model.anim.get_layer_count(); ++l) {
+      draw::Cel* before = this->base.get_cel(f, l);
+      draw::Cel* after = model.anim.get_cel(f, l);
+      if (before != after) {
+        Snapshot::diff(before, after, deltas);
+        (deltas.empty() ? copies : cel_deltas).push_back({f, l, before, after});
+      }
+    }
+  }
+  for (const auto& copy : copies) {
+    this->base.set_cel(copy.frame, copy.layer, copy.after);
+  }
+  if (cel_deltas.empty()) {
+    return Error::OK;
+  }
+
+  // The snapshot keeps the cels alive, writes to these are copied from now on
+  Snapshot snapshot{};
+  snapshot.set_cels(
+      model.frame_index, model.layer_index,
+      std::vector<CelDelta>(cel_deltas)
+  );
+  for (const auto& delta : cel_deltas) {
+    this->base.set_cel(delta.frame, delta.layer, delta.after);
+  }
+
+  if (this->journal.is_open()) {
+    std::vector<u8> record{};
+    Journal::encode_cels(
+        model.frame_index, model.layer_index, cel_deltas, record
+    );
+    this->append_record(std::move(record));
+  }
+
+  this->push_snapshot(std::move(snapshot)).seq = this->next_seq++;
+  return Error::OK;
+}
+
+Error Caretaker::execute(Model& model, Action action) noexcept {
+  assert(this->initialized);
+  this->finish_captures();
+  this->sync_journal(model);
+
+  Snapshot snapshot{};
+  if (snapshot.execute(model, action) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+  this->push_snapshot(std::move(snapshot)).seq = this->next_seq++;
+
+  std::vector<u8> record{};
+  Journal::encode_action(action, record);
+  this->append_record(std::move(record));
+  return this->base.copy(model.anim);
+}
+
+Caretaker::Entry& Caretaker::push_snapshot(Snapshot&& snapshot) noexcept {
+  u64 id = this->next_id++;
+  this->used_bytes += snapshot.get_bytes();
+  this->snapshots.push_back({std::move(snapshot), id, this->current});
+  // The undone snapshots are kept as another branch
+  this->set_active_child(this->current, id);
+  this->current = id;
+
+  // Snapshots queued for compression are not evicted yet
+  this->compress_snapshots();
+  this->evict_snapshots();
+  this->peak_bytes = std::max(this->peak_bytes, this->used_bytes);
+
+  // The latest snapshot is never evicted
+  return this->snapshots.back();
 }
 
 void Caretaker::clear() noexcept {
-  for (auto& snapshot : this->snapshots) {
-    snapshot.reset();
+  this->worker.clear();
+  this->spill.clear();
+  this->compress_start = 0;
+  this->queued_count = 0;
+  this->snapshots.clear();
+  this->base.clear();
+  this->current = this->root_child = NO_SNAPSHOT;
+  this->changed_rect = {};
+  this->initialized = false;
+  this->used_bytes = this->peak_bytes = 0;
+}
+
+i32 Caretaker::get_cursor() const noexcept {
+  return this->current == NO_SNAPSHOT ? 0
+                                      : this->find_snapshot(this->current) + 1;
+}
+
+u64 Caretaker::get_active_child(u64 id) const noexcept {
+  if (id == NO_SNAPSHOT) {
+    return this->root_child;
+  }
+
+  i32 index = this->find_snapshot(id);
+  return index == -1 ? NO_SNAPSHOT : this->snapshots[index].active_child;
+}
+
+void Caretaker::set_active_child(u64 id, u64 child) noexcept {
+  if (id == NO_SNAPSHOT) {
+    this->root_child = child;
+    return;
+  }
+
+  i32 index = this->find_snapshot(id);
+  if (index != -1) {
+    this->snapshots[index].active_child = child;
+  }
+}
+
+void Caretaker::get_children(
+    u64 id, std::vector<u64>& children
+) const noexcept {
+  children.clear();
+  // Children are always pushed after their parent
+  i32 start = 0;
+  if (id != NO_SNAPSHOT) {
+    start = this->find_snapshot(id) + 1;
+    if (start == 0) {
+      return;
+    }
+  }
+  for (i32 i = start; i < (i32)this->snapshots.size(); ++i) {
+    if (this->snapshots[i].parent == id) {
+      children.push_back(this->snapshots[i].id);
+    }
+  }
+}
+
+void Caretaker::select_child(u64 child) noexcept {
+  i32 index = this->find_snapshot(child);
+  if (index == -1 || this->get_active_child(this->current) == child) {
+    return;
+  }
+
+  assert(this->snapshots[index].parent == this->current);
+  this->set_active_child(this->current, child);
+  this->append_step(RecordType::BRANCH, this->snapshots[index].seq);
+}
+
+u64 Caretaker::find_child(u64 id, u64 seq) const noexcept {
+  std::vector<u64> children{};
+  this->get_children(id, children);
+  for (u64 child : children) {
+    i32 index = this->find_snapshot(child);
+    if (index != -1 && this->snapshots[index].seq == seq) {
+      return child;
+    }
   }
+  return NO_SNAPSHOT;
 }
 
-void Caretaker::remove_future_snapshots() noexcept {
-  if (this->cursor == this->end_cursor) {
+void Caretaker::drop_oldest() noexcept {
+  auto& oldest = this->snapshots.front();
+  assert(oldest.parent == NO_SNAPSHOT);
+
+  bool applied = false;
+  for (u64 id = this->current; id != NO_SNAPSHOT;) {
+    if (id == oldest.id) {
+      applied = true;
+      break;
+    }
+
+    i32 index = this->find_snapshot(id);
+    if (index == -1) {
+      break;
+    }
+    id = this->snapshots[index].parent;
+  }
+
+  oldest.dropped = true;
+  for (auto& entry : this->snapshots) {
+    if (entry.dropped) {
+      continue;
+    }
+
+    if (entry.parent == NO_SNAPSHOT) {
+      // Other branches from the start are relative to the old start
+      entry.dropped = applied;
+    } else if (applied && entry.parent == oldest.id) {
+      entry.parent = NO_SNAPSHOT;
+    } else {
+      // Parents come first, so the whole branch is marked in one pass
+      i32 index = this->find_snapshot(entry.parent);
+      entry.dropped = index != -1 && this->snapshots[index].dropped;
+    }
+  }
+
+  if (applied) {
+    this->root_child = oldest.active_child;
+    if (this->current == oldest.id) {
+      this->current = NO_SNAPSHOT;
+    }
+  }
+
+  i32 dropped_before = 0;
+  for (i32 i = 0; i < (i32)this->snapshots.size(); ++i) {
+    auto& entry = this->snapshots[i];
+    if (entry.dropped) {
+      this->used_bytes -= entry.snapshot.get_bytes();
+      dropped_before += i < this->compress_start;
+      if (this->spill.is_open()) {
+        entry.snapshot.free_spill(this->spill);
+      }
+    }
+  }
+  this->snapshots.erase(
+      std::remove_if(
+          this->snapshots.begin(), this->snapshots.end(),
+          [](const Entry& entry) { return entry.dropped; }
+      ),
+      this->snapshots.end()
+  );
+  this->compress_start -= dropped_before;
+
+  if (!applied && this->find_snapshot(this->root_child) == -1) {
+    std::vector<u64> children{};
+    this->get_children(NO_SNAPSHOT, children);
+    this->root_child = children.empty() ? NO_SNAPSHOT : children.back();
+  }
+}
+
+void Caretaker::evict_snapshots() noexcept {
+  if (this->spill.is_open()) {
+    for (auto& entry : this->snapshots) {
+      if (this->used_bytes <= this->budget) {
+        return;
+      }
+
+      if (entry.snapshot.can_spill()) {
+        this->used_bytes -= entry.snapshot.get_bytes();
+        entry.snapshot.spill(this->spill);
+        this->used_bytes += entry.snapshot.get_bytes();
+      }
+    }
+  }
+
+  // Dropped once spilling is not enough, eg. for paints on many cels.
+  // Snapshots that shrink later on their own are not counted, the oldest
+  // one is dropped once collected if it is in flight
+  while (!this->keep_snapshots &&
+         this->used_bytes - this->get_shrinking_bytes() > this->budget &&
+         this->snapshots.size() > 1U && this->current != NO_SNAPSHOT) {
+    const auto& oldest = this->snapshots.front();
+    if (oldest.queued || oldest.pending) {
+      return;
+    }
+    this->drop_oldest();
+  }
+}
+
+i64 Caretaker::get_shrinking_bytes() const noexcept {
+  bool spilling = this->spill.is_open();
+  i64 bytes = 0;
+  for (const auto& entry : this->snapshots) {
+    if (entry.queued || entry.pending ||
+        (spilling && entry.snapshot.can_compress())) {
+      bytes += entry.snapshot.get_bytes();
+    }
+  }
+  return bytes;
+}
+
+void Caretaker::compress_snapshots(Worker::Wait wait) noexcept {
+  // Captured snapshots are only queued for compression once collected
+  this->collect_jobs(
+      wait == Worker::Wait::NONE ? Worker::Wait::NONE : Worker::Wait::CAPTURES
+  );
+
+  // Other branches are also compressed once far enough from the cursor
+  i32 cursor = this->get_cursor();
+  i32 end = cursor - COMPRESS_DISTANCE;
+  for (; this->compress_start < end; ++this->compress_start) {
+    this->queue_snapshot(this->compress_start);
+  }
+
+  // Undone snapshots are compressed again once far enough from the cursor
+  i32 ahead = cursor + COMPRESS_DISTANCE;
+  if (ahead < (i32)this->snapshots.size()) {
+    this->queue_snapshot(ahead);
+  }
+
+  if (wait == Worker::Wait::ALL) {
+    this->collect_jobs(wait);
+  }
+}
+
+void Caretaker::collect_jobs(Worker::Wait wait) noexcept {
+  std::vector<Job> jobs{};
+  this->worker.collect(jobs, wait);
+  for (auto& job : jobs) {
+    if (job.type == JobType::CAPTURE) {
+      this->collect_capture(job);
+    } else {
+      this->collect_compress(job);
+    }
+    job.release();
+    --this->queued_count;
+  }
+
+  if (!jobs.empty()) {
+    this->evict_snapshots();
+    this->peak_bytes = std::max(this->peak_bytes, this->used_bytes);
+  }
+}
+
+void Caretaker::collect_capture(Job& job) noexcept {
+  // The paint is kept in the journal even if its snapshot was dropped
+  if (!job.packed.empty()) {
+    this->append_record(std::move(job.packed));
+  }
+  u64 seq = job.deltas.empty() ? 0U : this->next_seq++;
+
+  i32 index = this->find_snapshot(job.id);
+  if (index == -1) {
     return;
   }
 
-  if (this->cursor < this->end_cursor) {
-    // +2 because +1 will contain the new snapshot
-    logger::debug("Clearing %d -> %d", this->cursor + 2, this->end_cursor);
-    for (i32 i = this->cursor + 2; i <= this->end_cursor; ++i) {
-      this->snapshots[i].reset();
+  if (job.deltas.empty()) {
+    // Nothing changed, as if the snapshot was never pushed. Snaps do not
+    // wait for the capture, the ones pushed since move up to its parent
+    u64 parent = this->snapshots[index].parent;
+    u64 active = this->snapshots[index].active_child;
+    this->used_bytes -= this->snapshots[index].snapshot.get_bytes();
+    this->snapshots.erase(this->snapshots.begin() + index);
+    if (index < this->compress_start) {
+      --this->compress_start;
+    }
+    for (auto& other : this->snapshots) {
+      if (other.parent == job.id) {
+        other.parent = parent;
+      }
+    }
+
+    if (this->current == job.id) {
+      this->current = parent;
+    }
+    if (this->get_active_child(parent) == job.id) {
+      std::vector<u64> children{};
+      this->get_children(parent, children);
+      if (active == NO_SNAPSHOT && !children.empty()) {
+        active = children.back();
+      }
+      this->set_active_child(parent, active);
     }
     return;
   }
 
-  logger::debug(
-      "Clearing 0 -> %d & %d -> %d", this->end_cursor, this->cursor + 2,
-      this->snapshots.size()
+  auto& entry = this->snapshots[index];
+  entry.pending = false;
+  entry.seq = seq;
+  this->used_bytes -= entry.snapshot.get_bytes();
+  entry.snapshot.set_tiles(
+      job.frame_index, job.layer_index, job.tile_bytes, std::move(job.deltas)
   );
-  for (i32 i = this->cursor + 2; i < this->snapshots.size(); ++i) {
-    this->snapshots[i].reset();
+  this->used_bytes += entry.snapshot.get_bytes();
+
+  // Skipped while pending, compressed once far enough from the cursor
+  this->compress_start = std::min(this->compress_start, index);
+}
+
+void Caretaker::collect_compress(Job& job) noexcept {
+  // Snapshot may have been dropped while it was being compressed
+  i32 index = this->find_snapshot(job.id);
+  if (index == -1) {
+    return;
   }
 
-  for (i32 i = 0; i <= this->end_cursor; ++i) {
-    this->snapshots[i].reset();
+  auto& entry = this->snapshots[index];
+  entry.queued = false;
+  this->used_bytes -= entry.snapshot.get_bytes();
+  entry.snapshot.set_packed(std::move(job.packed));
+  this->used_bytes += entry.snapshot.get_bytes();
+}
+
+i32 Caretaker::find_snapshot(u64 id) const noexcept {
+  auto it = std::lower_bound(
+      this->snapshots.begin(), this->snapshots.end(), id,
+      [](const Entry& entry, u64 id) { return entry.id < id; }
+  );
+  if (it == this->snapshots.end() || it->id != id) {
+    return -1;
   }
+  return (i32)(it - this->snapshots.begin());
 }
 
-void Caretaker::update_cursors() noexcept {
-  this->end_cursor = this->cursor;
+void Caretaker::queue_snapshot(i32 index) noexcept {
+  auto& entry = this->snapshots[index];
+  if (entry.queued || entry.pending || !entry.snapshot.can_compress()) {
+    return;
+  }
+
+  Job job{
+      .type = JobType::COMPRESS,
+      .id = entry.id,
+      .deltas = entry.snapshot.get_deltas(),
+      .tile_bytes = entry.snapshot.get_tile_bytes()};
+  // The job keeps the tiles alive until it is collected
+  for (const auto& delta : job.deltas) {
+    if (delta.before) {
+      ++delta.before->refs;
+    }
+    if (delta.after) {
+      ++delta.after->refs;
+    }
+  }
+  entry.queued = true;
+  ++this->queued_count;
+  this->worker.push(std::move(job));
+}
 
-  if (this->start_cursor == -1) {
-    this->start_cursor = 0;
-  } else if (this->start_cursor == this->cursor) {
-    ++this->start_cursor;
+Error Caretaker::decompress_snapshot(i32 index) noexcept {
+  auto& snapshot = this->snapshots[index].snapshot;
+  this->used_bytes -= snapshot.get_bytes();
+  Error error = snapshot.unspill(this->spill);
+  if (error == Error::OK) {
+    error = snapshot.decompress();
   }
+  this->used_bytes += snapshot.get_bytes();
+  this->peak_bytes = std::max(this->peak_bytes, this->used_bytes);
+
+  // Compressed again once it falls behind the cursor
+  this->compress_start = std::min(this->compress_start, index);
+  return error;
 }
 
 bool Caretaker::can_undo() const noexcept {
-  return this->cursor != this->start_cursor;
+  return this->current != NO_SNAPSHOT;
 }
 
-const Snapshot& Caretaker::undo() noexcept {
+Error Caretaker::undo(Model& model) noexcept {
   assert(this->can_undo());
-  if (this->cursor == 0) {
-    this->cursor = this->snapshots.size() - 1;
-  } else {
-    --this->cursor;
+  // The pending snapshot is dropped if nothing changed
+  this->finish_captures();
+  this->changed_rect = {};
+  if (!this->can_undo()) {
+    return Error::OK;
   }
-  logger::debug("Cursor at %d", this->cursor);
-  return this->snapshots[this->cursor];
+
+  i32 index = this->find_snapshot(this->current);
+  if (index == -1 || this->decompress_snapshot(index) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  i32 frame = model.frame_index;
+  i32 layer = model.layer_index;
+  auto& entry = this->snapshots[index];
+  Error error = entry.snapshot.undo(model);
+  if (error == Error::OK) {
+    // Redo comes back to this branch
+    this->current = entry.parent;
+    this->set_active_child(this->current, entry.id);
+    logger::debug("Cursor at %d", this->get_cursor());
+    this->append_step(RecordType::UNDO, entry.seq);
+  }
+
+  return this->sync_base(entry.snapshot, model, frame, layer, error);
 }
 
 bool Caretaker::can_redo() const noexcept {
-  return this->cursor != this->end_cursor;
+  return this->get_active_child(this->current) != NO_SNAPSHOT;
 }
 
-const Snapshot& Caretaker::redo() noexcept {
+Error Caretaker::redo(Model& model) noexcept {
   assert(this->can_redo());
-  ++this->cursor;
-  if (this->cursor == this->snapshots.size()) {
-    this->cursor = 0;
+  this->finish_captures();
+  this->changed_rect = {};
+  if (!this->can_redo()) {
+    return Error::OK;
+  }
+
+  i32 index = this->find_snapshot(this->get_active_child(this->current));
+  if (index == -1 || this->decompress_snapshot(index) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+
+  i32 frame = model.frame_index;
+  i32 layer = model.layer_index;
+  auto& entry = this->snapshots[index];
+  Error error = entry.snapshot.redo(model);
+  if (error == Error::OK) {
+    this->current = entry.id;
+    logger::debug("Cursor at %d", this->get_cursor());
+    this->append_step(RecordType::REDO, entry.seq);
+  }
+
+  return this->sync_base(entry.snapshot, model, frame, layer, error);
+}
+
+u64 Caretaker::get_current() const noexcept {
+  return this->current;
+}
+
+i32 Caretaker::get_branch_count() const noexcept {
+  std::vector<u64> children{};
+  this->get_children(this->current, children);
+  return (i32)children.size();
+}
+
+Error Caretaker::switch_branch(Model& model, i32 offset) noexcept {
+  this->finish_captures();
+  this->changed_rect = {};
+  if (this->current == NO_SNAPSHOT) {
+    return Error::OK;
+  }
+
+  i32 current = this->find_snapshot(this->current);
+  if (current == -1) {
+    return Error::BAD_ALLOC;
+  }
+
+  std::vector<u64> siblings{};
+  this->get_children(this->snapshots[current].parent, siblings);
+  i32 count = (i32)siblings.size();
+  if (count < 2) {
+    return Error::OK;
+  }
+
+  i32 index = (i32)(std::find(siblings.begin(), siblings.end(), this->current) -
+                    siblings.begin());
+  index = ((index + offset) % count + count) % count;
+  return this->goto_snapshot(model, siblings[index]);
+}
+
+Error Caretaker::goto_snapshot(Model& model, u64 id) noexcept {
+  // The path is found before moving, none of it can be dropped on the way
+  bool keep = this->keep_snapshots;
+  this->keep_snapshots = true;
+  Error error = this->walk_to(model, id);
+  this->keep_snapshots = keep;
+
+  this->evict_snapshots();
+  return error;
+}
+
+Error Caretaker::walk_to(Model& model, u64 id) noexcept {
+  this->finish_captures();
+  this->changed_rect = {};
+  if (id != NO_SNAPSHOT && this->find_snapshot(id) < 0) {
+    return Error::BAD_ALLOC;
+  }
+
+  // The snapshot and its parents up to the start
+  std::vector<u64> path{};
+  for (u64 it = id; it != NO_SNAPSHOT;) {
+    i32 index = this->find_snapshot(it);
+    if (index == -1) {
+      return Error::BAD_ALLOC;
+    }
+    path.push_back(it);
+    it = this->snapshots[index].parent;
   }
-  logger::debug("Cursor at %d", this->cursor);
-  return this->snapshots[this->cursor];
+
+  irect changed{};
+  while (this->current != NO_SNAPSHOT &&
+         std::find(path.begin(), path.end(), this->current) == path.end()) {
+    if (this->undo(model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    changed = merge_rects(changed, this->changed_rect);
+  }
+
+  // Path below the common parent
+  i32 depth =
+      (i32)(std::find(path.begin(), path.end(), this->current) - path.begin());
+  for (i32 i = depth - 1; i >= 0; --i) {
+    this->select_child(path[i]);
+    if (this->redo(model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    changed = merge_rects(changed, this->changed_rect);
+  }
+
+  this->changed_rect = changed;
+  return Error::OK;
+}
+
+irect Caretaker::get_changed_rect() const noexcept {
+  return this->changed_rect;
+}
+
+Error Caretaker::sync_base(
+    const Snapshot& snapshot, const Model& model, i32 frame, i32 layer,
+    Error error
+) noexcept {
+  ivec size = model.anim.get_size();
+  this->changed_rect = {0, 0, size.x, size.y};
+
+  // Structural actions and failed paints may have changed any cel
+  if (!snapshot.is_paint() || error != Error::OK) {
+    Error copy_error = this->base.copy(model.anim);
+    return error != Error::OK ? error : copy_error;
+  }
+
+  this->base.set_cel(
+      model.frame_index, model.layer_index,
+      model.anim.get_cel(model.frame_index, model.layer_index)
+  );
+  if (frame == model.frame_index && layer == model.layer_index) {
+    this->changed_rect = snapshot.get_rect(size);
+  }
+  return Error::OK;
+}
+
+void Caretaker::set_budget(i64 budget) noexcept {
+  this->budget = budget;
+  this->evict_snapshots();
+}
+
+i64 Caretaker::get_budget() const noexcept {
+  return this->budget;
+}
+
+void Caretaker::set_journal_limit(i64 limit) noexcept {
+  this->journal_limit = limit;
+}
+
+i64 Caretaker::get_used_bytes() const noexcept {
+  return this->used_bytes;
+}
+
+i64 Caretaker::get_peak_bytes() const noexcept {
+  return this->peak_bytes;
+}
+
+i32 Caretaker::get_snapshot_count() const noexcept {
+  return (i32)this->snapshots.size();
+}
+
+i64 Caretaker::get_spilled_bytes() const noexcept {
+  return this->spill.get_size();
+}
+
+void Caretaker::finish_captures() noexcept {
+  this->compress_snapshots(Worker::Wait::CAPTURES);
+}
+
+void Caretaker::finish_compression() noexcept {
+  this->compress_snapshots(Worker::Wait::ALL);
 }
 
 } // namespace history
@@ -8,60 +8,297 @@
 #ifndef MODULES_HISTORY_CARETAKER_HPP
 #define MODULES_HISTORY_CARETAKER_HPP
 
+#include "./journal.hpp"
 #include "./snapshot.hpp"
-#include <vector>
+#include "./spill.hpp"
+#include "./worker.hpp"
+#include "core/draw/anim.hpp"
+#include "model/model.hpp"
+#include <deque>
 
 namespace history {
 
+// Default memory the history may hold
+const i64 HISTORY_BUDGET = 256LL << 20;
+// Snapshots this many steps behind the cursor are compressed
+const i32 COMPRESS_DISTANCE = 8;
+// Parent of the first snapshots, the state the history started from
+const u64 NO_SNAPSHOT = ~0ULL;
+// Default size of the journal before it is written again from the current
+// animation
+const i64 JOURNAL_LIMIT = 256LL << 20;
+
+/**
+ * Tree of the changes of the model.
+ * Each snapshot holds the changes from its parent, undo and redo apply these
+ * on the model. Pushing after an undo starts a new branch instead of
+ * dropping the undone snapshots, branches only keep their own tiles.
+ * Paints are captured and older snapshots are compressed in the background.
+ * Once the snapshots go over the budget the oldest compressed ones are moved
+ * to the spill file, the oldest ones are dropped if that is not enough
+ **/
 class Caretaker {
 public:
   Caretaker(const Caretaker&) noexcept = delete;
   Caretaker& operator=(const Caretaker&) noexcept = delete;
 
-  explicit Caretaker(i32 capacity = 50) noexcept;
-  Caretaker(Caretaker&&) noexcept = default;
-  Caretaker& operator=(Caretaker&&) noexcept = default;
-  ~Caretaker() noexcept = default;
+  explicit Caretaker(i64 budget = HISTORY_BUDGET) noexcept;
+  Caretaker(Caretaker&&) noexcept = delete;
+  Caretaker& operator=(Caretaker&&) noexcept = delete;
+  // Pending paints are still appended to the journal
+  ~Caretaker() noexcept;
+
+  /**
+   * First call to initialize or re-initialize the caretaker,
+   * the current state of the model is the start of the timeline
+   **/
+  Error init(const Model& model) noexcept;
+
+  /**
+   * Moves snapshots over the budget to a scratch file instead of dropping
+   * them, see SpillFile::open().
+   * Errors if the file could not be created
+   **/
+  Error init_spill(const c8* path = nullptr) noexcept;
 
   /**
-   * First call to initialize or re-initialize the caretaker
+   * Replays the journal at the path on the model, rebuilding the animation
+   * and its history, then appends every change to it. A new journal starts
+   * from the current animation, call this right after init().
+   * Torn records at the end are cut off. If a record could not be replayed
+   * the journal is copied next to it with a .bak extension first and the
+   * records after it are dropped.
+   * The journal is written again from the current snapshot once it goes
+   * over the journal limit or the history moved to a snapshot from before
+   * that, on the next change or once closed. The older snapshots are not
+   * replayed then.
+   * Errors if the file is not a journal or could not be opened
    **/
-  void init(Snapshot&& snapshot) noexcept;
+  Error open_journal(const c8* path, Model& model) noexcept;
+  // Waits for the pending records to be written and closes the journal
+  void close_journal(Model& model) noexcept;
 
   /**
-   * Pushes a new snapshot to the caretaker
+   * Pushes the changes of the current cel since the last snapshot,
+   * nothing is pushed if nothing changed. The tiles of the animation are
+   * deduped first.
+   * The changed tiles are found on the worker, the cel is shared with the
+   * job so later writes copy it instead.
    * call init first before calling this function
    **/
-  void push_snapshot(Snapshot&& snapshot) noexcept;
+  Error snap(Model& model) noexcept;
 
+  /**
+   * Same as snap() but pushes the changes of every cel as one snapshot,
+   * for paints on more than the current cel. The cels are compared right
+   * away instead of on the worker
+   **/
+  Error snap_cels(Model& model) noexcept;
+
+  /**
+   * Performs a structural action on the model and pushes it,
+   * eg. inserting or removing frames
+   **/
+  Error execute(Model& model, Action action) noexcept;
+
+  // Only the cel and the tiles of the snapshot are restored
   [[nodiscard]] bool can_undo() const noexcept;
-  [[nodiscard]] const Snapshot& undo() noexcept;
+  Error undo(Model& model) noexcept;
   [[nodiscard]] bool can_redo() const noexcept;
-  [[nodiscard]] const Snapshot& redo() noexcept;
+  // Goes to the child of the current snapshot that was visited last
+  Error redo(Model& model) noexcept;
+
+  /**
+   * Rect of the current cel changed by the last undo or redo,
+   * the whole animation if the current frame or layer changed
+   **/
+  [[nodiscard]] irect get_changed_rect() const noexcept;
+
+  // === Branches === //
+
+  // Snapshot applied last, NO_SNAPSHOT at the start of the history
+  [[nodiscard]] u64 get_current() const noexcept;
+  // Snapshots that redo can go to from the current snapshot
+  [[nodiscard]] i32 get_branch_count() const noexcept;
+
+  /**
+   * Moves to a sibling of the current snapshot, the next one pushed after it
+   * for a positive offset. Does nothing without siblings
+   **/
+  Error switch_branch(Model& model, i32 offset = 1) noexcept;
+
+  /**
+   * Undoes up to the common parent of the snapshot then redoes down to it,
+   * only the snapshots between the two are applied. Nothing is dropped
+   * until the snapshot is reached.
+   * Errors if the snapshot was dropped
+   **/
+  Error goto_snapshot(Model& model, u64 id) noexcept;
+
+  // === Memory Usage === //
+
+  /**
+   * Sets the bytes the snapshots can use, the oldest snapshots are dropped
+   * if the new budget is smaller
+   **/
+  void set_budget(i64 budget) noexcept;
+
+  [[nodiscard]] i64 get_budget() const noexcept;
+
+  // Sets the size the journal can grow to, see open_journal()
+  void set_journal_limit(i64 limit) noexcept;
+  // Bytes used by all the snapshots
+  [[nodiscard]] i64 get_used_bytes() const noexcept;
+  // Highest get_used_bytes() since init()
+  [[nodiscard]] i64 get_peak_bytes() const noexcept;
+  [[nodiscard]] i32 get_snapshot_count() const noexcept;
+  // Bytes of the spill file still used by snapshots
+  [[nodiscard]] i64 get_spilled_bytes() const noexcept;
+
+  // Blocks until all the queued snapshots are captured
+  void finish_captures() noexcept;
+  // Blocks until all the queued snapshots are captured and compressed
+  void finish_compression() noexcept;
 
 private:
-  // NOTE: Can be optimized with using a better datastructure with less overhead
-  // Only needs a container that does not grow but can be resized
-  std::vector<Snapshot> snapshots{};
-  i32 cursor = -1;
-  i32 start_cursor = -1;
-  i32 end_cursor = -1;
+  struct Entry {
+    Snapshot snapshot{};
+    // Increasing, used to find the snapshot of a job
+    u64 id = 0U;
+    // Always pushed before its children
+    u64 parent = NO_SNAPSHOT;
+    // Child that redo goes to
+    u64 active_child = NO_SNAPSHOT;
+    bool queued = false;
+    // Still being captured, empty until the job is collected
+    bool pending = false;
+    // Removed with its branch once evicted
+    bool dropped = false;
+    // Order of its record in the journal, unlike the id this is the same
+    // when replaying. 0 until the snapshot has a record
+    u64 seq = 0U;
+  };
+
+  // Oldest snapshot at the front, sorted by id
+  std::deque<Entry> snapshots{};
+  // State of the animation at the current snapshot, shares the cels of the
+  // model
+  draw::Anim base{};
+  u64 current = NO_SNAPSHOT;
+  // Child of the start that redo goes to
+  u64 root_child = NO_SNAPSHOT;
+  irect changed_rect{};
+  bool initialized = false;
+
+  i64 budget = HISTORY_BUDGET;
+  i64 journal_limit = JOURNAL_LIMIT;
+  i64 used_bytes = 0;
+  i64 peak_bytes = 0;
+
+  Worker worker{};
+  SpillFile spill{};
+  Journal journal{};
+  // Palette as of the last record, a new one is appended once it changes
+  draw::Palette journal_palette{};
+  u64 next_id = 0U;
+  u64 next_seq = 1U;
+  // Seq of the first snapshot with a record since the journal was written
+  u64 journal_seq = 1U;
+  // Set once the history moved to a snapshot without a record
+  bool journal_stale = false;
+  // Set while the journal is replayed or the history moves to a snapshot,
+  // the snapshots that are walked must stay until it is done
+  bool keep_snapshots = false;
+  // Capture and compress jobs in flight
+  i32 queued_count = 0;
+  // Snapshots before this index were already queued for compression
+  i32 compress_start = 0;
 
   void clear() noexcept;
 
+  // Applies a record of the journal on the model and the history
+  Error replay(const Record& record, Model& model) noexcept;
+  void append_record(std::vector<u8>&& record) noexcept;
+  // Appends the palette of the model if it changed since the last record
+  void append_palette(Model& model) noexcept;
+  // Appends a move to the snapshot with the seq, see Journal::encode_step()
+  void append_step(RecordType type, u64 seq) noexcept;
+
+  /**
+   * Writes the journal again from the current snapshot if it cannot replay
+   * the history or is over the limit, called before the next change is
+   * appended
+   **/
+  void sync_journal(Model& model) noexcept;
+  Error write_checkpoint(Model& model) noexcept;
+
+  Error walk_to(Model& model, u64 id) noexcept;
+
+  // Returns the entry of the snapshot
+  Entry& push_snapshot(Snapshot&& snapshot) noexcept;
+
+  // How many snapshots come before and including the current one
+  [[nodiscard]] i32 get_cursor() const noexcept;
+
+  [[nodiscard]] u64 get_active_child(u64 id) const noexcept;
+  void set_active_child(u64 id, u64 child) noexcept;
+  // Children of the snapshot, oldest first
+  void get_children(u64 id, std::vector<u64>& children) const noexcept;
+  // Makes redo go to the child of the current snapshot, kept in the journal
+  void select_child(u64 child) noexcept;
+  // Child of the snapshot with the seq, NO_SNAPSHOT if there is none
+  [[nodiscard]] u64 find_child(u64 id, u64 seq) const noexcept;
+
   /**
-   * When pushing a new snapshot in a middle timeline,
-   * future snapshots needs to be freed
+   * Drops the oldest snapshot. If it is applied the state after it becomes
+   * the start of the history and the other branches from the start are
+   * dropped, otherwise its whole branch is dropped
    **/
-  void remove_future_snapshots() noexcept;
+  void drop_oldest() noexcept;
 
   /**
-   * Updates start_cursor and end_cursor
+   * Matches the base with the model after a snapshot was applied, a paint
+   * only changed the current cel.
+   * @param frame - current frame before the snapshot was applied
+   * @param layer - current layer before the snapshot was applied
+   **/
+  Error sync_base(
+      const Snapshot& snapshot, const Model& model, i32 frame, i32 layer,
+      Error error
+  ) noexcept;
+
+  /**
+   * Spills the oldest snapshots until the budget is met, without a spill
+   * file or if spilling is not enough these are dropped. Snapshots being
+   * captured or compressed are not counted and not dropped, the current
+   * snapshot is always kept. Nothing is dropped while replaying or moving
+   * to another snapshot
+   **/
+  void evict_snapshots() noexcept;
+  /**
+   * Bytes of the snapshots being captured or compressed, with a spill file
+   * also of the ones spilled once compressed
    **/
-  void update_cursors() noexcept;
+  [[nodiscard]] i64 get_shrinking_bytes() const noexcept;
+
+  /**
+   * Fills the captured snapshots and replaces the snapshots with their
+   * compressed pixels once finished, then queues the snapshots that are far
+   * enough from the cursor
+   **/
+  void compress_snapshots(Worker::Wait wait = Worker::Wait::NONE) noexcept;
+  void queue_snapshot(i32 index) noexcept;
+  void collect_jobs(Worker::Wait wait) noexcept;
+  void collect_capture(Job& job) noexcept;
+  void collect_compress(Job& job) noexcept;
+
+  // Returns the index of the snapshot of the job, -1 if it was dropped
+  [[nodiscard]] i32 find_snapshot(u64 id) const noexcept;
+
+  // Reads back and decompresses the snapshot before it gets applied
+  Error decompress_snapshot(i32 index) noexcept;
 };
 
 } // namespace history
 
 #endif
-
@@ -0,0 +1,732 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#include "./journal.hpp"
+#include "./rle.hpp"
+#include "core/logger/logger.hpp"
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace history {
+
+const u8 JOURNAL_MAGIC[4] = {'P', 'X', 'L', 'J'};
+const u32 JOURNAL_VERSION = 2U;
+// Size, checksum and type of a record
+const i32 RECORD_HEADER_SIZE = 9;
+// Most frames or layers a replayed action may insert at once, more is only
+// possible in a damaged journal
+const i32 MAX_INSERT_COUNT = 1 << 16;
+
+// Writes the buffered records to the disk
+inline bool sync(std::FILE* file) noexcept {
+  if (std::fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+inline bool write_header(std::FILE* file) noexcept {
+  return std::fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), file) ==
+             sizeof(JOURNAL_MAGIC) &&
+         std::fwrite(&JOURNAL_VERSION, sizeof(u32), 1, file) == 1U;
+}
+
+// FNV-1a, catches records that were only partly written
+inline u32 checksum(const u8* data, i64 size) noexcept {
+  u32 hash = 0x811c'9dc5U;
+  for (i64 i = 0; i < size; ++i) {
+    // NOLINTNEXTLINE
+    hash = (hash ^ data[i]) * 0x0100'0193U;
+  }
+  return hash;
+}
+
+template <typename T> void put(std::vector<u8>& record, T value) noexcept {
+  u64 offset = record.size();
+  record.resize(offset + sizeof(T));
+  // NOLINTNEXTLINE
+  std::memcpy(record.data() + offset, &value, sizeof(T));
+}
+
+inline void begin_record(std::vector<u8>& record, RecordType type) noexcept {
+  record.clear();
+  record.resize(RECORD_HEADER_SIZE - 1);
+  put(record, type);
+}
+
+// Fills the size and checksum of the record
+inline void end_record(std::vector<u8>& record) noexcept {
+  u32 size = record.size() - RECORD_HEADER_SIZE;
+  // Type and data
+  u32 sum = checksum(record.data() + 8, (i64)record.size() - 8);
+  std::memcpy(record.data(), &size, sizeof(u32));
+  // NOLINTNEXTLINE
+  std::memcpy(record.data() + 4, &sum, sizeof(u32));
+}
+
+// Reads the data of a record in order, fails once past the end
+struct Reader {
+  const u8* data = nullptr;
+  i32 size = 0;
+  i32 offset = 0;
+
+  template <typename T> [[nodiscard]] bool get(T& out) noexcept {
+    if (this->offset + (i32)sizeof(T) > this->size) {
+      return false;
+    }
+    // NOLINTNEXTLINE
+    std::memcpy(&out, this->data + this->offset, sizeof(T));
+    this->offset += sizeof(T);
+    return true;
+  }
+};
+
+Journal::~Journal() noexcept {
+  this->close();
+}
+
+Error Journal::open(const c8* path, i64 valid_size) noexcept {
+  assert(path != nullptr);
+  this->close();
+
+  // Torn records are cut off so new records follow the valid ones
+  std::error_code error{};
+  if (valid_size > get_header_size() && std::filesystem::exists(path, error)) {
+    std::filesystem::resize_file(path, valid_size, error);
+    if (error) {
+      return Error::BAD_ALLOC;
+    }
+    // NOLINTNEXTLINE
+    this->file = std::fopen(path, "ab");
+    this->size = valid_size;
+  } else {
+    // NOLINTNEXTLINE
+    this->file = std::fopen(path, "wb");
+    if (this->file) {
+      write_header(this->file);
+    }
+    this->size = get_header_size();
+  }
+
+  if (!this->file) {
+    return Error::BAD_ALLOC;
+  }
+  this->path = path;
+
+  this->stopping = false;
+  this->failed = false;
+  this->worker = std::thread{&Journal::run, this};
+  return Error::OK;
+}
+
+void Journal::close() noexcept {
+  if (!this->is_open()) {
+    return;
+  }
+
+  this->flush();
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->stopping = true;
+  }
+  this->queued.notify_one();
+  this->worker.join();
+
+  // A failed checkpoint may have left no file
+  if (this->file) {
+    std::fclose(this->file);
+    this->file = nullptr;
+  }
+}
+
+bool Journal::is_open() const noexcept {
+  // The file is swapped by the worker on a checkpoint
+  return this->worker.joinable();
+}
+
+i64 Journal::get_size() const noexcept {
+  return this->size;
+}
+
+void Journal::write(std::vector<u8>&& record) noexcept {
+  assert(this->is_open());
+  this->release_checkpoints();
+  this->size += (i64)record.size();
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->records.push_back(std::move(record));
+  }
+  this->queued.notify_one();
+}
+
+void Journal::flush() noexcept {
+  {
+    std::unique_lock<std::mutex> lock{this->mutex};
+    this->synced.wait(lock, [this]() {
+      return this->records.empty() && this->checkpoints.empty() &&
+             !this->busy;
+    });
+  }
+  this->release_checkpoints();
+}
+
+void Journal::checkpoint(Checkpoint&& checkpoint) noexcept {
+  assert(this->is_open());
+  this->release_checkpoints();
+  // Counted once written
+  this->size = get_header_size();
+
+  std::vector<std::vector<u8>> records{};
+  std::vector<Checkpoint> checkpoints{};
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    // Not started yet, replaced by the newer one
+    this->checkpoint_count += this->checkpoints.empty() ? 1 : 0;
+    records.swap(this->records);
+    checkpoints.swap(this->checkpoints);
+    this->checkpoints.push_back(std::move(checkpoint));
+  }
+  this->queued.notify_one();
+}
+
+void Journal::release_checkpoints() noexcept {
+  std::vector<Checkpoint> written{};
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    written.swap(this->written);
+  }
+  if (written.empty()) {
+    return;
+  }
+
+  // Only the last one is the start of the file
+  this->checkpoint_count -= (i32)written.size();
+  if (this->checkpoint_count == 0) {
+    this->size += written.back().bytes - get_header_size();
+  }
+}
+
+bool Journal::replace(Checkpoint& checkpoint) noexcept {
+  const auto& anim = checkpoint.anim;
+  std::vector<u8> records{};
+  std::vector<u8> record{};
+  encode_init(anim.get_size(), anim.get_type(), record);
+  records.insert(records.end(), record.begin(), record.end());
+  encode_anim(anim, checkpoint.frame, checkpoint.layer, checkpoint.seq, record);
+  records.insert(records.end(), record.begin(), record.end());
+  if (const auto* palette = checkpoint.anim.get_palette()) {
+    encode_palette(*palette, record);
+    records.insert(records.end(), record.begin(), record.end());
+  }
+  checkpoint.bytes = get_header_size() + (i64)records.size();
+
+  // A crash before the rename leaves the old journal as is
+  std::string temp = this->path + ".tmp";
+  // NOLINTNEXTLINE
+  std::FILE* file = std::fopen(temp.c_str(), "wb");
+  bool ok = file != nullptr && write_header(file) &&
+            std::fwrite(records.data(), 1, records.size(), file) ==
+                records.size() &&
+            sync(file);
+  if (file) {
+    std::fclose(file);
+  }
+
+  std::error_code error{};
+  if (!ok) {
+    std::filesystem::remove(temp, error);
+    return false;
+  }
+
+  // The old file is closed first, it cannot be replaced while open on some
+  // platforms
+  std::fclose(this->file);
+  std::filesystem::rename(temp, this->path, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+  }
+  // NOLINTNEXTLINE
+  this->file = std::fopen(this->path.c_str(), "ab");
+  return !error && this->file != nullptr;
+}
+
+void Journal::run() noexcept {
+  std::vector<std::vector<u8>> batch{};
+  std::vector<Checkpoint> checkpoints{};
+  std::unique_lock<std::mutex> lock{this->mutex};
+  while (true) {
+    this->queued.wait(lock, [this]() {
+      return this->stopping || !this->records.empty() ||
+             !this->checkpoints.empty();
+    });
+    if (this->records.empty() && this->checkpoints.empty()) {
+      return;
+    }
+
+    // Everything queued while the last batch was syncing goes in one sync,
+    // after the checkpoint if one was queued
+    batch.swap(this->records);
+    checkpoints.swap(this->checkpoints);
+    this->busy = true;
+    lock.unlock();
+
+    // Records after a failed write would not replay, nothing is written
+    // once it failed
+    bool ok = !this->failed;
+    for (auto& checkpoint : checkpoints) {
+      ok = ok && this->replace(checkpoint);
+    }
+    for (const auto& record : batch) {
+      ok = ok && std::fwrite(record.data(), 1, record.size(), this->file) ==
+                     record.size();
+    }
+    ok = ok && sync(this->file);
+    batch.clear();
+
+    lock.lock();
+    if (!ok && !this->failed) {
+      logger::error("Could not write to the history journal");
+    }
+    this->failed = this->failed || !ok;
+    for (auto& checkpoint : checkpoints) {
+      this->written.push_back(std::move(checkpoint));
+    }
+    checkpoints.clear();
+    this->busy = false;
+    this->synced.notify_all();
+  }
+}
+
+// === Reading === //
+
+Error Journal::read(const c8* path, std::vector<u8>& bytes) noexcept {
+  bytes.clear();
+
+  // NOLINTNEXTLINE
+  std::FILE* file = std::fopen(path, "rb");
+  if (!file) {
+    return Error::OK;
+  }
+
+  u8 buffer[4096];
+  u64 count = 0U;
+  while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0U) {
+    // NOLINTNEXTLINE
+    bytes.insert(bytes.end(), buffer, buffer + count);
+  }
+  std::fclose(file);
+
+  // A crash before the header was synced leaves nothing to replay
+  if ((i64)bytes.size() < get_header_size()) {
+    bytes.clear();
+    return Error::OK;
+  }
+
+  u32 version = 0U;
+  // NOLINTNEXTLINE
+  std::memcpy(&version, bytes.data() + sizeof(JOURNAL_MAGIC), sizeof(u32));
+  if (std::memcmp(bytes.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+      version != JOURNAL_VERSION) {
+    bytes.clear();
+    return Error::BAD_ALLOC;
+  }
+  return Error::OK;
+}
+
+bool Journal::next(
+    const std::vector<u8>& bytes, i64& offset, Record& record
+) noexcept {
+  if (offset + RECORD_HEADER_SIZE > (i64)bytes.size()) {
+    return false;
+  }
+
+  u32 size = 0U;
+  u32 sum = 0U;
+  // NOLINTNEXTLINE
+  const u8* header = bytes.data() + offset;
+  std::memcpy(&size, header, sizeof(u32));
+  // NOLINTNEXTLINE
+  std::memcpy(&sum, header + 4, sizeof(u32));
+  if (offset + RECORD_HEADER_SIZE + (i64)size > (i64)bytes.size()) {
+    return false;
+  }
+  // NOLINTNEXTLINE
+  if (checksum(header + 8, (i64)size + 1) != sum) {
+    return false;
+  }
+
+  // NOLINTNEXTLINE
+  record.type = (RecordType)header[8];
+  // NOLINTNEXTLINE
+  record.data = header + RECORD_HEADER_SIZE;
+  record.size = (i32)size;
+  offset += RECORD_HEADER_SIZE + size;
+  return true;
+}
+
+i64 Journal::get_header_size() noexcept {
+  return sizeof(JOURNAL_MAGIC) + sizeof(JOURNAL_VERSION);
+}
+
+// === Records === //
+
+void Journal::encode_init(
+    ivec size, draw::ColorType type, std::vector<u8>& record
+) noexcept {
+  begin_record(record, RecordType::INIT);
+  put(record, size.x);
+  put(record, size.y);
+  put(record, (i32)type);
+  end_record(record);
+}
+
+// Frame and layer of the cel then the tiles after the paint
+inline void put_paint(
+    i32 frame, i32 layer, const std::vector<TileDelta>& deltas,
+    i32 tile_bytes, std::vector<u8>& record
+) noexcept {
+  put(record, frame);
+  put(record, layer);
+  put(record, tile_bytes);
+  put(record, (i32)deltas.size());
+
+  i32 pixel_size = tile_bytes / (draw::TILE_SIZE * draw::TILE_SIZE);
+  for (const auto& delta : deltas) {
+    put(record, delta.index);
+    put(record, (u8)(delta.after != nullptr));
+    if (delta.after) {
+      rle_encode(delta.after->get_ptr(), tile_bytes, pixel_size, record);
+    }
+  }
+}
+
+void Journal::encode_paint(
+    i32 frame, i32 layer, const std::vector<TileDelta>& deltas,
+    i32 tile_bytes, std::vector<u8>& record
+) noexcept {
+  begin_record(record, RecordType::PAINT);
+  put_paint(frame, layer, deltas, tile_bytes, record);
+  end_record(record);
+}
+
+void Journal::encode_cels(
+    i32 frame, i32 layer, const std::vector<CelDelta>& cel_deltas,
+    std::vector<u8>& record
+) noexcept {
+  begin_record(record, RecordType::PAINT_CELS);
+  put(record, frame);
+  put(record, layer);
+  put(record, (i32)cel_deltas.size());
+
+  std::vector<TileDelta> deltas{};
+  for (const auto& delta : cel_deltas) {
+    Snapshot::diff(delta.before, delta.after, deltas);
+    const auto* cel = delta.after ? delta.after : delta.before;
+    put_paint(
+        delta.frame, delta.layer, deltas, cel ? cel->get_tile_bytes() : 0,
+        record
+    );
+  }
+  end_record(record);
+}
+
+void Journal::encode_action(Action action, std::vector<u8>& record) noexcept {
+  begin_record(record, RecordType::ACTION);
+  put(record, action.type);
+  put(record, action.index);
+  put(record, action.count);
+  put(record, action.to);
+  end_record(record);
+}
+
+void Journal::encode_step(
+    RecordType type, u64 seq, std::vector<u8>& record
+) noexcept {
+  begin_record(record, type);
+  put(record, seq);
+  end_record(record);
+}
+
+void Journal::encode_palette(
+    const draw::Palette& palette, std::vector<u8>& record
+) noexcept {
+  begin_record(record, RecordType::PALETTE);
+  i32 count = palette.get_count();
+  put(record, count);
+  // Index 0 is always transparent
+  for (i32 i = 1; i < count; ++i) {
+    put(record, palette.get_color((u8)i));
+  }
+  end_record(record);
+}
+
+void Journal::encode_anim(
+    const draw::Anim& anim, i32 frame, i32 layer, u64 seq,
+    std::vector<u8>& record
+) noexcept {
+  begin_record(record, RecordType::ANIM);
+  put(record, anim.get_frame_count());
+  put(record, anim.get_layer_count());
+  put(record, frame);
+  put(record, layer);
+  put(record, seq);
+
+  // Filled once the empty cels are skipped
+  u64 count_offset = record.size();
+  i32 count = 0;
+  put(record, count);
+
+  std::vector<TileDelta> deltas{};
+  for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      const auto* cel = anim.get_cel(f, l);
+      Snapshot::diff(nullptr, cel, deltas);
+      if (!deltas.empty()) {
+        put_paint(f, l, deltas, cel->get_tile_bytes(), record);
+        ++count;
+      }
+    }
+  }
+  // NOLINTNEXTLINE
+  std::memcpy(record.data() + count_offset, &count, sizeof(i32));
+  end_record(record);
+}
+
+Error Journal::decode_init(
+    const Record& record, ivec& size, draw::ColorType& type
+) noexcept {
+  Reader reader{record.data, record.size};
+  i32 type_value = 0;
+  if (!reader.get(size.x) || !reader.get(size.y) ||
+      !reader.get(type_value) || size.x <= 0 || size.y <= 0) {
+    return Error::BAD_ALLOC;
+  }
+  type = (draw::ColorType)type_value;
+  return type == draw::RGBA8 || type == draw::RGBA16 || type == draw::INDEXED8
+             ? Error::OK
+             : Error::BAD_ALLOC;
+}
+
+Error Journal::decode_action(
+    const Record& record, const draw::Anim& anim, Action& action
+) noexcept {
+  Reader reader{record.data, record.size};
+  if (!reader.get(action.type) || !reader.get(action.index) ||
+      !reader.get(action.count) || !reader.get(action.to)) {
+    return Error::BAD_ALLOC;
+  }
+
+  // Same checks as the asserts of the animation
+  i32 frames = anim.get_frame_count();
+  i32 layers = anim.get_layer_count();
+  i32 index = action.index;
+  i32 count = action.count;
+  bool valid = false;
+  switch (action.type) {
+  case ActionType::INSERT_FRAMES:
+    valid = index >= 0 && index <= frames && count > 0 &&
+            count <= MAX_INSERT_COUNT;
+    break;
+  case ActionType::INSERT_LAYERS:
+    valid = index >= 0 && index <= layers && count > 0 &&
+            count <= MAX_INSERT_COUNT;
+    break;
+  case ActionType::REMOVE_FRAMES:
+    valid = index >= 0 && count > 0 && count < frames &&
+            index <= frames - count;
+    break;
+  case ActionType::REMOVE_LAYERS:
+    valid = index >= 0 && count > 0 && count < layers &&
+            index <= layers - count;
+    break;
+  case ActionType::MOVE_FRAME:
+    valid = index >= 0 && index < frames && action.to >= 0 &&
+            action.to < frames;
+    break;
+  case ActionType::MOVE_LAYER:
+    valid = index >= 0 && index < layers && action.to >= 0 &&
+            action.to < layers;
+    break;
+  case ActionType::DUPLICATE_FRAME:
+    valid = index >= 0 && index < frames;
+    break;
+  case ActionType::DUPLICATE_LAYER:
+    valid = index >= 0 && index < layers;
+    break;
+  case ActionType::PAINT:
+  case ActionType::PAINT_CELS:
+  default:
+    break;
+  }
+  return valid ? Error::OK : Error::BAD_ALLOC;
+}
+
+Error Journal::decode_step(const Record& record, u64& seq) noexcept {
+  Reader reader{record.data, record.size};
+  return reader.get(seq) && seq > 0U ? Error::OK : Error::BAD_ALLOC;
+}
+
+Error Journal::decode_palette(
+    const Record& record, draw::Palette& palette
+) noexcept {
+  Reader reader{record.data, record.size};
+  i32 count = 0;
+  if (!reader.get(count) || count <= 0 || count > draw::PALETTE_SIZE) {
+    return Error::BAD_ALLOC;
+  }
+
+  rgba8 colors[draw::PALETTE_SIZE]{};
+  for (i32 i = 1; i < count; ++i) {
+    if (!reader.get(colors[i])) {
+      return Error::BAD_ALLOC;
+    }
+  }
+  palette.set_colors(colors, count);
+  return Error::OK;
+}
+
+// Writes the tiles of put_paint() on the cel and moves the model to it
+inline Error decode_tiles(Reader& reader, Model& model) noexcept {
+  i32 frame = 0;
+  i32 layer = 0;
+  i32 tile_bytes = 0;
+  i32 count = 0;
+  if (!reader.get(frame) || !reader.get(layer) || !reader.get(tile_bytes) ||
+      !reader.get(count)) {
+    return Error::BAD_ALLOC;
+  }
+
+  auto& anim = model.anim;
+  i32 pixel_size = 0x0000'ffff & anim.get_type();
+  ivec size = anim.get_size();
+  i32 tile_count = ((size.x + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT) *
+                   ((size.y + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT);
+  if (frame < 0 || frame >= anim.get_frame_count() || layer < 0 ||
+      layer >= anim.get_layer_count() ||
+      tile_bytes != draw::TILE_SIZE * draw::TILE_SIZE * pixel_size) {
+    return Error::BAD_ALLOC;
+  }
+
+  model.frame_index = frame;
+  model.layer_index = layer;
+  model.layer = anim.get_layer(frame, layer);
+
+  auto& store = draw::get_tile_store();
+  for (i32 i = 0; i < count; ++i) {
+    i32 index = 0;
+    u8 has_tile = 0U;
+    if (!reader.get(index) || !reader.get(has_tile) || index < 0 ||
+        index >= tile_count) {
+      return Error::BAD_ALLOC;
+    }
+
+    draw::Tile* tile = nullptr;
+    if (has_tile) {
+      tile = store.allocate(tile_bytes);
+      if (!tile) {
+        return Error::BAD_ALLOC;
+      }
+      // NOLINTNEXTLINE
+      const u8* src = reader.data + reader.offset;
+      const u8* end = rle_decode(
+          // NOLINTNEXTLINE
+          src, reader.data + reader.size, tile->get_ptr(), tile_bytes,
+          pixel_size
+      );
+      if (!end) {
+        draw::release_tile(tile, tile_bytes);
+        return Error::BAD_ALLOC;
+      }
+      reader.offset += (i32)(end - src);
+    }
+
+    // The cel keeps its own reference of the tile
+    Error error = model.layer.set_tile(index, tile);
+    draw::release_tile(tile, tile_bytes);
+    if (error != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+  }
+  return Error::OK;
+}
+
+Error Journal::decode_paint(const Record& record, Model& model) noexcept {
+  Reader reader{record.data, record.size};
+  return decode_tiles(reader, model);
+}
+
+Error Journal::decode_cels(const Record& record, Model& model) noexcept {
+  Reader reader{record.data, record.size};
+  i32 frame = 0;
+  i32 layer = 0;
+  i32 count = 0;
+  if (!reader.get(frame) || !reader.get(layer) || !reader.get(count) ||
+      frame < 0 || frame >= model.anim.get_frame_count() || layer < 0 ||
+      layer >= model.anim.get_layer_count()) {
+    return Error::BAD_ALLOC;
+  }
+
+  for (i32 i = 0; i < count; ++i) {
+    if (decode_tiles(reader, model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+  }
+
+  model.frame_index = frame;
+  model.layer_index = layer;
+  model.layer = model.anim.get_layer(frame, layer);
+  return Error::OK;
+}
+
+Error Journal::decode_anim(
+    const Record& record, Model& model, u64& seq
+) noexcept {
+  Reader reader{record.data, record.size};
+  i32 frames = 0;
+  i32 layers = 0;
+  i32 frame = 0;
+  i32 layer = 0;
+  i32 count = 0;
+  if (!reader.get(frames) || !reader.get(layers) || !reader.get(frame) ||
+      !reader.get(layer) || !reader.get(seq) || !reader.get(count) ||
+      frames <= 0 || frames > MAX_INSERT_COUNT || layers <= 0 ||
+      layers > MAX_INSERT_COUNT || frame < 0 || frame >= frames ||
+      layer < 0 || layer >= layers || seq == 0U) {
+    return Error::BAD_ALLOC;
+  }
+
+  auto& anim = model.anim;
+  if (anim.init(anim.get_size(), anim.get_type()) != Error::OK ||
+      (frames > 1 && anim.insert_frames(1, frames - 1) != Error::OK) ||
+      (layers > 1 && anim.insert_layers(1, layers - 1) != Error::OK)) {
+    return Error::BAD_ALLOC;
+  }
+
+  for (i32 i = 0; i < count; ++i) {
+    if (decode_tiles(reader, model) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+  }
+
+  model.frame_index = frame;
+  model.layer_index = layer;
+  model.layer = anim.get_layer(frame, layer);
+  return Error::OK;
+}
+
+} // namespace history
@@ -0,0 +1,245 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#ifndef MODULES_HISTORY_JOURNAL_HPP
+#define MODULES_HISTORY_JOURNAL_HPP
+
+#include "./snapshot.hpp"
+#include "core/draw/anim.hpp"
+#include "core/draw/palette.hpp"
+#include "core/draw/types.hpp"
+#include "types.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace history {
+
+enum class RecordType : u8 {
+  // Size and color type of a new animation
+  INIT,
+  // Tiles of a cel after a paint
+  PAINT,
+  ACTION,
+  // Seq of the snapshot undone
+  UNDO,
+  // Seq of the snapshot redone
+  REDO,
+  // Seq of the child of the current snapshot that redo goes to
+  BRANCH,
+  // Tiles of many cels painted at once
+  PAINT_CELS,
+  // Colors of the palette once these changed
+  PALETTE,
+  // Every cel of the animation, the history starts over from it
+  ANIM,
+};
+
+// Record read back from the journal, data points into the read bytes
+struct Record {
+  RecordType type = RecordType::INIT;
+  const u8* data = nullptr;
+  i32 size = 0;
+};
+
+// Animation the journal is written again from, see Journal::checkpoint()
+struct Checkpoint {
+  // Shares the cels of the history, these are only read by the worker
+  draw::Anim anim{};
+  i32 frame = 0;
+  i32 layer = 0;
+  // Seq of the next snapshot with a record
+  u64 seq = 0U;
+  // Bytes of its records once written
+  i64 bytes = 0;
+};
+
+/**
+ * Append only log of the history next to the project.
+ * Replaying the records from the start rebuilds the animation and its
+ * history, eg. after a crash. Once it grows too big it is written again
+ * from the current animation with checkpoint().
+ *
+ * Each record is its size, a checksum and its type followed by the data.
+ * Records are appended and synced to the disk in batches on a worker
+ * thread so the caller never waits for the disk, a crash only loses the
+ * records of the last batch
+ **/
+class Journal {
+public:
+  Journal() noexcept = default;
+  Journal(const Journal&) noexcept = delete;
+  Journal& operator=(const Journal&) noexcept = delete;
+  Journal(Journal&&) noexcept = delete;
+  Journal& operator=(Journal&&) noexcept = delete;
+  ~Journal() noexcept;
+
+  /**
+   * Opens the journal to append records after the valid records in it,
+   * anything after these is cut off. Creates the file if it does not exist.
+   * Errors if the file could not be opened
+   **/
+  Error open(const c8* path, i64 valid_size) noexcept;
+
+  // Waits for the pending records and closes the file
+  void close() noexcept;
+
+  [[nodiscard]] bool is_open() const noexcept;
+  /**
+   * Bytes of the file once the queued records are written, a checkpoint is
+   * only counted once it is written
+   **/
+  [[nodiscard]] i64 get_size() const noexcept;
+
+  /**
+   * Queues an encoded record to be appended.
+   * Writes that failed are only logged, the history still works without
+   * the journal
+   **/
+  void write(std::vector<u8>&& record) noexcept;
+
+  // Blocks until all the queued records and checkpoints are synced
+  void flush() noexcept;
+
+  /**
+   * Replaces the records of the journal with the animation of the
+   * checkpoint, the records queued before it are dropped. These are encoded
+   * and synced on the worker, the old file is only replaced once the new
+   * one is synced.
+   * Failures are only logged, nothing is written to the journal after these
+   **/
+  void checkpoint(Checkpoint&& checkpoint) noexcept;
+
+  // === Reading === //
+
+  /**
+   * Reads the whole journal into bytes, bytes is empty if there is no file.
+   * Errors if the file is not a journal
+   **/
+  static Error read(const c8* path, std::vector<u8>& bytes) noexcept;
+
+  /**
+   * Reads the record at the offset and moves the offset after it.
+   * Returns false at the end of the journal or at a torn record
+   **/
+  [[nodiscard]] static bool
+  next(const std::vector<u8>& bytes, i64& offset, Record& record) noexcept;
+
+  // Bytes before the first record
+  [[nodiscard]] static i64 get_header_size() noexcept;
+
+  // === Records === //
+
+  static void encode_init(
+      ivec size, draw::ColorType type, std::vector<u8>& record
+  ) noexcept;
+
+  /**
+   * Only the tiles after the paint are kept, the tiles before are already
+   * in the animation when replaying.
+   * Only reads the pixels so this can run on another thread
+   **/
+  static void encode_paint(
+      i32 frame, i32 layer, const std::vector<TileDelta>& deltas,
+      i32 tile_bytes, std::vector<u8>& record
+  ) noexcept;
+
+  /**
+   * Same as encode_paint() for each of the cels, replayed as one snapshot.
+   * @param frame - current frame after the paint
+   * @param layer - current layer after the paint
+   **/
+  static void encode_cels(
+      i32 frame, i32 layer, const std::vector<CelDelta>& cel_deltas,
+      std::vector<u8>& record
+  ) noexcept;
+
+  static void encode_action(Action action, std::vector<u8>& record) noexcept;
+
+  /**
+   * Move in the history like UNDO, REDO and BRANCH. Snapshots are found by
+   * the order of their records as the ids may differ when replaying
+   **/
+  static void
+  encode_step(RecordType type, u64 seq, std::vector<u8>& record) noexcept;
+
+  static void encode_palette(
+      const draw::Palette& palette, std::vector<u8>& record
+  ) noexcept;
+
+  /**
+   * Cels of the animation with the current frame and layer, replaying it
+   * starts the history over.
+   * @param seq - seq of the next snapshot with a record
+   **/
+  static void encode_anim(
+      const draw::Anim& anim, i32 frame, i32 layer, u64 seq,
+      std::vector<u8>& record
+  ) noexcept;
+
+  // Errors if the record is malformed
+  static Error
+  decode_init(const Record& record, ivec& size, draw::ColorType& type) noexcept;
+  // The action is also checked against the animation it is performed on
+  static Error decode_action(
+      const Record& record, const draw::Anim& anim, Action& action
+  ) noexcept;
+  static Error decode_step(const Record& record, u64& seq) noexcept;
+  static Error
+  decode_palette(const Record& record, draw::Palette& palette) noexcept;
+
+  /**
+   * Writes the tiles of a paint record on the cel of the model, the frame
+   * and layer of the model are moved to the painted cel.
+   * Errors if the record is malformed or the tiles could not be allocated
+   **/
+  static Error decode_paint(const Record& record, Model& model) noexcept;
+
+  // Same as decode_paint() for each cel of an encode_cels() record
+  static Error decode_cels(const Record& record, Model& model) noexcept;
+
+  /**
+   * Replaces the cels of the model with the ones of an encode_anim() record,
+   * the size and color type are kept.
+   * Errors if the record is malformed or the cels could not be allocated
+   **/
+  static Error
+  decode_anim(const Record& record, Model& model, u64& seq) noexcept;
+
+private:
+  std::FILE* file = nullptr;
+  std::string path{};
+  i64 size = 0;
+
+  std::thread worker{};
+  std::mutex mutex{};
+  std::condition_variable queued{};
+  std::condition_variable synced{};
+  std::vector<std::vector<u8>> records{};
+  // Queued checkpoint, written before the queued records
+  std::vector<Checkpoint> checkpoints{};
+  // Written by the worker, the cels are released on the caller thread
+  std::vector<Checkpoint> written{};
+  // Checkpoints queued but not released yet, only used by the caller
+  i32 checkpoint_count = 0;
+  bool busy = false;
+  bool stopping = false;
+  bool failed = false;
+
+  void run() noexcept;
+  // Writes the new file on the worker and appends to it from now on
+  bool replace(Checkpoint& checkpoint) noexcept;
+  // Releases the written checkpoints and counts their bytes
+  void release_checkpoints() noexcept;
+};
+
+} // namespace history
+
+#endif
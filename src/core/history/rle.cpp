@@ -0,0 +1,91 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#include "./rle.hpp"
+#include <cassert>
+#include <cstring>
+
+namespace history {
+
+const i32 MAX_PACKET = 128;
+const u8 RUN_FLAG = 0x80U;
+
+void rle_encode(
+    const u8* src, i32 bytes, i32 pixel_size, std::vector<u8>& dst
+) noexcept {
+  assert(bytes % pixel_size == 0);
+  i32 count = bytes / pixel_size;
+
+  auto same = [&](i32 a, i32 b) {
+    // NOLINTNEXTLINE
+    const u8* lhs = src + a * pixel_size;
+    // NOLINTNEXTLINE
+    const u8* rhs = src + b * pixel_size;
+    return std::memcmp(lhs, rhs, pixel_size) == 0;
+  };
+
+  i32 i = 0;
+  while (i < count) {
+    i32 run = 1;
+    while (i + run < count && run < MAX_PACKET && same(i, i + run)) {
+      ++run;
+    }
+
+    if (run > 1) {
+      dst.push_back(RUN_FLAG | (u8)(run - 1));
+      // NOLINTNEXTLINE
+      dst.insert(dst.end(), src + i * pixel_size, src + (i + 1) * pixel_size);
+      i += run;
+      continue;
+    }
+
+    // Literal pixels until the next run starts
+    i32 literal = 1;
+    while (i + literal < count && literal < MAX_PACKET &&
+           !(i + literal + 1 < count && same(i + literal, i + literal + 1))) {
+      ++literal;
+    }
+    dst.push_back((u8)(literal - 1));
+    dst.insert(
+        // NOLINTNEXTLINE
+        dst.end(), src + i * pixel_size, src + (i + literal) * pixel_size
+    );
+    i += literal;
+  }
+}
+
+const u8* rle_decode(
+    const u8* src, const u8* src_end, u8* dst, i32 bytes, i32 pixel_size
+) noexcept {
+  // NOLINTNEXTLINE
+  const u8* end = dst + bytes;
+  while (dst < end) {
+    if (src >= src_end) {
+      return nullptr;
+    }
+    u8 header = *src++;
+    i32 count = (header & ~RUN_FLAG) + 1;
+    i32 size = header & RUN_FLAG ? pixel_size : count * pixel_size;
+    if (end - dst < count * pixel_size || src_end - src < size) {
+      return nullptr;
+    }
+
+    if (header & RUN_FLAG) {
+      for (i32 i = 0; i < count; ++i) {
+        std::memcpy(dst, src, pixel_size);
+        dst += pixel_size; // NOLINT
+      }
+    } else {
+      std::memcpy(dst, src, size);
+      dst += size; // NOLINT
+    }
+    src += size; // NOLINT
+  }
+  return src;
+}
+
+} // namespace history
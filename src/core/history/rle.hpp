@@ -0,0 +1,39 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#ifndef MODULES_HISTORY_RLE_HPP
+#define MODULES_HISTORY_RLE_HPP
+
+#include "types.hpp"
+#include <vector>
+
+namespace history {
+
+/**
+ * Run length encoding over whole pixels.
+ * Each packet starts with a header byte, the lower 7 bits + 1 is the number
+ * of pixels. If the high bit is set a single pixel repeated that many times
+ * follows, otherwise that many pixels follow as is
+ **/
+
+// Appends the encoded (bytes) of pixels to dst
+void rle_encode(
+    const u8* src, i32 bytes, i32 pixel_size, std::vector<u8>& dst
+) noexcept;
+
+/**
+ * Decodes (bytes) of pixels into dst, reading src up to src_end.
+ * Returns where the encoded pixels end in src, nullptr if these are cut off
+ * or do not add up to (bytes)
+ **/
+const u8* rle_decode(
+    const u8* src, const u8* src_end, u8* dst, i32 bytes, i32 pixel_size
+) noexcept;
+
+} // namespace history
+
+#endif
@@ -6,24 +6,613 @@
  *===============================*/
 
 #include "./snapshot.hpp"
+#include "./rle.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 namespace history {
 
-void Snapshot::snap(const Model& model) noexcept {
-  this->anim.copy(model.anim);
+Snapshot::Snapshot(Snapshot&& rhs) noexcept
+    : action(rhs.action), deltas(std::move(rhs.deltas)),
+      cels(std::move(rhs.cels)), cel_deltas(std::move(rhs.cel_deltas)),
+      tile_bytes(rhs.tile_bytes),
+      frame_index(rhs.frame_index), layer_index(rhs.layer_index),
+      bytes(rhs.bytes), packed(std::move(rhs.packed)),
+      compressed(rhs.compressed), spill_offset(rhs.spill_offset),
+      spill_size(rhs.spill_size), spilled(rhs.spilled) {
+  rhs.action = {};
+  rhs.packed.clear();
+  rhs.compressed = false;
+  rhs.spill_offset = -1;
+  rhs.spilled = false;
+  rhs.deltas.clear();
+  rhs.cels.clear();
+  rhs.cel_deltas.clear();
+  rhs.frame_index = rhs.layer_index = -1;
+  rhs.bytes = 0;
+}
+
+Snapshot& Snapshot::operator=(Snapshot&& rhs) noexcept {
+  if (this == &rhs) {
+    return *this;
+  }
+
+  this->reset();
+  this->action = rhs.action;
+  this->deltas = std::move(rhs.deltas);
+  this->cels = std::move(rhs.cels);
+  this->cel_deltas = std::move(rhs.cel_deltas);
+  this->tile_bytes = rhs.tile_bytes;
+  this->frame_index = rhs.frame_index;
+  this->layer_index = rhs.layer_index;
+  this->bytes = rhs.bytes;
+  this->packed = std::move(rhs.packed);
+  this->compressed = rhs.compressed;
+  this->spill_offset = rhs.spill_offset;
+  this->spill_size = rhs.spill_size;
+  this->spilled = rhs.spilled;
+
+  rhs.action = {};
+  rhs.packed.clear();
+  rhs.compressed = false;
+  rhs.spill_offset = -1;
+  rhs.spilled = false;
+  rhs.deltas.clear();
+  rhs.cels.clear();
+  rhs.cel_deltas.clear();
+  rhs.frame_index = rhs.layer_index = -1;
+  rhs.bytes = 0;
+  return *this;
+}
+
+Snapshot::~Snapshot() noexcept {
+  this->reset();
+}
+
+void Snapshot::diff(
+    const draw::Cel* before, const draw::Cel* after,
+    std::vector<TileDelta>& deltas
+) noexcept {
+  deltas.clear();
+  if (before == after) {
+    return;
+  }
+
+  const draw::Cel* cel = after ? after : before;
+  i32 tile_bytes = cel->get_tile_bytes();
+  ivec tiles_size = cel->get_tiles_size();
+  i32 count = tiles_size.x * tiles_size.y;
+
+  for (i32 i = 0; i < count; ++i) {
+    draw::Tile* before_tile = before ? before->get_tile(i) : nullptr;
+    draw::Tile* after_tile = after ? after->get_tile(i) : nullptr;
+    if (before_tile == after_tile) {
+      continue;
+    }
+
+    // Deduping may replace a tile with an identical one
+    if (before_tile && after_tile &&
+        std::memcmp(
+            before_tile->get_ptr(), after_tile->get_ptr(), tile_bytes
+        ) == 0) {
+      continue;
+    }
+
+    deltas.push_back({i, before_tile, after_tile});
+  }
+}
+
+void Snapshot::set_tiles(
+    i32 frame, i32 layer, i32 tile_bytes, std::vector<TileDelta>&& deltas
+) noexcept {
+  this->reset();
+  this->frame_index = frame;
+  this->layer_index = layer;
+  this->tile_bytes = tile_bytes;
+  this->deltas = std::move(deltas);
+
+  for (const auto& delta : this->deltas) {
+    if (delta.before) {
+      ++delta.before->refs;
+    }
+    if (delta.after) {
+      ++delta.after->refs;
+    }
+  }
+  this->update_bytes();
+}
+
+void Snapshot::set_cels(
+    i32 frame, i32 layer, std::vector<CelDelta>&& cel_deltas
+) noexcept {
+  this->reset();
+  this->action.type = ActionType::PAINT_CELS;
+  this->frame_index = frame;
+  this->layer_index = layer;
+  this->cel_deltas = std::move(cel_deltas);
+
+  for (const auto& delta : this->cel_deltas) {
+    if (delta.before) {
+      delta.before->acquire();
+    }
+    if (delta.after) {
+      delta.after->acquire();
+    }
+  }
+  this->update_bytes();
+}
+
+Error Snapshot::execute(Model& model, Action action) noexcept {
+  assert(
+      action.type != ActionType::PAINT && action.type != ActionType::PAINT_CELS
+  );
+  this->reset();
+  this->action = action;
   this->frame_index = model.frame_index;
   this->layer_index = model.layer_index;
+
+  this->capture_cels(model.anim);
+  if (this->perform(model.anim) != Error::OK) {
+    this->reset();
+    return Error::BAD_ALLOC;
+  }
+  update_model(model, model.frame_index, model.layer_index);
+  this->update_bytes();
+  return Error::OK;
+}
+
+Error Snapshot::undo(Model& model) const noexcept {
+  if (this->action.type == ActionType::PAINT) {
+    return this->apply_tiles(model, false);
+  }
+  if (this->action.type == ActionType::PAINT_CELS) {
+    this->apply_cels(model, false);
+    return Error::OK;
+  }
+
+  if (this->revert(model.anim) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+  update_model(model, this->frame_index, this->layer_index);
+  return Error::OK;
+}
+
+Error Snapshot::redo(Model& model) const noexcept {
+  if (this->action.type == ActionType::PAINT) {
+    return this->apply_tiles(model, true);
+  }
+  if (this->action.type == ActionType::PAINT_CELS) {
+    this->apply_cels(model, true);
+    return Error::OK;
+  }
+
+  if (this->perform(model.anim) != Error::OK) {
+    return Error::BAD_ALLOC;
+  }
+  update_model(model, model.frame_index, model.layer_index);
+  return Error::OK;
 }
 
-void Snapshot::restore(Model& model) const noexcept {
-  model.anim.copy(this->anim);
-  model.frame_index = this->frame_index;
-  model.layer_index = this->layer_index;
+Error Snapshot::apply_tiles(Model& model, bool is_after) const noexcept {
+  update_model(model, this->frame_index, this->layer_index);
+
+  for (const auto& delta : this->deltas) {
+    if (model.layer.set_tile(
+            delta.index, is_after ? delta.after : delta.before
+        ) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+  }
+  return Error::OK;
+}
+
+void Snapshot::apply_cels(Model& model, bool is_after) const noexcept {
+  for (const auto& delta : this->cel_deltas) {
+    model.anim.set_cel(
+        delta.frame, delta.layer, is_after ? delta.after : delta.before
+    );
+  }
+  update_model(model, this->frame_index, this->layer_index);
+}
+
+Error Snapshot::perform(draw::Anim& anim) const noexcept {
+  const auto& action = this->action;
+  switch (action.type) {
+  case ActionType::INSERT_FRAMES:
+    return anim.insert_frames(action.index, action.count);
+
+  case ActionType::REMOVE_FRAMES:
+    anim.remove_frames(action.index, action.count);
+    return Error::OK;
+
+  case ActionType::INSERT_LAYERS:
+    return anim.insert_layers(action.index, action.count);
+
+  case ActionType::REMOVE_LAYERS:
+    anim.remove_layers(action.index, action.count);
+    return Error::OK;
+
+  case ActionType::MOVE_FRAME:
+    anim.move_frame(action.index, action.to);
+    return Error::OK;
+
+  case ActionType::MOVE_LAYER:
+    anim.move_layer(action.index, action.to);
+    return Error::OK;
+
+  case ActionType::DUPLICATE_FRAME:
+    return anim.duplicate_frame(action.index);
+
+  case ActionType::DUPLICATE_LAYER:
+    return anim.duplicate_layer(action.index);
+
+  case ActionType::PAINT:
+  case ActionType::PAINT_CELS:
+  default:
+    return Error::OK;
+  }
+}
+
+Error Snapshot::revert(draw::Anim& anim) const noexcept {
+  const auto& action = this->action;
+  switch (action.type) {
+  case ActionType::INSERT_FRAMES:
+    anim.remove_frames(action.index, action.count);
+    return Error::OK;
+
+  case ActionType::REMOVE_FRAMES:
+    if (anim.insert_frames(action.index, action.count) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    this->restore_cels(anim);
+    return Error::OK;
+
+  case ActionType::INSERT_LAYERS:
+    anim.remove_layers(action.index, action.count);
+    return Error::OK;
+
+  case ActionType::REMOVE_LAYERS:
+    if (anim.insert_layers(action.index, action.count) != Error::OK) {
+      return Error::BAD_ALLOC;
+    }
+    this->restore_cels(anim);
+    return Error::OK;
+
+  case ActionType::MOVE_FRAME:
+    anim.move_frame(action.to, action.index);
+    return Error::OK;
+
+  case ActionType::MOVE_LAYER:
+    anim.move_layer(action.to, action.index);
+    return Error::OK;
+
+  case ActionType::DUPLICATE_FRAME:
+    anim.remove_frames(action.index + 1, 1);
+    return Error::OK;
+
+  case ActionType::DUPLICATE_LAYER:
+    anim.remove_layers(action.index + 1, 1);
+    return Error::OK;
+
+  case ActionType::PAINT:
+  case ActionType::PAINT_CELS:
+  default:
+    return Error::OK;
+  }
+}
+
+void Snapshot::capture_cels(const draw::Anim& anim) noexcept {
+  const auto& action = this->action;
+  if (action.type == ActionType::REMOVE_FRAMES) {
+    for (i32 f = action.index; f < action.index + action.count; ++f) {
+      for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+        this->cels.push_back(anim.get_cel(f, l));
+      }
+    }
+  } else if (action.type == ActionType::REMOVE_LAYERS) {
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      for (i32 l = action.index; l < action.index + action.count; ++l) {
+        this->cels.push_back(anim.get_cel(f, l));
+      }
+    }
+  }
+
+  for (auto* cel : this->cels) {
+    if (cel) {
+      cel->acquire();
+    }
+  }
+}
+
+void Snapshot::restore_cels(draw::Anim& anim) const noexcept {
+  // Same order as capture_cels()
+  const auto& action = this->action;
+  auto it = this->cels.begin();
+  if (action.type == ActionType::REMOVE_FRAMES) {
+    for (i32 f = action.index; f < action.index + action.count; ++f) {
+      for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+        anim.set_cel(f, l, *it++);
+      }
+    }
+  } else if (action.type == ActionType::REMOVE_LAYERS) {
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      for (i32 l = action.index; l < action.index + action.count; ++l) {
+        anim.set_cel(f, l, *it++);
+      }
+    }
+  }
+}
+
+void Snapshot::update_model(Model& model, i32 frame, i32 layer) noexcept {
+  model.frame_index = std::clamp(frame, 0, model.anim.get_frame_count() - 1);
+  model.layer_index = std::clamp(layer, 0, model.anim.get_layer_count() - 1);
+  // Layer references the slot table of the anim which may be reallocated
+  model.layer = model.anim.get_layer(model.frame_index, model.layer_index);
+}
+
+i64 Snapshot::get_bytes() const noexcept {
+  return this->bytes;
+}
+
+const std::vector<TileDelta>& Snapshot::get_deltas() const noexcept {
+  return this->deltas;
+}
+
+i32 Snapshot::get_tile_bytes() const noexcept {
+  return this->tile_bytes;
+}
+
+bool Snapshot::is_compressed() const noexcept {
+  return this->compressed;
+}
+
+bool Snapshot::can_compress() const noexcept {
+  return !this->compressed && !this->deltas.empty();
+}
+
+void Snapshot::encode(
+    const std::vector<TileDelta>& deltas, i32 tile_bytes,
+    std::vector<u8>& packed
+) noexcept {
+  // Each tile is a tag byte, 0 for an untouched tile, then its pixels
+  i32 pixel_size = tile_bytes / (draw::TILE_SIZE * draw::TILE_SIZE);
+  for (const auto& delta : deltas) {
+    for (const auto* tile : {delta.before, delta.after}) {
+      packed.push_back(tile != nullptr);
+      if (tile) {
+        rle_encode(tile->get_ptr(), tile_bytes, pixel_size, packed);
+      }
+    }
+  }
+}
+
+void Snapshot::set_packed(std::vector<u8>&& packed) noexcept {
+  assert(this->can_compress());
+
+  for (auto& delta : this->deltas) {
+    draw::release_tile(delta.before, this->tile_bytes);
+    draw::release_tile(delta.after, this->tile_bytes);
+    delta.before = delta.after = nullptr;
+  }
+  this->packed = std::move(packed);
+  this->packed.shrink_to_fit();
+  this->compressed = true;
+  this->update_bytes();
+}
+
+Error Snapshot::decompress() noexcept {
+  if (!this->compressed) {
+    return Error::OK;
+  }
+  assert(!this->is_spilled());
+
+  auto& store = draw::get_tile_store();
+  i32 pixel_size = this->tile_bytes / (draw::TILE_SIZE * draw::TILE_SIZE);
+  const u8* cursor = this->packed.data();
+  // NOLINTNEXTLINE
+  const u8* end = cursor + this->packed.size();
+  for (auto& delta : this->deltas) {
+    for (auto** tile : {&delta.before, &delta.after}) {
+      if (cursor < end && !*cursor++) {
+        continue;
+      }
+
+      // Cut off packed pixels are only possible if the spill file was
+      // damaged
+      *tile = cursor < end ? store.allocate(this->tile_bytes) : nullptr;
+      if (*tile) {
+        cursor = rle_decode(
+            cursor, end, (*tile)->get_ptr(), this->tile_bytes, pixel_size
+        );
+      }
+
+      if (!*tile || !cursor) {
+        // Tiles decoded so far are dropped, the packed pixels are kept
+        for (auto& other : this->deltas) {
+          draw::release_tile(other.before, this->tile_bytes);
+          draw::release_tile(other.after, this->tile_bytes);
+          other.before = other.after = nullptr;
+        }
+        return Error::BAD_ALLOC;
+      }
+    }
+  }
+
+  this->packed.clear();
+  this->packed.shrink_to_fit();
+  this->compressed = false;
+  this->update_bytes();
+  return Error::OK;
+}
+
+bool Snapshot::is_spilled() const noexcept {
+  return this->spilled;
+}
+
+bool Snapshot::can_spill() const noexcept {
+  return this->compressed && !this->spilled;
+}
+
+void Snapshot::spill(SpillFile& file) noexcept {
+  assert(this->can_spill());
+
+  // Already in the file if it was read back before
+  if (this->spill_offset < 0 || this->spill_size != (i64)this->packed.size()) {
+    this->free_spill(file);
+    this->spill_size = (i64)this->packed.size();
+    this->spill_offset = file.write(std::move(this->packed));
+  }
+  this->packed.clear();
+  this->packed.shrink_to_fit();
+  this->spilled = true;
+  this->update_bytes();
+}
+
+Error Snapshot::unspill(SpillFile& file) noexcept {
+  if (!this->spilled) {
+    return Error::OK;
+  }
+
+  if (file.read(this->spill_offset, this->spill_size, this->packed) !=
+      Error::OK) {
+    this->packed.clear();
+    return Error::BAD_ALLOC;
+  }
+  this->spilled = false;
+  this->update_bytes();
+  return Error::OK;
+}
+
+void Snapshot::free_spill(SpillFile& file) noexcept {
+  if (this->spill_offset >= 0) {
+    file.free(this->spill_offset, this->spill_size);
+  }
+  this->spill_offset = -1;
+  this->spill_size = 0;
+  this->spilled = false;
+}
+
+void Snapshot::update_bytes() noexcept {
+  i64 total = sizeof(Snapshot) + this->deltas.size() * sizeof(TileDelta) +
+              this->cels.size() * sizeof(draw::Cel*) +
+              this->cel_deltas.size() * sizeof(CelDelta) +
+              this->packed.size();
+
+  i64 tile_size = sizeof(draw::Tile) + this->tile_bytes;
+  for (const auto& delta : this->deltas) {
+    total += (delta.before != nullptr) * tile_size;
+    total += (delta.after != nullptr) * tile_size;
+  }
+
+  for (const auto* cel : this->cels) {
+    if (!cel) {
+      continue;
+    }
+
+    ivec tiles_size = cel->get_tiles_size();
+    total += sizeof(draw::Cel) +
+             (i64)tiles_size.x * tiles_size.y * sizeof(draw::Tile*) +
+             (i64)cel->get_tile_count() *
+                 (sizeof(draw::Tile) + cel->get_tile_bytes());
+  }
+
+  // Tiles that did not change are shared by both cels and the animation
+  for (const auto& delta : this->cel_deltas) {
+    for (const auto* cel : {delta.before, delta.after}) {
+      if (cel) {
+        ivec tiles_size = cel->get_tiles_size();
+        total += sizeof(draw::Cel) +
+                 (i64)tiles_size.x * tiles_size.y * sizeof(draw::Tile*);
+      }
+    }
+
+    const auto* cel = delta.after ? delta.after : delta.before;
+    if (!cel) {
+      continue;
+    }
+    ivec tiles_size = cel->get_tiles_size();
+    i64 tile_size = sizeof(draw::Tile) + cel->get_tile_bytes();
+    for (i32 i = 0; i < tiles_size.x * tiles_size.y; ++i) {
+      auto* before = delta.before ? delta.before->get_tile(i) : nullptr;
+      auto* after = delta.after ? delta.after->get_tile(i) : nullptr;
+      if (before != after) {
+        total += (before != nullptr) * tile_size;
+        total += (after != nullptr) * tile_size;
+      }
+    }
+  }
+  this->bytes = total;
+}
+
+bool Snapshot::is_empty() const noexcept {
+  if (this->action.type == ActionType::PAINT_CELS) {
+    return this->cel_deltas.empty();
+  }
+  return this->action.type == ActionType::PAINT && this->deltas.empty();
+}
+
+bool Snapshot::is_paint() const noexcept {
+  return this->action.type == ActionType::PAINT;
+}
+
+irect Snapshot::get_rect(ivec size) const noexcept {
+  if (!this->is_paint()) {
+    return {0, 0, size.x, size.y};
+  }
+  if (this->deltas.empty()) {
+    return {};
+  }
+
+  // Indices are row major over the tiles of the cel
+  i32 tiles_width = (size.x + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT;
+  ivec min{tiles_width, this->deltas.front().index / tiles_width};
+  ivec max{0, min.y};
+  for (const auto& delta : this->deltas) {
+    i32 tx = delta.index % tiles_width;
+    i32 ty = delta.index / tiles_width;
+    min.x = std::min(min.x, tx);
+    min.y = std::min(min.y, ty);
+    max.x = std::max(max.x, tx);
+    max.y = std::max(max.y, ty);
+  }
+
+  i32 left = min.x << draw::TILE_SHIFT;
+  i32 top = min.y << draw::TILE_SHIFT;
+  return {
+      left, top, std::min((max.x + 1) << draw::TILE_SHIFT, size.x) - left,
+      std::min((max.y + 1) << draw::TILE_SHIFT, size.y) - top};
 }
 
 void Snapshot::reset() noexcept {
-  this->anim.clear();
+  for (const auto& delta : this->deltas) {
+    draw::release_tile(delta.before, this->tile_bytes);
+    draw::release_tile(delta.after, this->tile_bytes);
+  }
+  this->deltas.clear();
+  this->deltas.shrink_to_fit();
+
+  for (auto* cel : this->cels) {
+    draw::release_cel(cel);
+  }
+  this->cels.clear();
+  this->cels.shrink_to_fit();
+
+  for (const auto& delta : this->cel_deltas) {
+    draw::release_cel(delta.before);
+    draw::release_cel(delta.after);
+  }
+  this->cel_deltas.clear();
+  this->cel_deltas.shrink_to_fit();
+  this->action = {};
   this->frame_index = this->layer_index = -1;
+  this->bytes = 0;
+  this->packed.clear();
+  this->packed.shrink_to_fit();
+  this->compressed = false;
+  this->spill_offset = -1;
+  this->spill_size = 0;
+  this->spilled = false;
 }
 
 } // namespace history
@@ -8,34 +8,208 @@
 #ifndef MODULES_HISTORY_SNAPSHOT_HPP
 #define MODULES_HISTORY_SNAPSHOT_HPP
 
+#include "./spill.hpp"
 #include "core/draw/anim.hpp"
+#include "core/draw/store.hpp"
 #include "model/model.hpp"
 #include "types.hpp"
+#include <vector>
 
 namespace history {
 
+// A tile of a cel before and after a change, nullptr for untouched tiles
+struct TileDelta {
+  i32 index = 0;
+  draw::Tile* before = nullptr;
+  draw::Tile* after = nullptr;
+};
+
+// A cel before and after a change, nullptr for empty cels
+struct CelDelta {
+  i32 frame = 0;
+  i32 layer = 0;
+  draw::Cel* before = nullptr;
+  draw::Cel* after = nullptr;
+};
+
+enum class ActionType : u8 {
+  PAINT,
+  INSERT_FRAMES,
+  REMOVE_FRAMES,
+  INSERT_LAYERS,
+  REMOVE_LAYERS,
+  MOVE_FRAME,
+  MOVE_LAYER,
+  DUPLICATE_FRAME,
+  DUPLICATE_LAYER,
+  // Paint on many cels at once, see Snapshot::set_cels()
+  PAINT_CELS,
+};
+
+// Structural change of the animation
+struct Action {
+  ActionType type = ActionType::PAINT;
+  i32 index = 0;
+  // Used by insert and remove
+  i32 count = 1;
+  // Where the frame or layer is moved to
+  i32 to = 0;
+};
+
+/**
+ * Changes between two states of the animation.
+ * A paint keeps the tiles of a cel that changed, these are shared with the
+ * cels so memory scales with the size of the stroke instead of the
+ * animation. A paint on many cels keeps the cels before and after it.
+ * Other actions only keep the operation and the cels they removed.
+ **/
 class Snapshot {
 public:
   Snapshot(const Snapshot&) noexcept = delete;
   Snapshot& operator=(const Snapshot&) noexcept = delete;
 
   Snapshot() noexcept = default;
-  Snapshot(Snapshot&& rhs) noexcept = default;
-  Snapshot& operator=(Snapshot&& rhs) noexcept = default;
-  ~Snapshot() noexcept = default;
+  Snapshot(Snapshot&& rhs) noexcept;
+  Snapshot& operator=(Snapshot&& rhs) noexcept;
+  ~Snapshot() noexcept;
+
+  /**
+   * Finds the tiles of after that differ from before, either cel may be
+   * nullptr for an empty cel. No references are taken and only the pixels
+   * are read so this can run on another thread while the cels are frozen
+   **/
+  static void diff(
+      const draw::Cel* before, const draw::Cel* after,
+      std::vector<TileDelta>& deltas
+  ) noexcept;
+
+  // Keeps the output of diff() as a paint of the cel
+  void set_tiles(
+      i32 frame, i32 layer, i32 tile_bytes, std::vector<TileDelta>&& deltas
+  ) noexcept;
+
+  /**
+   * Keeps the cels before and after a paint on many cels, the tiles that
+   * did not change are shared between the two.
+   * @param frame - current frame after the paint
+   * @param layer - current layer after the paint
+   **/
+  void set_cels(
+      i32 frame, i32 layer, std::vector<CelDelta>&& cel_deltas
+  ) noexcept;
+
+  /**
+   * Performs a structural action on the model and records it,
+   * cels removed by the action are kept for undo.
+   * Errors if the animation could not grow
+   **/
+  Error execute(Model& model, Action action) noexcept;
+
+  // Goes back to the state before the change
+  Error undo(Model& model) const noexcept;
+  // Goes back to the state after the change
+  Error redo(Model& model) const noexcept;
+
+  // Whether nothing changed
+  [[nodiscard]] bool is_empty() const noexcept;
+  // Whether only the tiles of a cel changed
+  [[nodiscard]] bool is_paint() const noexcept;
+
+  /**
+   * Rect of the cel covered by the changed tiles,
+   * the whole animation for other actions
+   **/
+  [[nodiscard]] irect get_rect(ivec size) const noexcept;
 
-  void snap(const Model& model) noexcept;
-  void restore(Model& model) const noexcept;
+  /**
+   * Memory kept alive by the snapshot, tiles and cels still shared with the
+   * animation are counted too
+   **/
+  [[nodiscard]] i64 get_bytes() const noexcept;
+
+  // === Compression === //
+
+  [[nodiscard]] const std::vector<TileDelta>& get_deltas() const noexcept;
+  [[nodiscard]] i32 get_tile_bytes() const noexcept;
+  [[nodiscard]] bool is_compressed() const noexcept;
+  // Whether the snapshot holds tiles that are not compressed yet
+  [[nodiscard]] bool can_compress() const noexcept;
+
+  /**
+   * Compresses the tiles of the deltas into packed.
+   * Only reads the pixels so this can run on another thread
+   **/
+  static void encode(
+      const std::vector<TileDelta>& deltas, i32 tile_bytes,
+      std::vector<u8>& packed
+  ) noexcept;
+
+  // Releases the tiles and keeps the output of encode() instead
+  void set_packed(std::vector<u8>&& packed) noexcept;
+
+  /**
+   * Allocates the tiles again from the packed pixels.
+   * Errors if the tiles could not be allocated
+   **/
+  Error decompress() noexcept;
+
+  // === Spilling === //
+
+  [[nodiscard]] bool is_spilled() const noexcept;
+  // Whether the packed pixels are still in memory
+  [[nodiscard]] bool can_spill() const noexcept;
+
+  /**
+   * Moves the packed pixels to the file, the bytes are only written once
+   * since the pixels of a snapshot never change
+   **/
+  void spill(SpillFile& file) noexcept;
+
+  /**
+   * Reads the packed pixels back from the file, the bytes stay in the file
+   * for the next spill().
+   * Errors if the file could not be read
+   **/
+  Error unspill(SpillFile& file) noexcept;
+
+  // Frees the bytes in the file, called before the snapshot is dropped
+  void free_spill(SpillFile& file) noexcept;
 
   void reset() noexcept;
 
 private:
-  draw::Anim anim{};
+  Action action{};
+  std::vector<TileDelta> deltas{};
+  // Cels of the removed frames or layers, nullptr for empty cels
+  std::vector<draw::Cel*> cels{};
+  // Cels of a PAINT_CELS, not compressed
+  std::vector<CelDelta> cel_deltas{};
+  i32 tile_bytes = 0;
   i32 frame_index = -1;
   i32 layer_index = -1;
+  i64 bytes = 0;
+  // Pixels of the tiles once compressed, see encode()
+  std::vector<u8> packed{};
+  bool compressed = false;
+  // Where the packed pixels are in the spill file, -1 if never spilled
+  i64 spill_offset = -1;
+  i64 spill_size = 0;
+  // Whether the packed pixels are only in the spill file
+  bool spilled = false;
+
+  void update_bytes() noexcept;
+
+  Error apply_tiles(Model& model, bool is_after) const noexcept;
+  Error perform(draw::Anim& anim) const noexcept;
+  Error revert(draw::Anim& anim) const noexcept;
+  void capture_cels(const draw::Anim& anim) noexcept;
+  void restore_cels(draw::Anim& anim) const noexcept;
+  void apply_cels(Model& model, bool is_after) const noexcept;
+
+  // Points the model to a valid frame and layer after the action
+  static void update_model(Model& model, i32 frame, i32 layer) noexcept;
 };
 
 } // namespace history
 
 #endif
-
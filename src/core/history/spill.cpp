@@ -0,0 +1,233 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#include "./spill.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace history {
+
+// Moves the position of the file, offsets can go past 2GB
+inline i32 seek(std::FILE* file, i64 offset) noexcept {
+#ifdef _WIN32
+  return _fseeki64(file, offset, SEEK_SET);
+#else
+  return fseeko(file, offset, SEEK_SET);
+#endif
+}
+
+SpillFile::~SpillFile() noexcept {
+  this->close();
+}
+
+Error SpillFile::open(const c8* path) noexcept {
+  this->close();
+
+  if (path) {
+    // NOLINTNEXTLINE
+    this->file = std::fopen(path, "w+b");
+#ifdef __unix__
+    // Scratch file, only the handle keeps it alive
+    if (this->file) {
+      std::remove(path);
+    }
+#endif
+  } else {
+    this->file = std::tmpfile();
+  }
+
+  if (!this->file) {
+    return Error::BAD_ALLOC;
+  }
+
+  this->stopping = false;
+  this->failed = false;
+  this->worker = std::thread{&SpillFile::run, this};
+  return Error::OK;
+}
+
+void SpillFile::close() noexcept {
+  if (!this->file) {
+    return;
+  }
+
+  this->flush();
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->stopping = true;
+  }
+  this->queued.notify_one();
+  this->worker.join();
+
+  std::fclose(this->file);
+  this->file = nullptr;
+  this->end = 0;
+  this->free_extents.clear();
+  this->free_bytes = 0;
+}
+
+bool SpillFile::is_open() const noexcept {
+  return this->file != nullptr;
+}
+
+i64 SpillFile::get_size() const noexcept {
+  return this->end - this->free_bytes;
+}
+
+i64 SpillFile::write(std::vector<u8>&& bytes) noexcept {
+  assert(this->file != nullptr);
+
+  i64 size = (i64)bytes.size();
+  auto it = std::find_if(
+      this->free_extents.begin(), this->free_extents.end(),
+      [size](const Extent& extent) { return extent.size >= size; }
+  );
+
+  i64 offset = this->end;
+  if (size > 0 && it != this->free_extents.end()) {
+    offset = it->offset;
+    it->offset += size;
+    it->size -= size;
+    this->free_bytes -= size;
+    if (it->size == 0) {
+      this->free_extents.erase(it);
+    }
+  } else {
+    this->end += size;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->writes.push_back({offset, std::move(bytes)});
+  }
+  this->queued.notify_one();
+  return offset;
+}
+
+void SpillFile::free(i64 offset, i64 size) noexcept {
+  assert(offset >= 0 && offset + size <= this->end);
+  if (size <= 0) {
+    return;
+  }
+  this->free_bytes += size;
+
+  auto it = std::lower_bound(
+      this->free_extents.begin(), this->free_extents.end(), offset,
+      [](const Extent& extent, i64 offset) { return extent.offset < offset; }
+  );
+  it = this->free_extents.insert(it, {offset, size});
+
+  auto next = it + 1;
+  if (next != this->free_extents.end() &&
+      it->offset + it->size == next->offset) {
+    it->size += next->size;
+    this->free_extents.erase(next);
+  }
+  if (it != this->free_extents.begin()) {
+    auto prev = it - 1;
+    if (prev->offset + prev->size == it->offset) {
+      prev->size += it->size;
+      this->free_extents.erase(it);
+    }
+  }
+
+  // Freed bytes at the end are written over by the next appends
+  auto& last = this->free_extents.back();
+  if (last.offset + last.size == this->end) {
+    this->end = last.offset;
+    this->free_bytes -= last.size;
+    this->free_extents.pop_back();
+  }
+}
+
+Error SpillFile::read(i64 offset, i64 size, std::vector<u8>& out) noexcept {
+  assert(this->file != nullptr);
+  assert(offset >= 0 && offset + size <= this->end);
+  out.resize(size);
+
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->failed) {
+      return Error::BAD_ALLOC;
+    }
+
+    // Not in the file yet, copy from the queue instead. The latest write
+    // wins since freed bytes may have been written before
+    for (auto it = this->writes.rbegin(); it != this->writes.rend(); ++it) {
+      const auto& write = *it;
+      if (offset >= write.offset &&
+          offset + size <= write.offset + (i64)write.bytes.size()) {
+        std::memcpy(
+            // NOLINTNEXTLINE
+            out.data(), write.bytes.data() + (offset - write.offset), size
+        );
+        return Error::OK;
+      }
+    }
+  }
+
+  return this->read_file(offset, size, out.data());
+}
+
+Error SpillFile::read_file(i64 offset, i64 size, u8* out) noexcept {
+  std::lock_guard<std::mutex> lock{this->file_mutex};
+  if (seek(this->file, offset) != 0 ||
+      std::fread(out, 1, size, this->file) != (u64)size) {
+    return Error::BAD_ALLOC;
+  }
+  return Error::OK;
+}
+
+void SpillFile::clear() noexcept {
+  if (!this->file) {
+    return;
+  }
+
+  this->flush();
+  std::lock_guard<std::mutex> lock{this->file_mutex};
+  // Offsets start from 0 again, old bytes are overwritten
+  this->end = 0;
+  this->free_extents.clear();
+  this->free_bytes = 0;
+}
+
+void SpillFile::flush() noexcept {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  this->written.wait(lock, [this]() { return this->writes.empty(); });
+}
+
+void SpillFile::run() noexcept {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  while (true) {
+    this->queued.wait(lock, [this]() {
+      return this->stopping || !this->writes.empty();
+    });
+    if (this->writes.empty()) {
+      return;
+    }
+
+    // Only the worker pops the queue, the front stays valid while unlocked
+    const auto& write = this->writes.front();
+    lock.unlock();
+
+    bool ok = false;
+    {
+      std::lock_guard<std::mutex> file_lock{this->file_mutex};
+      ok = seek(this->file, write.offset) == 0 &&
+           std::fwrite(write.bytes.data(), 1, write.bytes.size(), this->file) ==
+               write.bytes.size();
+    }
+
+    lock.lock();
+    this->failed = this->failed || !ok;
+    this->writes.pop_front();
+    this->written.notify_all();
+  }
+}
+
+} // namespace history
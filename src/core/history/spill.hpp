@@ -0,0 +1,111 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#ifndef MODULES_HISTORY_SPILL_HPP
+#define MODULES_HISTORY_SPILL_HPP
+
+#include "types.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace history {
+
+/**
+ * Scratch file for the snapshots that do not fit the budget.
+ * Writes are done on a worker thread, reads of bytes that are not written
+ * yet are served from the queue so the caller never waits for a write.
+ * Bytes freed by dropped snapshots are reused by later writes
+ **/
+class SpillFile {
+public:
+  SpillFile() noexcept = default;
+  SpillFile(const SpillFile&) noexcept = delete;
+  SpillFile& operator=(const SpillFile&) noexcept = delete;
+  SpillFile(SpillFile&&) noexcept = delete;
+  SpillFile& operator=(SpillFile&&) noexcept = delete;
+  ~SpillFile() noexcept;
+
+  /**
+   * Creates the scratch file, the file is removed once closed.
+   * A nullptr path uses a temporary file.
+   * Errors if the file could not be created
+   **/
+  Error open(const c8* path = nullptr) noexcept;
+
+  // Waits for the pending writes and closes the file
+  void close() noexcept;
+
+  [[nodiscard]] bool is_open() const noexcept;
+  // Bytes of the file in use, freed bytes are not counted
+  [[nodiscard]] i64 get_size() const noexcept;
+
+  /**
+   * Queues the bytes to be written, in the first freed bytes that fit or
+   * at the end of the file.
+   * Returns the offset of the bytes in the file
+   **/
+  [[nodiscard]] i64 write(std::vector<u8>&& bytes) noexcept;
+
+  // Frees bytes from write(), these are overwritten by later writes
+  void free(i64 offset, i64 size) noexcept;
+
+  /**
+   * Reads (size) bytes at the offset into out.
+   * Errors if the file could not be read
+   **/
+  Error read(i64 offset, i64 size, std::vector<u8>& out) noexcept;
+
+  /**
+   * Drops everything in the file, offsets from write() are no longer valid.
+   * Waits for the pending writes
+   **/
+  void clear() noexcept;
+
+private:
+  struct Write {
+    i64 offset = 0;
+    std::vector<u8> bytes{};
+  };
+
+  struct Extent {
+    i64 offset = 0;
+    i64 size = 0;
+  };
+
+  std::FILE* file = nullptr;
+  // Where the next write goes if no freed bytes fit
+  i64 end = 0;
+  // Sorted by offset, touching extents are merged
+  std::vector<Extent> free_extents{};
+  i64 free_bytes = 0;
+
+  std::thread worker{};
+  // Guards writes, file_mutex guards the position of the file
+  std::mutex mutex{};
+  std::mutex file_mutex{};
+  std::condition_variable queued{};
+  std::condition_variable written{};
+  // The front is only popped once it is in the file, later writes to the
+  // same bytes come after
+  std::deque<Write> writes{};
+  bool stopping = false;
+  bool failed = false;
+
+  void run() noexcept;
+  // Blocks until the queue is empty
+  void flush() noexcept;
+
+  Error read_file(i64 offset, i64 size, u8* out) noexcept;
+};
+
+} // namespace history
+
+#endif
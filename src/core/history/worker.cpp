@@ -0,0 +1,127 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#include "./worker.hpp"
+
+namespace history {
+
+void Job::release() noexcept {
+  if (this->type == JobType::CAPTURE) {
+    draw::release_cel(this->before);
+    draw::release_cel(this->after);
+    this->before = this->after = nullptr;
+    this->deltas.clear();
+    return;
+  }
+
+  for (const auto& delta : this->deltas) {
+    draw::release_tile(delta.before, this->tile_bytes);
+    draw::release_tile(delta.after, this->tile_bytes);
+  }
+  this->deltas.clear();
+}
+
+Worker::~Worker() noexcept {
+  if (this->worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      this->stopping = true;
+    }
+    this->queued.notify_one();
+    this->worker.join();
+  }
+
+  for (auto& job : this->jobs) {
+    job.release();
+  }
+  for (auto& job : this->done) {
+    job.release();
+  }
+}
+
+void Worker::push(Job&& job) noexcept {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (job.type == JobType::CAPTURE) {
+      // Undo waits for these, so these skip ahead of the compression
+      ++this->capture_count;
+      auto it = this->jobs.begin();
+      while (it != this->jobs.end() && it->type == JobType::CAPTURE) {
+        ++it;
+      }
+      this->jobs.insert(it, std::move(job));
+    } else {
+      this->jobs.push_back(std::move(job));
+    }
+  }
+
+  if (!this->worker.joinable()) {
+    this->worker = std::thread{&Worker::run, this};
+  }
+  this->queued.notify_one();
+}
+
+void Worker::collect(std::vector<Job>& out, Wait wait) noexcept {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  if (wait == Wait::CAPTURES) {
+    this->finished.wait(lock, [this]() { return this->capture_count == 0; });
+  } else if (wait == Wait::ALL) {
+    this->finished.wait(lock, [this]() {
+      return this->jobs.empty() && !this->busy;
+    });
+  }
+
+  for (auto& job : this->done) {
+    out.push_back(std::move(job));
+  }
+  this->done.clear();
+}
+
+void Worker::clear() noexcept {
+  std::vector<Job> jobs{};
+  this->collect(jobs, Wait::ALL);
+  for (auto& job : jobs) {
+    job.release();
+  }
+}
+
+void Worker::run() noexcept {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  while (true) {
+    this->queued.wait(lock, [this]() {
+      return this->stopping || !this->jobs.empty();
+    });
+    if (this->stopping) {
+      return;
+    }
+
+    Job job = std::move(this->jobs.front());
+    this->jobs.pop_front();
+    this->busy = true;
+    lock.unlock();
+
+    if (job.type == JobType::CAPTURE) {
+      Snapshot::diff(job.before, job.after, job.deltas);
+      if (job.journal && !job.deltas.empty()) {
+        Journal::encode_paint(
+            job.frame_index, job.layer_index, job.deltas, job.tile_bytes,
+            job.packed
+        );
+      }
+    } else {
+      Snapshot::encode(job.deltas, job.tile_bytes, job.packed);
+    }
+
+    lock.lock();
+    this->capture_count -= job.type == JobType::CAPTURE;
+    this->done.push_back(std::move(job));
+    this->busy = false;
+    this->finished.notify_all();
+  }
+}
+
+} // namespace history
@@ -0,0 +1,113 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#ifndef MODULES_HISTORY_WORKER_HPP
+#define MODULES_HISTORY_WORKER_HPP
+
+#include "./journal.hpp"
+#include "./snapshot.hpp"
+#include "core/draw/cel.hpp"
+#include "types.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace history {
+
+enum class JobType : u8 {
+  // Finds the tiles that changed between two cels
+  CAPTURE,
+  // Compresses the tiles of a snapshot
+  COMPRESS,
+};
+
+/**
+ * Work done on the history worker for a snapshot.
+ * The job holds references to the cels or tiles it reads so these stay
+ * alive and unwritten even if the snapshot is dropped, only touch the
+ * references on the main thread
+ **/
+struct Job {
+  JobType type = JobType::COMPRESS;
+  u64 id = 0U;
+
+  // Frozen cels to compare, only for CAPTURE
+  draw::Cel* before = nullptr;
+  draw::Cel* after = nullptr;
+  i32 frame_index = -1;
+  i32 layer_index = -1;
+
+  // Output of CAPTURE, input of COMPRESS. Only COMPRESS holds references
+  std::vector<TileDelta> deltas{};
+  i32 tile_bytes = 0;
+  // Output of COMPRESS, or the journal record of a CAPTURE
+  std::vector<u8> packed{};
+  // Whether a CAPTURE also encodes its journal record
+  bool journal = false;
+
+  // Releases the references of the cels or tiles
+  void release() noexcept;
+};
+
+/**
+ * Runs the jobs of the history on a worker thread.
+ * The worker only reads the pixels and the tile tables of the cels, these
+ * are never written to while they are shared
+ **/
+class Worker {
+public:
+  enum class Wait : u8 {
+    NONE,
+    CAPTURES,
+    ALL,
+  };
+
+  Worker() noexcept = default;
+  Worker(const Worker&) noexcept = delete;
+  Worker& operator=(const Worker&) noexcept = delete;
+  Worker(Worker&&) noexcept = delete;
+  Worker& operator=(Worker&&) noexcept = delete;
+  ~Worker() noexcept;
+
+  /**
+   * Queues the job, the worker is started on the first job.
+   * Captures are done before any compression
+   **/
+  void push(Job&& job) noexcept;
+
+  /**
+   * Moves the finished jobs to out.
+   * @param wait - which of the queued jobs to block for
+   **/
+  void collect(std::vector<Job>& out, Wait wait = Wait::NONE) noexcept;
+
+  // Drops all the queued and finished jobs
+  void clear() noexcept;
+
+private:
+  std::thread worker{};
+  std::mutex mutex{};
+  // Notifies the worker that there are new jobs
+  std::condition_variable queued{};
+  // Notifies a waiting collect() that a job finished
+  std::condition_variable finished{};
+
+  std::deque<Job> jobs{};
+  std::vector<Job> done{};
+  // Captures that are queued or running
+  i32 capture_count = 0;
+  bool busy = false;
+  bool stopping = false;
+
+  void run() noexcept;
+};
+
+} // namespace history
+
+#endif
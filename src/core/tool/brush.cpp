@@ -0,0 +1,207 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#include "./brush.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace tool {
+
+Brush::Brush() noexcept {
+  this->update_stamp();
+}
+
+i32 Brush::get_size() const noexcept {
+  return this->size;
+}
+
+BrushShape Brush::get_shape() const noexcept {
+  return this->shape;
+}
+
+void Brush::set_size(i32 size) noexcept {
+  this->size = std::clamp(size, 1, MAX_BRUSH_SIZE);
+  this->update_stamp();
+}
+
+void Brush::set_shape(BrushShape shape) noexcept {
+  this->shape = shape;
+  this->update_stamp();
+}
+
+void Brush::set_bitmap(const std::vector<bool>& bitmap, ivec size) noexcept {
+  assert((i64)bitmap.size() == (i64)size.x * size.y);
+  this->bitmap = bitmap;
+  this->bitmap_size = size;
+  this->shape = BrushShape::CUSTOM;
+  this->update_stamp();
+}
+
+const std::vector<Span>& Brush::get_stamp() const noexcept {
+  return this->stamp;
+}
+
+void Brush::update_stamp() noexcept {
+  this->stamp.clear();
+
+  switch (this->shape) {
+  case BrushShape::SQUARE: {
+    i32 start = -(this->size / 2);
+    for (i32 y = 0; y < this->size; ++y) {
+      this->stamp.push_back({start, start + y, this->size});
+    }
+    break;
+  }
+
+  case BrushShape::CIRCLE: {
+    // Doubled so the center of even sizes stays on a whole number, the
+    // radius is shrunk by a bit so small circles are not squares
+    i32 start = -(this->size / 2);
+    i32 radius = this->size * this->size - this->size;
+    for (i32 y = 0; y < this->size; ++y) {
+      i32 dy = 2 * y - (this->size - 1);
+      i32 x = 0;
+      while (x < this->size) {
+        i32 dx = 2 * x - (this->size - 1);
+        if (dx * dx + dy * dy <= radius) {
+          break;
+        }
+        ++x;
+      }
+      if (x < this->size) {
+        // Symmetric around the center
+        this->stamp.push_back({start + x, start + y, this->size - 2 * x});
+      }
+    }
+    break;
+  }
+
+  case BrushShape::CUSTOM: {
+    ivec start{-(this->bitmap_size.x / 2), -(this->bitmap_size.y / 2)};
+    for (i32 y = 0; y < this->bitmap_size.y; ++y) {
+      i64 row = (i64)y * this->bitmap_size.x;
+      for (i32 x = 0; x < this->bitmap_size.x;) {
+        if (!this->bitmap[row + x]) {
+          ++x;
+          continue;
+        }
+
+        i32 left = x;
+        while (x < this->bitmap_size.x && this->bitmap[row + x]) {
+          ++x;
+        }
+        this->stamp.push_back({start.x + left, start.y + y, x - left});
+      }
+    }
+    break;
+  }
+  }
+}
+
+// Calls fn(pos) for every point of the line, see utils::draw_line()
+template <typename Fn>
+void for_each_point(ivec start, ivec end, Fn&& fn) noexcept {
+  ivec d{std::abs(end.x - start.x), -std::abs(end.y - start.y)};
+  ivec step{start.x < end.x ? 1 : -1, start.y < end.y ? 1 : -1};
+  i32 error = d.x + d.y;
+  ivec pos = start;
+  while (true) {
+    fn(pos);
+    if (pos.x == end.x && pos.y == end.y) {
+      return;
+    }
+
+    i32 error2 = 2 * error;
+    if (error2 >= d.y) {
+      error += d.y;
+      pos.x += step.x;
+    }
+    if (error2 <= d.x) {
+      error += d.x;
+      pos.y += step.y;
+    }
+  }
+}
+
+void Brush::sweep(
+    ivec start, ivec end, ivec size, std::vector<Span>& spans
+) const noexcept {
+  spans.clear();
+  if (this->stamp.empty()) {
+    return;
+  }
+
+  if (this->shape != BrushShape::CUSTOM) {
+    // Each row of a convex stamp is a single span, the points covering a
+    // row are next to each other so the row stays a single span
+    i32 top = std::min(start.y, end.y) + this->stamp.front().y;
+    i32 bottom = std::max(start.y, end.y) + this->stamp.back().y + 1;
+    top = std::max(0, top);
+    bottom = std::min(size.y, bottom);
+    if (top >= bottom) {
+      return;
+    }
+
+    spans.resize(bottom - top, {size.x, 0, 0});
+    for_each_point(start, end, [&](ivec pos) {
+      for (const auto& span : this->stamp) {
+        i32 y = pos.y + span.y;
+        if (y < top || y >= bottom) {
+          continue;
+        }
+
+        // Width is the right edge until the spans are clipped
+        auto& row = spans[y - top];
+        row.x = std::min(row.x, pos.x + span.x);
+        row.width = std::max(row.width, pos.x + span.x + span.width);
+      }
+    });
+
+    i64 count = 0;
+    for (i32 i = 0; i < bottom - top; ++i) {
+      i32 left = std::max(0, spans[i].x);
+      i32 right = std::min(size.x, spans[i].width);
+      if (left < right) {
+        spans[count++] = {left, top + i, right - left};
+      }
+    }
+    spans.resize(count);
+    return;
+  }
+
+  for_each_point(start, end, [&](ivec pos) {
+    for (const auto& span : this->stamp) {
+      i32 y = pos.y + span.y;
+      i32 left = std::max(0, pos.x + span.x);
+      i32 right = std::min(size.x, pos.x + span.x + span.width);
+      if (y >= 0 && y < size.y && left < right) {
+        spans.push_back({left, y, right - left});
+      }
+    }
+  });
+
+  std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+  });
+
+  // Merge the overlapping and touching spans of each row
+  i64 count = 0;
+  for (const auto& span : spans) {
+    if (count > 0) {
+      auto& last = spans[count - 1];
+      if (last.y == span.y && span.x <= last.x + last.width) {
+        last.width = std::max(last.width, span.x + span.width - last.x);
+        continue;
+      }
+    }
+    spans[count++] = span;
+  }
+  spans.resize(count);
+}
+
+} // namespace tool
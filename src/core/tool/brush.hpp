@@ -0,0 +1,80 @@
+/*===============================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *===============================*/
+
+#ifndef PXL_TOOL_BRUSH_HPP
+#define PXL_TOOL_BRUSH_HPP
+
+#include "types.hpp"
+#include <vector>
+
+namespace tool {
+
+const i32 MAX_BRUSH_SIZE = 256;
+
+enum class BrushShape : u8 {
+  SQUARE,
+  CIRCLE,
+  // Set with Brush::set_bitmap()
+  CUSTOM,
+};
+
+// Row of pixels painted by a brush
+struct Span {
+  i32 x = 0;
+  i32 y = 0;
+  i32 width = 0;
+};
+
+/**
+ * Shape painted by the pencil and the eraser.
+ * The shape is precomputed into a stamp of spans around the center, so
+ * painting writes whole rows instead of single pixels
+ **/
+class Brush {
+public:
+  Brush() noexcept;
+
+  [[nodiscard]] i32 get_size() const noexcept;
+  [[nodiscard]] BrushShape get_shape() const noexcept;
+
+  // Size of the square or circle, clamped to 1 and MAX_BRUSH_SIZE
+  void set_size(i32 size) noexcept;
+  // Switching to CUSTOM keeps the last bitmap
+  void set_shape(BrushShape shape) noexcept;
+
+  /**
+   * Uses the painted pixels of the bitmap as the brush, the center of the
+   * bitmap is on the cursor.
+   * @param bitmap - size.x * size.y pixels row by row
+   **/
+  void set_bitmap(const std::vector<bool>& bitmap, ivec size) noexcept;
+
+  // Spans of the brush relative to its center
+  [[nodiscard]] const std::vector<Span>& get_stamp() const noexcept;
+
+  /**
+   * Collects the spans covered by the brush moving from start to end,
+   * spans on the same row are merged so each pixel is only painted once.
+   * Spans are sorted by row and clipped to the size of the canvas
+   **/
+  void sweep(
+      ivec start, ivec end, ivec size, std::vector<Span>& spans
+  ) const noexcept;
+
+private:
+  i32 size = 1;
+  BrushShape shape = BrushShape::SQUARE;
+  std::vector<bool> bitmap{};
+  ivec bitmap_size{};
+  std::vector<Span> stamp{};
+
+  void update_stamp() noexcept;
+};
+
+} // namespace tool
+
+#endif
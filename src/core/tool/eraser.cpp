@@ -35,18 +35,23 @@ u32 Eraser::execute(Model& model, const event::Input& evt) noexcept {
   }
 }
 
+Brush& Eraser::get_brush() noexcept {
+  return this->brush;
+}
+
 /**
  * Uses:
  *   model.tex1 - current layer
  **/
 void Eraser::handle_mouse_down(Model& model, fvec pos) noexcept {
-  if (!model.anim.has_point(model.curr_pos) ||
-      !model.select_mask[model.get_pixel_index()]) {
-    return;
-  }
-
-  model.layer.paint(model.curr_pos, color::TRANSPARENT_COLOR);
-  model.tex1->paint(model.get_pixel_index(), color::TRANSPARENT_COLOR);
+  // Parts outside the canvas are clipped
+  this->brush.sweep(
+      model.curr_pos, model.curr_pos, model.anim.get_size(), this->spans
+  );
+  utils::draw_spans(
+      &model.layer, *model.tex1, model.anim.get_size(), this->spans,
+      color::TRANSPARENT_COLOR, model.select_mask
+  );
 }
 
 /**
@@ -54,30 +59,18 @@ void Eraser::handle_mouse_down(Model& model, fvec pos) noexcept {
  *   model.tex1 - current layer
  **/
 void Eraser::handle_mouse_motion(Model& model, fvec pos) noexcept {
-  i32 distance = model.prev_pos.chebyshev_distance(model.curr_pos);
-  if (distance == 0) {
+  if (model.prev_pos == model.curr_pos) {
     return;
   }
 
-  // If distance is 1, just draw the point
-  if (distance == 1) {
-    // Check if point is in bounds
-    if (!model.anim.has_point(model.curr_pos) ||
-        !model.select_mask[model.get_pixel_index()]) {
-      return;
-    }
-
-    model.layer.paint(model.get_pixel_index(), color::TRANSPARENT_COLOR);
-    model.tex1->paint(model.get_pixel_index(), color::TRANSPARENT_COLOR);
-    return;
-  }
-
-  // Draw a line to the previous and current position
-  utils::draw_line(
-      &model.layer, *model.tex1, model.anim.get_size(), model.curr_pos,
-      model.prev_pos, color::TRANSPARENT_COLOR, model.select_mask
+  // Sweep the brush from the previous to the current position
+  this->brush.sweep(
+      model.prev_pos, model.curr_pos, model.anim.get_size(), this->spans
+  );
+  utils::draw_spans(
+      &model.layer, *model.tex1, model.anim.get_size(), this->spans,
+      color::TRANSPARENT_COLOR, model.select_mask
   );
 }
 
 } // namespace tool
-
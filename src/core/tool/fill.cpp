@@ -6,8 +6,12 @@
  *===============================*/
 
 #include "./fill.hpp"
-#include <cstdio>
-#include <stack>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <thread>
+#include <type_traits>
 
 namespace tool {
 
@@ -26,73 +30,624 @@ u32 Fill::execute(Model& model, const event::Input& evt) noexcept {
   this->new_color = evt.mouse.left.state == input::MouseState::UP
                         ? model.fg_color
                         : model.bg_color;
-  this->old_color = *(rgba8*)model.layer.get_pixel(model.get_pixel_index());
 
-  if (this->old_color == this->new_color) {
-    return event::Flag::NONE;
+  if (this->mode == FillMode::GLOBAL) {
+    return draw::visit(model.layer.get_type(), [&](auto zero) {
+      using Color = decltype(zero);
+      return this->replace_fill<Color>(model);
+    });
   }
 
-  this->scan_fill(
-      model.layer, *model.tex1, model.anim.get_size(), model.curr_pos,
-      model.select_mask
-  );
-  return event::Flag::SNAPSHOT;
+  bool filled = draw::visit(model.layer.get_type(), [&](auto zero) {
+    using Color = decltype(zero);
+    return this->scan_fill<Color>(
+        model.layer, *model.tex1, model.anim.get_size(), model.curr_pos,
+        model.select_mask
+    );
+  });
+  return filled ? event::Flag::SNAPSHOT : event::Flag::NONE;
+}
+
+FillMode Fill::get_mode() const noexcept {
+  return this->mode;
+}
+
+FillScope Fill::get_scope() const noexcept {
+  return this->scope;
 }
 
-[[nodiscard]] inline i32 get_index(ivec pos, i32 width) noexcept {
-  return pos.x + pos.y * width;
+void Fill::set_mode(FillMode mode) noexcept {
+  this->mode = mode;
 }
 
-bool Fill::check_pixel(
-    const std::vector<bool>& mask, const draw::Layer& layer, ivec pos, i32 width
-) const noexcept {
-  return mask[get_index(pos, width)] &&
-         *(rgba8*)layer.get_pixel(get_index(pos, width)) == this->old_color;
+void Fill::set_scope(FillScope scope) noexcept {
+  this->scope = scope;
 }
 
-void Fill::scan_fill(
+void Fill::set_frame_range(i32 start, i32 count) noexcept {
+  this->frame_start = start;
+  this->frame_count = count;
+}
+
+// === Compare === //
+
+// Unsigned integer the size of the color so pixels are compared at once
+template <typename Color>
+using Word = std::conditional_t<
+    sizeof(Color) == 1, u8, std::conditional_t<sizeof(Color) == 4, u32, u64>>;
+
+template <typename Color>
+[[nodiscard]] inline Word<Color>
+read_word(draw::const_data_ptr pixel) noexcept {
+  Word<Color> word{};
+  std::memcpy(&word, pixel, sizeof(Word<Color>));
+  return word;
+}
+
+// Pixels compared per block, without early exits so these get vectorized
+const i32 COMPARE_BLOCK = 16;
+
+// Counts the pixels matching the color from the start of the row
+template <typename Color>
+[[nodiscard]] i32
+count_right(draw::const_data_ptr pixels, i32 count, Color color) noexcept {
+  using W = Word<Color>;
+  W word = read_word<Color>((draw::const_data_ptr)&color);
+
+  i32 i = 0;
+  for (; i + COMPARE_BLOCK <= count; i += COMPARE_BLOCK) {
+    W diff = 0;
+    for (i32 j = 0; j < COMPARE_BLOCK; ++j) {
+      // NOLINTNEXTLINE
+      diff |= read_word<Color>(pixels + (i + j) * sizeof(W)) ^ word;
+    }
+    if (diff) {
+      break;
+    }
+  }
+
+  // NOLINTNEXTLINE
+  while (i < count && read_word<Color>(pixels + i * sizeof(W)) == word) {
+    ++i;
+  }
+  return i;
+}
+
+// Same as count_right() but from the last pixel of the row to the left
+template <typename Color>
+[[nodiscard]] i32
+count_left(draw::const_data_ptr last, i32 count, Color color) noexcept {
+  using W = Word<Color>;
+  W word = read_word<Color>((draw::const_data_ptr)&color);
+
+  i32 i = 0;
+  for (; i + COMPARE_BLOCK <= count; i += COMPARE_BLOCK) {
+    W diff = 0;
+    for (i32 j = 0; j < COMPARE_BLOCK; ++j) {
+      // NOLINTNEXTLINE
+      diff |= read_word<Color>(last - (i + j) * sizeof(W)) ^ word;
+    }
+    if (diff) {
+      break;
+    }
+  }
+
+  // NOLINTNEXTLINE
+  while (i < count && read_word<Color>(last - i * sizeof(W)) == word) {
+    ++i;
+  }
+  return i;
+}
+
+// === Visited Bits === //
+
+void set_bits(
+    std::vector<u64>& bits, i64 start, i64 count, bool value
+) noexcept {
+  for (i64 i = start, end = start + count; i < end;) {
+    i64 offset = i & 63;
+    i64 width = std::min(end - i, 64 - offset);
+    u64 mask = width == 64 ? ~0ULL : ((1ULL << width) - 1ULL) << offset;
+    if (value) {
+      bits[i >> 6] |= mask;
+    } else {
+      bits[i >> 6] &= ~mask;
+    }
+    i += width;
+  }
+}
+
+// Returns the first unset bit from the index, end if all are set
+[[nodiscard]] i64
+skip_set_bits(const std::vector<u64>& bits, i64 index, i64 end) noexcept {
+  while (index < end) {
+    u64 word = bits[index >> 6] >> (index & 63);
+    if (word == ~0ULL >> (index & 63)) {
+      // Rest of the word is set
+      index = (index | 63) + 1;
+      continue;
+    }
+
+    while (word & 1ULL) {
+      word >>= 1;
+      ++index;
+    }
+    return std::min(index, end);
+  }
+  return end;
+}
+
+// === Region === //
+
+// Pixels of the old color inside the selection
+template <typename Color> struct Region {
+  const draw::Layer& layer;
+  const std::vector<bool>& mask;
+  ivec size;
+  Color color;
+
+  [[nodiscard]] bool has(ivec pos) const noexcept {
+    return this->mask[pos.x + (i64)pos.y * this->size.x] &&
+           this->layer.template get_color<Color>(pos) == this->color;
+  }
+
+  // First x to the right of pos that is not in the region, pos is included
+  [[nodiscard]] i32 find_right(ivec pos) const noexcept {
+    i64 row = (i64)pos.y * this->size.x;
+    for (i32 x = pos.x; x < this->size.x;) {
+      // The row of a tile is contiguous
+      i32 count = std::min(this->size.x, (x | draw::TILE_MASK) + 1) - x;
+      i32 same = count_right(
+          this->layer.get_pixel(ivec{x, pos.y}), count, this->color
+      );
+      // Finds the unset bit a word at a time
+      auto begin = this->mask.begin() + (row + x);
+      i32 inside = (i32)(std::find(begin, begin + same, false) - begin);
+      if (inside < same) {
+        return x + inside;
+      }
+
+      if (same < count) {
+        return x + same;
+      }
+      x += count;
+    }
+    return this->size.x;
+  }
+
+  // Leftmost x of the run in the region ending at pos
+  [[nodiscard]] i32 find_left(ivec pos) const noexcept {
+    i64 row = (i64)pos.y * this->size.x;
+    for (i32 x = pos.x; x >= 0;) {
+      i32 count = (x & draw::TILE_MASK) + 1;
+      i32 same = count_left(
+          this->layer.get_pixel(ivec{x, pos.y}), count, this->color
+      );
+      auto begin = std::make_reverse_iterator(
+          this->mask.begin() + (row + x + 1)
+      );
+      i32 inside = (i32)(std::find(begin, begin + same, false) - begin);
+      if (inside < same) {
+        return x - inside + 1;
+      }
+
+      if (same < count) {
+        return x - same + 1;
+      }
+      x -= count;
+    }
+    return 0;
+  }
+};
+
+template <typename Color>
+bool Fill::scan_fill(
     draw::Layer& layer, Texture& texture, ivec size, ivec pos,
     const std::vector<bool>& mask
 ) noexcept {
-  std::stack<ivec> s{};
-  bool span_above = false;
-  bool span_below = false;
+  Color new_color = layer.to_color<Color>(this->new_color);
+  Color old_color = layer.get_color<Color>(pos);
+  if (old_color == new_color) {
+    return false;
+  }
 
-  s.push(pos);
+  Region<Color> region{layer, mask, size, old_color};
+  u64 words = ((u64)size.x * size.y + 63U) / 64U;
+  if (this->visited.size() != words) {
+    this->visited.assign(words, 0U);
+  }
+  this->stack.clear();
+  this->spans.clear();
 
-  auto pixels = texture.lock_texture<rgba8>();
-  while (!s.empty()) {
-    pos = s.top();
-    s.pop();
+  auto add_run = [&](i32 left, i32 right, i32 y) {
+    Span span{left, y, right - left};
+    this->spans.push_back(span);
+    this->stack.push_back(span);
+    set_bits(this->visited, left + (i64)y * size.x, span.width, true);
+  };
+  add_run(region.find_left(pos), region.find_right(pos), pos.y);
 
-    while (pos.x >= 0 && this->check_pixel(mask, layer, pos, size.x)) {
-      --pos.x;
+  while (!this->stack.empty()) {
+    Span span = this->stack.back();
+    this->stack.pop_back();
+
+    for (i32 y : {span.y - 1, span.y + 1}) {
+      if (y < 0 || y >= size.y) {
+        continue;
+      }
+
+      i64 row = (i64)y * size.x;
+      i32 end = span.x + span.width;
+      for (i32 x = span.x; x < end;) {
+        x = (i32)(skip_set_bits(this->visited, row + x, row + end) - row);
+        if (x >= end) {
+          break;
+        }
+
+        if (!region.has({x, y})) {
+          ++x;
+          continue;
+        }
+
+        // Runs are maximal, so only the first one can reach further left
+        i32 left = x == span.x ? region.find_left({x, y}) : x;
+        i32 right = region.find_right({x, y});
+        add_run(left, right, y);
+        x = right + 1;
+      }
     }
-    ++pos.x;
-    span_above = span_below = false;
+  }
+
+  irect rect{size.x, size.y, 0, 0};
+  i32 right = 0;
+  i32 bottom = 0;
+  for (const auto& span : this->spans) {
+    rect.x = std::min(rect.x, span.x);
+    rect.y = std::min(rect.y, span.y);
+    right = std::max(right, span.x + span.width);
+    bottom = std::max(bottom, span.y + 1);
+  }
+  rect.w = right - rect.x;
+  rect.h = bottom - rect.y;
 
-    for (; pos.x < size.x && this->check_pixel(mask, layer, pos, size.x);
-         ++pos.x) {
-      layer.paint(get_index(pos, size.x), this->new_color);
-      pixels.paint(get_index(pos, size.x), this->new_color);
+  // Spans are painted after the region is found so each is a single fill.
+  // The texture shows the color the layer holds
+  rgba8 texture_color = layer.to_rgba8(new_color);
+  auto pixels = texture.edit_pixels<rgba8>(rect);
+  for (const auto& span : this->spans) {
+    layer.set_span({span.x, span.y}, span.width, new_color);
+    std::fill_n(pixels.get_ptr({span.x, span.y}), span.width, texture_color);
+    set_bits(
+        this->visited, span.x + (i64)span.y * size.x, span.width, false
+    );
+  }
+  return true;
+}
 
-      if (!span_above && pos.y > 0 &&
-          this->check_pixel(mask, layer, {pos.x, pos.y - 1}, size.x)) {
-        s.push({pos.x, pos.y - 1});
-        span_above = true;
-      } else if (span_above && pos.y > 0 && !this->check_pixel(mask, layer, {pos.x, pos.y - 1}, size.x)) {
-        span_above = false;
+// === Replace === //
+
+const i32 TILE_PIXELS = draw::TILE_SIZE * draw::TILE_SIZE;
+
+// Whether a selected pixel of the tile has the color
+template <typename Color>
+[[nodiscard]] bool
+has_color(draw::const_data_ptr pixels, const u8* mask, Color color) noexcept {
+  using W = Word<Color>;
+  W word = read_word<Color>((draw::const_data_ptr)&color);
+
+  // A row at a time, without early exits so these get vectorized
+  for (i32 i = 0; i < TILE_PIXELS; i += draw::TILE_SIZE) {
+    u8 found = 0U;
+    for (i32 j = i; j < i + draw::TILE_SIZE; ++j) {
+      // NOLINTNEXTLINE
+      W pixel = read_word<Color>(pixels + j * sizeof(W));
+      // NOLINTNEXTLINE
+      found |= (u8)(pixel == word) & mask[j];
+    }
+    if (found) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Copies the tile with the selected pixels of the old color replaced
+template <typename Color>
+void replace_color(
+    draw::data_ptr dst, draw::const_data_ptr src, const u8* mask,
+    Color old_color, Color new_color
+) noexcept {
+  using W = Word<Color>;
+  W old_word = read_word<Color>((draw::const_data_ptr)&old_color);
+  W new_word = read_word<Color>((draw::const_data_ptr)&new_color);
+
+  // A row at a time through locals, these cannot alias so the row gets
+  // vectorized
+  W row[draw::TILE_SIZE];
+  u8 row_mask[draw::TILE_SIZE];
+  for (i32 y = 0; y < TILE_PIXELS; y += draw::TILE_SIZE) {
+    // NOLINTNEXTLINE
+    std::memcpy(row, src + y * sizeof(W), sizeof(row));
+    // NOLINTNEXTLINE
+    std::memcpy(row_mask, mask + y, sizeof(row_mask));
+    for (i32 x = 0; x < draw::TILE_SIZE; ++x) {
+      // All ones if replaced, picks between the two without branching
+      W select = (W)0 - (W)((u8)(row[x] == old_word) & row_mask[x]);
+      row[x] = (row[x] & ~select) | (new_word & select);
+    }
+    // NOLINTNEXTLINE
+    std::memcpy(dst + y * sizeof(W), row, sizeof(row));
+  }
+}
+
+// Calls fn(i) for each i below count, spread over the cores
+template <typename Fn> void parallel_for(i32 count, Fn&& fn) noexcept {
+  i32 cores = (i32)std::max(1U, std::thread::hardware_concurrency());
+  i32 thread_count = std::min(count, cores);
+  if (thread_count <= 1) {
+    for (i32 i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<i32> next{0};
+  auto run = [&]() {
+    for (i32 i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> threads{};
+  threads.reserve(thread_count - 1);
+  for (i32 i = 1; i < thread_count; ++i) {
+    threads.emplace_back(run);
+  }
+  run();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void Fill::update_targets(Model& model) noexcept {
+  this->targets.clear();
+  this->current_target = -1;
+  auto& anim = model.anim;
+  switch (this->scope) {
+  case FillScope::CEL:
+    this->current_target = 0;
+    this->targets.push_back(model.layer);
+    break;
+
+  case FillScope::FRAMES: {
+    i32 start = std::clamp(this->frame_start, 0, anim.get_frame_count());
+    i32 end = this->frame_count < 0
+                  ? anim.get_frame_count()
+                  : std::min(anim.get_frame_count(), start + this->frame_count);
+    if (model.frame_index >= start && model.frame_index < end) {
+      this->current_target = model.frame_index - start;
+    }
+    for (i32 f = start; f < end; ++f) {
+      this->targets.push_back(anim.get_layer(f, model.layer_index));
+    }
+    break;
+  }
+
+  case FillScope::ALL:
+    this->current_target =
+        model.layer_index * anim.get_frame_count() + model.frame_index;
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+        this->targets.push_back(anim.get_layer(f, l));
+      }
+    }
+    break;
+  }
+}
+
+void Fill::update_tile_masks(
+    ivec size, const std::vector<bool>& mask
+) noexcept {
+  ivec tiles{
+      (size.x + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT,
+      (size.y + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT};
+  this->mask_offsets.assign((i64)tiles.x * tiles.y, -1);
+  this->tile_masks.assign(TILE_PIXELS, 1U);
+
+  for (i32 ty = 0; ty < tiles.y; ++ty) {
+    for (i32 tx = 0; tx < tiles.x; ++tx) {
+      ivec pos{tx << draw::TILE_SHIFT, ty << draw::TILE_SHIFT};
+      ivec end{
+          std::min(size.x, pos.x + draw::TILE_SIZE),
+          std::min(size.y, pos.y + draw::TILE_SIZE)};
+
+      // Finds the set and unset bits a word at a time
+      bool all = end.x - pos.x == draw::TILE_SIZE &&
+                 end.y - pos.y == draw::TILE_SIZE;
+      bool any = false;
+      for (i32 y = pos.y; y < end.y; ++y) {
+        auto begin = mask.begin() + (pos.x + (i64)y * size.x);
+        auto last = begin + (end.x - pos.x);
+        all = all && std::find(begin, last, false) == last;
+        any = any || std::find(begin, last, true) != last;
+      }
+
+      i64 index = tx + (i64)ty * tiles.x;
+      if (all) {
+        this->mask_offsets[index] = 0;
+        continue;
+      }
+      if (!any) {
+        continue;
+      }
+
+      // Pixels past the edge of the animation are never selected
+      i64 offset = (i64)this->tile_masks.size();
+      this->mask_offsets[index] = offset;
+      this->tile_masks.resize(offset + TILE_PIXELS, 0U);
+      for (i32 y = pos.y; y < end.y; ++y) {
+        for (i32 x = pos.x; x < end.x; ++x) {
+          this->tile_masks
+              [offset + ((y - pos.y) << draw::TILE_SHIFT) + (x - pos.x)] =
+              mask[x + (i64)y * size.x];
+        }
+      }
+    }
+  }
+}
+
+enum TileState : u8 {
+  NO_COLOR,
+  HAS_COLOR,
+  // Same tile as the previous target, not scanned again
+  SHARED,
+};
+
+template <typename Color> u32 Fill::replace_fill(Model& model) noexcept {
+  Color new_color = model.layer.to_color<Color>(this->new_color);
+  Color old_color = model.layer.get_color<Color>(model.curr_pos);
+  if (old_color == new_color) {
+    return event::Flag::NONE;
+  }
+
+  ivec size = model.anim.get_size();
+  this->update_targets(model);
+  this->update_tile_masks(size, model.select_mask);
+  i32 tile_count = (i32)this->mask_offsets.size();
+  i32 target_count = (i32)this->targets.size();
+  this->states.resize((i64)target_count * tile_count);
+
+  // Only reads the pixels, so each cel is scanned on its own core
+  parallel_for(target_count, [&](i32 t) {
+    const draw::Cel* cel = this->targets[t].get_cel();
+    const draw::Cel* prev = t > 0 ? this->targets[t - 1].get_cel() : nullptr;
+    // NOLINTNEXTLINE
+    u8* states = this->states.data() + (i64)t * tile_count;
+    for (i32 i = 0; i < tile_count; ++i) {
+      if (this->mask_offsets[i] == -1) {
+        states[i] = NO_COLOR;
+        continue;
+      }
+
+      // Tiles are shared across the frames once deduped
+      draw::Tile* tile = cel ? cel->get_tile(i) : nullptr;
+      if (t > 0 && tile == (prev ? prev->get_tile(i) : nullptr)) {
+        states[i] = SHARED;
+        continue;
+      }
+
+      draw::const_data_ptr src = tile ? tile->get_ptr() : draw::ZERO_TILE;
+      // NOLINTNEXTLINE
+      const u8* mask = this->tile_masks.data() + this->mask_offsets[i];
+      states[i] = has_color(src, mask, old_color) ? HAS_COLOR : NO_COLOR;
+    }
+  });
+
+  // The store is not thread safe, so the tiles are allocated here
+  i32 tile_bytes = TILE_PIXELS * (i32)sizeof(Color);
+  auto& store = draw::get_tile_store();
+  this->jobs.clear();
+  this->replaced.assign(tile_count, nullptr);
+  for (i32 t = 0; t < target_count; ++t) {
+    const draw::Cel* cel = this->targets[t].get_cel();
+    // NOLINTNEXTLINE
+    u8* states = this->states.data() + (i64)t * tile_count;
+    for (i32 i = 0; i < tile_count; ++i) {
+      if (states[i] == SHARED) {
+        // NOLINTNEXTLINE
+        states[i] = states[i - tile_count];
+        if (states[i] == HAS_COLOR) {
+          this->jobs.push_back(
+              {nullptr, 0, this->replaced[i], t, i, true}
+          );
+        }
+        continue;
+      }
+      if (states[i] == NO_COLOR) {
+        continue;
       }
 
-      if (!span_below && pos.y < size.y - 1 &&
-          this->check_pixel(mask, layer, {pos.x, pos.y + 1}, size.x)) {
-        s.push({pos.x, pos.y + 1});
-        span_below = true;
-      } else if (span_below && pos.y < size.y - 1 && !this->check_pixel(mask, layer, {pos.x, pos.y + 1}, size.x)) {
-        span_below = false;
+      auto* dst = store.allocate(tile_bytes);
+      if (!dst) {
+        // Nothing was painted yet
+        for (const auto& job : this->jobs) {
+          if (!job.shared) {
+            draw::release_tile(job.dst, tile_bytes);
+          }
+        }
+        return event::Flag::NONE;
       }
+
+      draw::Tile* tile = cel ? cel->get_tile(i) : nullptr;
+      this->jobs.push_back(
+          {tile ? tile->get_ptr() : draw::ZERO_TILE, this->mask_offsets[i],
+           dst, t, i, false}
+      );
+      this->replaced[i] = dst;
+    }
+  }
+
+  i32 job_count = (i32)this->jobs.size();
+  if (job_count == 0) {
+    return event::Flag::NONE;
+  }
+
+  parallel_for(job_count, [&](i32 i) {
+    const auto& job = this->jobs[i];
+    if (!job.shared) {
+      replace_color(
+          job.dst->get_ptr(), job.src,
+          // NOLINTNEXTLINE
+          this->tile_masks.data() + job.mask, old_color, new_color
+      );
+    }
+  });
+
+  // Tiles replaced in the current cel are uploaded again
+  irect rect{size.x, size.y, 0, 0};
+  i32 right = 0;
+  i32 bottom = 0;
+  i32 tiles_width = (size.x + draw::TILE_SIZE - 1) >> draw::TILE_SHIFT;
+
+  // A cel that could not be allocated stops the fill, the tiles written
+  // before it are still snapped
+  i32 written = 0;
+  for (; written < job_count; ++written) {
+    const auto& job = this->jobs[written];
+    // The cels keep their own references of the tiles
+    if (this->targets[job.target].set_tile(job.index, job.dst) != Error::OK) {
+      break;
+    }
+
+    if (job.target == this->current_target) {
+      ivec pos{
+          (job.index % tiles_width) << draw::TILE_SHIFT,
+          (job.index / tiles_width) << draw::TILE_SHIFT};
+      rect.x = std::min(rect.x, pos.x);
+      rect.y = std::min(rect.y, pos.y);
+      right = std::max(right, std::min(size.x, pos.x + draw::TILE_SIZE));
+      bottom = std::max(bottom, std::min(size.y, pos.y + draw::TILE_SIZE));
+    }
+  }
+  for (const auto& job : this->jobs) {
+    if (!job.shared) {
+      draw::release_tile(job.dst, tile_bytes);
     }
   }
+  if (right > rect.x && bottom > rect.y) {
+    rect.w = right - rect.x;
+    rect.h = bottom - rect.y;
+    auto pixels = model.tex1->edit_pixels<rgba8>(rect);
+    model.layer.get_rgba8_pixels(
+        pixels.get_ptr(rect.pos), pixels.get_pitch(), rect
+    );
+  }
+
+  if (written == 0) {
+    return event::Flag::NONE;
+  }
+  return this->scope == FillScope::CEL ? event::Flag::SNAPSHOT
+                                       : event::Flag::SNAPSHOT_CELS;
 }
 
 } // namespace tool
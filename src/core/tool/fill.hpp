@@ -9,6 +9,7 @@
 #define PXL_TOOL_FILL_HPP
 
 #include "../draw/layer.hpp"
+#include "./brush.hpp"
 #include "./enum.hpp"
 #include "model/model.hpp"
 #include "types.hpp"
@@ -18,6 +19,22 @@
 
 namespace tool {
 
+enum class FillMode : u8 {
+  // Pixels of the clicked color connected to the clicked pixel
+  CONTIGUOUS,
+  // Every pixel of the clicked color in the cels of the scope
+  GLOBAL,
+};
+
+// Cels painted by a GLOBAL fill
+enum class FillScope : u8 {
+  CEL,
+  // Current layer on the frames of the range
+  FRAMES,
+  // Every frame and layer
+  ALL,
+};
+
 /**
  * Refer: https://en.wikipedia.org/wiki/Flood_fill
  **/
@@ -25,22 +42,82 @@ class Fill {
 public:
   [[nodiscard]] u32 execute(Model& model, const event::Input& evt) noexcept;
 
+  [[nodiscard]] FillMode get_mode() const noexcept;
+  [[nodiscard]] FillScope get_scope() const noexcept;
+  void set_mode(FillMode mode) noexcept;
+  void set_scope(FillScope scope) noexcept;
+
+  /**
+   * Frames painted by the FRAMES scope, clamped to the animation.
+   * A negative count goes until the last frame, the default is every frame
+   **/
+  void set_frame_range(i32 start, i32 count) noexcept;
+
 private:
   rgba8 new_color{};
-  rgba8 old_color{};
+  FillMode mode = FillMode::CONTIGUOUS;
+  FillScope scope = FillScope::CEL;
+  i32 frame_start = 0;
+  i32 frame_count = -1;
 
-  [[nodiscard]] inline bool check_pixel(
-      const std::vector<bool>& mask, const draw::Layer& layer, ivec pos,
-      i32 width
-  ) const noexcept;
+  // Packed bit per pixel, cleared again after each fill
+  std::vector<u64> visited{};
+  // Reused between fills
+  std::vector<Span> stack{};
+  std::vector<Span> spans{};
 
   /**
    * Refer: https://lodev.org/cgtutor/floodfill.html
+   * Finds the region as spans first without writing, then paints each span
+   * at once. Specialized for the color type of the layer.
+   * Returns false if there is nothing to fill
    **/
-  void scan_fill(
+  template <typename Color>
+  [[nodiscard]] bool scan_fill(
       draw::Layer& layer, Texture& texture, ivec size, ivec pos,
       const std::vector<bool>& mask
   ) noexcept;
+
+  // Tile of a cel with the old color, see replace_fill()
+  struct TileJob {
+    draw::const_data_ptr src = nullptr;
+    // Offset of the selection of the tile in tile_masks
+    i64 mask = 0;
+    draw::Tile* dst = nullptr;
+    i32 target = 0;
+    i32 index = 0;
+    // Same tile as the previous target, dst is already written
+    bool shared = false;
+  };
+
+  // Cels of the scope, the frames of a layer are next to each other
+  std::vector<draw::Layer> targets{};
+  // Index of the current cel in targets, -1 if outside the scope
+  i32 current_target = -1;
+  // TileState of each tile of each target
+  std::vector<u8> states{};
+  // Tile of the previous target written to, per tile index
+  std::vector<draw::Tile*> replaced{};
+  std::vector<TileJob> jobs{};
+  // Offset of the selection of each tile in tile_masks, -1 if none of its
+  // pixels are selected
+  std::vector<i64> mask_offsets{};
+  // A byte per pixel of a tile, 1 if selected. Starts with a fully selected
+  // tile shared by the tiles inside the selection
+  std::vector<u8> tile_masks{};
+
+  void update_targets(Model& model) noexcept;
+  void update_tile_masks(ivec size, const std::vector<bool>& mask) noexcept;
+
+  /**
+   * Replaces the old color in every cel of the scope.
+   * Tiles with the old color are found on all the cores first, then written
+   * on all the cores. A tile shared with the previous frame is only scanned
+   * and replaced once.
+   * Returns the flags of the snapshot, NONE if nothing changed
+   **/
+  template <typename Color>
+  [[nodiscard]] u32 replace_fill(Model& model) noexcept;
 };
 
 } // namespace tool
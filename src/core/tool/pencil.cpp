@@ -53,44 +53,37 @@ u32 Pencil::execute(Model& model, const event::Input& evt) noexcept {
   return event::Flag::NONE;
 }
 
+Brush& Pencil::get_brush() noexcept {
+  return this->brush;
+}
+
 void Pencil::handle_mouse_down(Model& model, input::MouseType type) noexcept {
   model.color =
       type == input::MouseType::LEFT ? model.fg_color : model.bg_color;
 
-  // Don't draw the point if it is outside
-  if (!model.anim.has_point(model.curr_pos) ||
-      !model.select_mask[model.get_pixel_index()]) {
-    return;
-  }
-
-  model.layer.paint(model.get_pixel_index(), model.color);
-  model.tex1->paint(model.get_pixel_index(), model.color);
+  // Parts outside the canvas are clipped
+  this->brush.sweep(
+      model.curr_pos, model.curr_pos, model.anim.get_size(), this->spans
+  );
+  utils::draw_spans(
+      &model.layer, *model.tex1, model.anim.get_size(), this->spans,
+      model.color, model.select_mask
+  );
 }
 
 void Pencil::handle_mouse_motion(Model& model) noexcept {
-  i32 distance = model.prev_pos.chebyshev_distance(model.curr_pos);
-  if (distance == 0) {
+  if (model.prev_pos == model.curr_pos) {
     return;
   }
 
-  // If distance is 1, just draw the point
-  if (distance == 1) {
-    if (!model.anim.has_point(model.curr_pos) ||
-        !model.select_mask[model.get_pixel_index()]) {
-      return;
-    }
-
-    model.layer.paint(model.get_pixel_index(), model.color);
-    model.tex1->paint(model.get_pixel_index(), model.color);
-    return;
-  }
-
-  // Draw a line to the previous and current position
-  utils::draw_line(
-      &model.layer, *model.tex1, model.anim.get_size(), model.curr_pos,
-      model.prev_pos, model.color, model.select_mask
+  // Sweep the brush from the previous to the current position
+  this->brush.sweep(
+      model.prev_pos, model.curr_pos, model.anim.get_size(), this->spans
+  );
+  utils::draw_spans(
+      &model.layer, *model.tex1, model.anim.get_size(), this->spans,
+      model.color, model.select_mask
   );
 }
 
 } // namespace tool
-
@@ -8,11 +8,13 @@
 #ifndef PXL_TOOL_PENCIL_HPP
 #define PXL_TOOL_PENCIL_HPP
 
+#include "./brush.hpp"
 #include "./enum.hpp"
 #include "model/model.hpp"
 #include "types.hpp"
 #include "view/event.hpp"
 #include "view/input.hpp"
+#include <vector>
 
 namespace tool {
 
@@ -20,8 +22,12 @@ class Pencil {
 public:
   [[nodiscard]] u32 execute(Model& model, const event::Input& evt) noexcept;
 
+  [[nodiscard]] Brush& get_brush() noexcept;
+
 private:
-  /* i32 size = 1; */
+  Brush brush{};
+  // Reused between strokes
+  std::vector<Span> spans{};
   /* bool anti_aliasing = false; */
   /* bool pixel_perfect = false; */
 
@@ -11,9 +11,10 @@ namespace tool::utils {
 
 // === Line Drawing Algorithm === //
 // Bresenham's Algo
+template <typename Color>
 void draw_horizontal_line(
-    draw::Layer* layer, Texture& texture, ivec size, i32 start_x, i32 end_x,
-    i32 y, rgba8 color, const std::vector<bool>& mask
+    draw::Layer* layer, Pixels& pixels, ivec size, i32 start_x, i32 end_x,
+    i32 y, rgba8 color, Color layer_color, const std::vector<bool>& mask
 ) noexcept {
   // Check if the line is within bounds
   if (y < 0 || y >= size.y) {
@@ -32,7 +33,6 @@ void draw_horizontal_line(
   start_x = std::max(0, start_x) + y * size.x;
   end_x = std::min(size.x - 1, end_x) + y * size.x;
 
-  auto pixels = texture.lock_texture<rgba8>();
   for (i32 i = start_x; i <= end_x; ++i) {
     if (!mask[i]) {
       continue;
@@ -40,13 +40,14 @@ void draw_horizontal_line(
 
     pixels.paint(i, color);
     if (layer)
-      layer->paint(i, color);
+      layer->set_color(i, layer_color);
   }
 }
 
+template <typename Color>
 void draw_vertical_line(
-    draw::Layer* layer, Texture& texture, ivec size, i32 start_y, i32 end_y,
-    i32 x, rgba8 color, const std::vector<bool>& mask
+    draw::Layer* layer, Pixels& pixels, ivec size, i32 start_y, i32 end_y,
+    i32 x, rgba8 color, Color layer_color, const std::vector<bool>& mask
 ) noexcept {
   // Check if the line is within bounds
   if (x < 0 || x >= size.x) {
@@ -65,7 +66,6 @@ void draw_vertical_line(
   start_y = std::max(0, start_y) * size.x + x;
   end_y = std::min(size.y - 1, end_y) * size.x + x;
 
-  auto pixels = texture.lock_texture<rgba8>();
   for (i32 i = start_y; i <= end_y; i += size.x) {
     if (!mask[i]) {
       continue;
@@ -73,13 +73,14 @@ void draw_vertical_line(
 
     pixels.paint(i, color);
     if (layer)
-      layer->paint(i, color);
+      layer->set_color(i, layer_color);
   }
 }
 
+template <typename Color>
 void draw_line_low(
-    draw::Layer* layer, Texture& texture, ivec size, ivec start, ivec end,
-    rgba8 color, const std::vector<bool>& mask
+    draw::Layer* layer, Pixels& pixels, ivec size, ivec start, ivec end,
+    rgba8 color, Color layer_color, const std::vector<bool>& mask
 ) noexcept {
   ivec d = end - start;
 
@@ -103,12 +104,11 @@ void draw_line_low(
     }
   }
 
-  auto pixels = texture.lock_texture<rgba8>();
   for (; x <= end.x; ++x) {
     if (y >= 0 && y < size.y && mask[x + y * size.x]) {
       pixels.paint(x + y * size.x, color);
       if (layer)
-        layer->paint(x + y * size.x, color);
+        layer->set_color(x + y * size.x, layer_color);
     }
 
     if (error > 0) {
@@ -120,9 +120,10 @@ void draw_line_low(
   }
 }
 
+template <typename Color>
 void draw_line_high(
-    draw::Layer* layer, Texture& texture, ivec size, ivec start, ivec end,
-    rgba8 color, const std::vector<bool>& mask
+    draw::Layer* layer, Pixels& pixels, ivec size, ivec start, ivec end,
+    rgba8 color, Color layer_color, const std::vector<bool>& mask
 ) noexcept {
   ivec d = end - start;
 
@@ -146,12 +147,11 @@ void draw_line_high(
     }
   }
 
-  auto pixels = texture.lock_texture<rgba8>();
   for (; y <= end.y; ++y) {
     if (x >= 0 && x < size.x && mask[x + y * size.x]) {
       pixels.paint(x + y * size.x, color);
       if (layer)
-        layer->paint(x + y * size.x, color);
+        layer->set_color(x + y * size.x, layer_color);
     }
 
     if (error > 0) {
@@ -163,37 +163,147 @@ void draw_line_high(
   }
 }
 
-void draw_line(
+template <typename Color>
+void draw_line_typed(
     draw::Layer* layer, Texture& texture, ivec size, ivec start, ivec end,
-    rgba8 color, const std::vector<bool>& mask
+    rgba8 color, Color layer_color, const std::vector<bool>& mask
 ) noexcept {
   // TEST: Check if the line is within the rect
   // Unlikely to happen if user always draw in the canvas
 
+  // Only the rect around the line is uploaded
+  i32 left = std::max(0, std::min(start.x, end.x));
+  i32 top = std::max(0, std::min(start.y, end.y));
+  irect rect{
+      left, top, std::min(size.x, std::max(start.x, end.x) + 1) - left,
+      std::min(size.y, std::max(start.y, end.y) + 1) - top};
+  if (rect.w <= 0 || rect.h <= 0) {
+    return;
+  }
+  auto pixels = texture.edit_pixels<rgba8>(rect);
+
   if (start.x == end.x) {
     draw_vertical_line(
-        layer, texture, size, start.y, end.y, start.x, color, mask
+        layer, pixels, size, start.y, end.y, start.x, color, layer_color,
+        mask
     );
   } else if (start.y == end.y) {
     draw_horizontal_line(
-        layer, texture, size, start.x, end.x, start.y, color, mask
+        layer, pixels, size, start.x, end.x, start.y, color, layer_color,
+        mask
     );
   }
 
   if (std::abs(start.y - end.y) < std::abs(start.x - end.x)) {
     if (start.x > end.x) {
-      draw_line_low(layer, texture, size, end, start, color, mask);
+      draw_line_low(
+          layer, pixels, size, end, start, color, layer_color, mask
+      );
     } else {
-      draw_line_low(layer, texture, size, start, end, color, mask);
+      draw_line_low(
+          layer, pixels, size, start, end, color, layer_color, mask
+      );
     }
   } else {
     if (start.y > end.y) {
-      draw_line_high(layer, texture, size, end, start, color, mask);
+      draw_line_high(
+          layer, pixels, size, end, start, color, layer_color, mask
+      );
     } else {
-      draw_line_high(layer, texture, size, start, end, color, mask);
+      draw_line_high(
+          layer, pixels, size, start, end, color, layer_color, mask
+      );
     }
   }
 }
 
+void draw_line(
+    draw::Layer* layer, Texture& texture, ivec size, ivec start, ivec end,
+    rgba8 color, const std::vector<bool>& mask
+) noexcept {
+  if (!layer) {
+    draw_line_typed(layer, texture, size, start, end, color, color, mask);
+    return;
+  }
+
+  // Specialize the loops for the color type of the layer
+  draw::visit(layer->get_type(), [&](auto zero) {
+    using Color = decltype(zero);
+    // The texture shows the color the layer holds
+    Color layer_color = layer->to_color<Color>(color);
+    draw_line_typed(
+        layer, texture, size, start, end, layer->to_rgba8(layer_color),
+        layer_color, mask
+    );
+  });
+}
+
+// === Span Drawing === //
+template <typename Color>
+void draw_spans_typed(
+    draw::Layer* layer, Texture& texture, ivec size,
+    const std::vector<Span>& spans, rgba8 color, Color layer_color,
+    const std::vector<bool>& mask
+) noexcept {
+  i32 left = size.x;
+  i32 right = 0;
+  for (const auto& span : spans) {
+    left = std::min(left, span.x);
+    right = std::max(right, span.x + span.width);
+  }
+  irect rect{
+      left, spans.front().y, right - left,
+      spans.back().y - spans.front().y + 1};
+
+  auto pixels = texture.edit_pixels<rgba8>(rect);
+  for (const auto& span : spans) {
+    auto* row = pixels.get_ptr({0, span.y});
+    i64 offset = (i64)span.y * size.x;
+    i32 end = span.x + span.width;
+
+    // Only the runs inside the selection are painted
+    for (i32 x = span.x; x < end;) {
+      if (!mask[offset + x]) {
+        ++x;
+        continue;
+      }
+
+      i32 start = x;
+      while (x < end && mask[offset + x]) {
+        ++x;
+      }
+      // NOLINTNEXTLINE
+      std::fill(row + start, row + x, color);
+      if (layer)
+        layer->set_span({start, span.y}, x - start, layer_color);
+    }
+  }
+}
+
+void draw_spans(
+    draw::Layer* layer, Texture& texture, ivec size,
+    const std::vector<Span>& spans, rgba8 color, const std::vector<bool>& mask
+) noexcept {
+  if (spans.empty()) {
+    return;
+  }
+
+  if (!layer) {
+    draw_spans_typed(layer, texture, size, spans, color, color, mask);
+    return;
+  }
+
+  // Specialize the loops for the color type of the layer
+  draw::visit(layer->get_type(), [&](auto zero) {
+    using Color = decltype(zero);
+    // The texture shows the color the layer holds
+    Color layer_color = layer->to_color<Color>(color);
+    draw_spans_typed(
+        layer, texture, size, spans, layer->to_rgba8(layer_color),
+        layer_color, mask
+    );
+  });
+}
+
 } // namespace tool::utils
 
@@ -9,11 +9,13 @@
 #define PXL_TOOL_UTILS_HPP
 
 #include "../draw/layer.hpp"
+#include "./brush.hpp"
 #include "types.hpp"
 #include <vector>
 
 #include "view/sdl3/texture.hpp"
 using Texture = view::sdl3::Texture;
+using Pixels = view::sdl3::Pixels<rgba8>;
 
 namespace tool::utils {
 
@@ -33,6 +35,22 @@ void draw_line(
     rgba8 color, const std::vector<bool>& mask
 ) noexcept;
 
+/**
+ * Paints the spans from Brush::sweep(), only the rect around the spans of
+ * the texture is uploaded.
+ *
+ * @param layer - nullable, if texture is the only thing needs to be updated
+ * @param texture
+ * @param size - size of the layer/texture
+ * @param spans - sorted by row and inside the layer/texture
+ * @param color - what color to paint on the layer/texture
+ * @param mask - allowed pixel position to draw on the layer/texture
+ **/
+void draw_spans(
+    draw::Layer* layer, Texture& texture, ivec size,
+    const std::vector<Span>& spans, rgba8 color, const std::vector<bool>& mask
+) noexcept;
+
 } // namespace tool::utils
 
 #endif
@@ -7,9 +7,9 @@
 
 #include "./presenter.hpp"
 #include "core/cfg/shortcut.hpp"
+#include "core/draw/store.hpp"
 #include "core/draw/types.hpp"
 #include "core/history/caretaker.hpp"
-#include "core/history/snapshot.hpp"
 #include "core/logger/logger.hpp"
 #include "core/tool/enum.hpp"
 #include "core/tool/eraser.hpp"
@@ -21,6 +21,7 @@
 #include "core/tool/zoom.hpp"
 #include "model/model.hpp"
 #include <algorithm>
+#include <cerrno>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -39,6 +40,8 @@ inline tool::Pencil pencil{};
 inline tool::Eraser eraser{};
 inline tool::Line line{};
 inline tool::Fill fill{};
+// FRAMES scope of the fill starts at the current frame instead of the first
+inline bool fill_from_frame = false;
 inline tool::Select select{};
 
 inline tool::Pan pan{};
@@ -57,12 +60,28 @@ inline View view{};
 void presenter::init() noexcept {
   view.init();
 
+  // Long animations can keep their pixels in a scratch file instead
+  if (const c8* path = std::getenv("PXL_SCRATCH_FILE")) {
+    if (draw::get_tile_store().init_mapped(path) != Error::OK) {
+      logger::error(
+          "Could not map scratch file %s: %s", path, std::strerror(errno)
+      );
+    }
+  }
+
+  // Old history goes to a temporary file once over the budget
+  if (caretaker.init_spill(std::getenv("PXL_HISTORY_FILE")) != Error::OK) {
+    logger::error("Could not create the history spill file");
+  }
+
   shortcut.load_config("../keys.cfg");
 }
 
 void presenter::run() noexcept {
   view.run();
 
+  // Moves that were not appended yet are kept in the journal
+  caretaker.close_journal(model);
   view.~View();
   model.~Model();
 }
@@ -84,13 +103,17 @@ void presenter::window_resized() noexcept {
   view.set_canvas_rect(model.rect);
 }
 
+// Uploads only the pixels changed by the last undo or redo
 inline void update_canvas_texture() noexcept {
   using namespace presenter;
-  presenter::view.get_curr_texture().set_pixels(
-      (rgba8*)model.anim.get_layer(model.frame_index, model.layer_index)
-          .get_ptr(),
-      model.anim.get_size()
-  );
+  irect rect = caretaker.get_changed_rect();
+  if (rect.w <= 0 || rect.h <= 0) {
+    return;
+  }
+
+  auto pixels = presenter::view.get_curr_texture().edit_pixels<rgba8>(rect);
+  model.anim.get_layer(model.frame_index, model.layer_index)
+      .get_rgba8_pixels(pixels.get_ptr(rect.pos), pixels.get_pitch(), rect);
 }
 
 inline void handle_unselect() noexcept {
@@ -106,6 +129,87 @@ inline void handle_unselect() noexcept {
   );
 }
 
+// Brush of the current tool, nullptr if the tool has no brush
+inline tool::Brush* get_tool_brush() noexcept {
+  using namespace presenter;
+  switch (model.tool) {
+  case tool::Type::PENCIL:
+    return &pencil.get_brush();
+
+  case tool::Type::ERASER:
+    return &eraser.get_brush();
+
+  default:
+    return nullptr;
+  }
+}
+
+inline void handle_brush_size(i32 offset) noexcept {
+  auto* brush = get_tool_brush();
+  if (!brush) {
+    return;
+  }
+
+  brush->set_size(brush->get_size() + offset);
+  logger::info("Brush size %d", brush->get_size());
+}
+
+inline void handle_brush_shape() noexcept {
+  auto* brush = get_tool_brush();
+  if (!brush) {
+    return;
+  }
+
+  if (brush->get_shape() == tool::BrushShape::SQUARE) {
+    logger::info("Circle brush");
+    brush->set_shape(tool::BrushShape::CIRCLE);
+  } else {
+    logger::info("Square brush");
+    brush->set_shape(tool::BrushShape::SQUARE);
+  }
+}
+
+inline void handle_fill_mode() noexcept {
+  using namespace presenter;
+  if (fill.get_mode() == tool::FillMode::CONTIGUOUS) {
+    logger::info("Fill every pixel of the color");
+    fill.set_mode(tool::FillMode::GLOBAL);
+  } else {
+    logger::info("Fill the connected pixels");
+    fill.set_mode(tool::FillMode::CONTIGUOUS);
+  }
+}
+
+inline void handle_fill_scope() noexcept {
+  using namespace presenter;
+  switch (fill.get_scope()) {
+  case tool::FillScope::CEL:
+    logger::info("Fill scope: frames of the layer");
+    fill.set_scope(tool::FillScope::FRAMES);
+    fill.set_frame_range(0, -1);
+    fill_from_frame = false;
+    break;
+
+  case tool::FillScope::FRAMES:
+    if (!fill_from_frame) {
+      logger::info("Fill scope: frames of the layer from the current one");
+      fill_from_frame = true;
+      break;
+    }
+
+    logger::info("Fill scope: all frames and layers");
+    fill.set_scope(tool::FillScope::ALL);
+    fill_from_frame = false;
+    break;
+
+  case tool::FillScope::ALL:
+  default:
+    logger::info("Fill scope: current cel");
+    fill.set_scope(tool::FillScope::CEL);
+    break;
+  }
+}
+
 void presenter::key_down_event(
     input::Keycode keycode, input::KeyMod key_mod
 ) noexcept {
@@ -139,7 +243,10 @@ void presenter::key_down_event(
     if (!caretaker.can_undo())
       break;
     logger::info("Undo");
-    caretaker.undo().restore(model);
+    if (caretaker.undo(model) != Error::OK) {
+      logger::error("Could not restore snapshot");
+      break;
+    }
     update_canvas_texture();
     break;
 
@@ -147,7 +254,19 @@ void presenter::key_down_event(
     if (!caretaker.can_redo())
       break;
     logger::info("Redo");
-    caretaker.redo().restore(model);
+    if (caretaker.redo(model) != Error::OK) {
+      logger::error("Could not restore snapshot");
+      break;
+    }
+    update_canvas_texture();
+    break;
+
+  case cfg::ShortcutKey::ACTION_BRANCH:
+    logger::info("Switch branch");
+    if (caretaker.switch_branch(model) != Error::OK) {
+      logger::error("Could not restore snapshot");
+      break;
+    }
     update_canvas_texture();
     break;
 
@@ -155,6 +274,26 @@ void presenter::key_down_event(
     handle_unselect();
     break;
 
+  case cfg::ShortcutKey::ACTION_GROW_BRUSH:
+    handle_brush_size(1);
+    break;
+
+  case cfg::ShortcutKey::ACTION_SHRINK_BRUSH:
+    handle_brush_size(-1);
+    break;
+
+  case cfg::ShortcutKey::ACTION_BRUSH_SHAPE:
+    handle_brush_shape();
+    break;
+
+  case cfg::ShortcutKey::ACTION_FILL_MODE:
+    handle_fill_mode();
+    break;
+
+  case cfg::ShortcutKey::ACTION_FILL_SCOPE:
+    handle_fill_scope();
+    break;
+
   default:
     // Do nothing
     break;
@@ -165,9 +304,16 @@ void handle_flags(u32 flags) {
   using namespace event;
   using namespace presenter;
   if (flags & Flag::SNAPSHOT) {
-    history::Snapshot snapshot{};
-    snapshot.snap(model);
-    caretaker.push_snapshot(std::move(snapshot));
+    // Tiles are deduped and the changes are captured off this thread
+    if (caretaker.snap(model) != Error::OK) {
+      logger::error("Could not take snapshot");
+    }
+  }
+
+  if (flags & Flag::SNAPSHOT_CELS) {
+    if (caretaker.snap_cels(model) != Error::OK) {
+      logger::error("Could not take snapshot");
+    }
   }
 }
 
@@ -221,6 +367,9 @@ void presenter::canvas_mouse_event(const event::Input& evt) noexcept {
     break;
 
   case Type::FILL:
+    if (fill_from_frame) {
+      fill.set_frame_range(model.frame_index, -1);
+    }
     flags = fill.execute(model, evt);
     break;
 
@@ -283,7 +432,7 @@ void presenter::new_file_clicked() noexcept {
 
 void presenter::create_anim() noexcept {
   // TODO: Prototype
-  if (model.anim.get_ptr() != nullptr) {
+  if (model.anim.get_type() != draw::ColorType::NONE) {
     return;
   }
 
@@ -299,10 +448,26 @@ void presenter::create_anim() noexcept {
   delete data; // NOLINT
   view.clear_modals();
 
-  model.anim.init(size, draw::RGBA8);
+  if (model.anim.init(size, draw::RGBA8) != Error::OK) {
+    logger::error("Could not create animation");
+    return;
+  }
   model.frame_index = 0;
   model.layer_index = 0;
   model.layer = model.anim.get_layer(model.frame_index, model.layer_index);
+
+  if (caretaker.init(model) != Error::OK) {
+    logger::error("Could not take snapshot");
+  }
+
+  // Reopens the animation with its history if the journal already exists
+  if (const c8* path = std::getenv("PXL_JOURNAL_FILE")) {
+    if (caretaker.open_journal(path, model) != Error::OK) {
+      logger::error("Could not open the history journal %s", path);
+    }
+    size = model.anim.get_size();
+  }
+
   model.select_mask.resize(size.x * size.y); // NOLINT
   std::fill(model.select_mask.begin(), model.select_mask.end(), true);
 
@@ -318,12 +483,28 @@ void presenter::create_anim() noexcept {
   view.set_canvas_rect(model.rect);
   view.set_draw_size(size);
 
-  history::Snapshot snapshot{};
-  snapshot.snap(model);
-  caretaker.push_snapshot(std::move(snapshot));
+  // The replayed journal may have painted the current layer already
+  irect rect{.x = 0, .y = 0, .w = size.x, .h = size.y};
+  auto pixels = view.get_curr_texture().edit_pixels<rgba8>(rect);
+  model.anim.get_layer(model.frame_index, model.layer_index)
+      .get_rgba8_pixels(pixels.get_ptr(rect.pos), pixels.get_pitch(), rect);
 }
 
 void presenter::debug_callback() noexcept {
   logger::info("Debug callback UwU");
+
+  auto stats = model.anim.get_memory_stats();
+  logger::debug(
+      "Memory: %lld cels, %lld tiles (%lld bytes), %lld refs, "
+      "%lld bytes saved, %.2fx dedup",
+      stats.cel_count, stats.tile_count, stats.tile_bytes, stats.tile_refs,
+      stats.bytes_saved, stats.dedup_ratio
+  );
+  logger::debug(
+      "History: %d snapshots, %lld / %lld bytes (peak %lld), %lld spilled",
+      caretaker.get_snapshot_count(), caretaker.get_used_bytes(),
+      caretaker.get_budget(), caretaker.get_peak_bytes(),
+      caretaker.get_spilled_bytes()
+  );
 }
 
@@ -28,6 +28,16 @@ using f64 = double;
 
 using c8 = char;
 
+// === Error Types === //
+
+// TODO: Replace to std::expected
+enum class Error : i32 {
+  OK = 0,
+  BAD_ALLOC,
+  // A file could not be opened, written or mapped, errno has the cause
+  IO_ERROR,
+};
+
 // === Color Types === //
 
 template <typename Type> struct rgba {
@@ -42,11 +52,12 @@ template <typename Type> struct rgba {
   };
 
   [[nodiscard]] bool operator==(rgba<Type> rhs) const noexcept {
-    return *(i32*)this == *(i32*)&rhs;
+    return this->r == rhs.r && this->g == rhs.g && this->b == rhs.b &&
+           this->a == rhs.a;
   }
 
   [[nodiscard]] bool operator!=(rgba<Type> rhs) const noexcept {
-    return *(i32*)this != *(i32*)&rhs;
+    return !(*this == rhs);
   }
 };
 
@@ -18,6 +18,8 @@ enum Flag : u32 {
   NONE = 0x0000'0000,
 
   SNAPSHOT = 0x0000'0001,
+  // Paint on more than the current cel
+  SNAPSHOT_CELS = 0x0000'0002,
 };
 
 struct Input {
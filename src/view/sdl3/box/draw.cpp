@@ -74,6 +74,11 @@ void DrawBox::input(const event::Input& evt) noexcept {
 
 void DrawBox::update() noexcept {
   this->tick = (this->tick + 1) % 60;
+
+  // Everything painted since the last frame is uploaded at once
+  for (auto& texture : this->textures) {
+    texture.flush();
+  }
 }
 
 void DrawBox::render(const Renderer& renderer) const noexcept {
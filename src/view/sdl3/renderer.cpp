@@ -78,12 +78,14 @@ Texture Renderer::create_texture(ivec size) const noexcept {
       size.x, size.y
   );
 
+  Texture texture{tex};
   if (tex) {
     // For transparency
     SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+    texture.init_shadow(size);
   }
 
-  return Texture{tex};
+  return texture;
 }
 
 Texture Renderer::create_text(const Font& font, const c8* str) const noexcept {
@@ -6,6 +6,7 @@
  *==========================*/
 
 #include "./texture.hpp"
+#include <algorithm>
 #include <cstring>
 
 namespace view::sdl3 {
@@ -19,8 +20,12 @@ void Texture::set_texture(SDL_Texture* tex) noexcept {
   this->tex = tex;
 }
 
-Texture::Texture(Texture&& rhs) noexcept : tex(rhs.tex) {
+Texture::Texture(Texture&& rhs) noexcept
+    : tex(rhs.tex), shadow(std::move(rhs.shadow)), size(rhs.size),
+      dirty(rhs.dirty) {
   rhs.tex = nullptr;
+  rhs.size = {};
+  rhs.dirty = {};
 }
 
 Texture& Texture::operator=(Texture&& rhs) noexcept {
@@ -29,7 +34,12 @@ Texture& Texture::operator=(Texture&& rhs) noexcept {
   }
 
   this->tex = rhs.tex;
+  this->shadow = std::move(rhs.shadow);
+  this->size = rhs.size;
+  this->dirty = rhs.dirty;
   rhs.tex = nullptr;
+  rhs.size = {};
+  rhs.dirty = {};
 
   return *this;
 }
@@ -41,32 +51,74 @@ Texture::~Texture() noexcept {
   }
 }
 
+void Texture::init_shadow(ivec size) noexcept {
+  this->size = size;
+  this->shadow.assign((i64)size.x * size.y, rgba8{});
+  // The texture itself starts with undefined pixels
+  this->dirty = {0, 0, size.x, size.y};
+}
+
 SDL_Texture* Texture::get_texture() const noexcept {
   return this->tex;
 }
 
 ivec Texture::get_size() const noexcept {
+  if (!this->shadow.empty()) {
+    return this->size;
+  }
+
   ivec size{};
   SDL_QueryTexture(this->tex, nullptr, nullptr, &size.x, &size.y);
   return size;
 }
 
 void Texture::clear(i32 height) noexcept {
-  rgba8* curr_pixels = nullptr;
-  i32 pitch = 0;
-  SDL_LockTexture(this->tex, nullptr, (void**)&curr_pixels, &pitch);
-  // NOLINTNEXTLINE
-  std::memset(curr_pixels, 0, pitch * height);
-  SDL_UnlockTexture(this->tex);
+  height = std::min(height, this->size.y);
+  auto pixels = this->edit_pixels<rgba8>({0, 0, this->size.x, height});
+  std::fill_n(pixels.get_ptr(), (i64)this->size.x * height, rgba8{});
 }
 
 template <> void Texture::set_pixels(rgba8* pixels, ivec size) noexcept {
-  rgba8* curr_pixels = nullptr;
-  i32 pitch = 0;
-  SDL_LockTexture(this->tex, nullptr, (void**)&curr_pixels, &pitch);
+  assert(size.x == this->size.x && size.y == this->size.y);
+  auto dst = this->edit_pixels<rgba8>();
+  std::copy_n(pixels, (i64)size.x * size.y, dst.get_ptr());
+}
+
+irect Texture::get_dirty_rect() const noexcept {
+  return this->dirty;
+}
+
+void Texture::flush() noexcept {
+  if (this->dirty.w <= 0 || this->dirty.h <= 0) {
+    return;
+  }
+
+  SDL_Rect area{this->dirty.x, this->dirty.y, this->dirty.w, this->dirty.h};
   // NOLINTNEXTLINE
-  std::memcpy(curr_pixels, pixels, size.x * size.y * sizeof(rgba8));
-  SDL_UnlockTexture(this->tex);
+  const rgba8* pixels = this->shadow.data() + this->dirty.x +
+                        (i64)this->dirty.y * this->size.x;
+  SDL_UpdateTexture(
+      this->tex, &area, pixels, this->size.x * (i32)sizeof(rgba8)
+  );
+  this->dirty = {};
+}
+
+void Texture::mark_dirty(irect rect) noexcept {
+  if (rect.w <= 0 || rect.h <= 0) {
+    return;
+  }
+
+  if (this->dirty.w <= 0 || this->dirty.h <= 0) {
+    this->dirty = rect;
+    return;
+  }
+
+  i32 right = std::max(this->dirty.x + this->dirty.w, rect.x + rect.w);
+  i32 bottom = std::max(this->dirty.y + this->dirty.h, rect.y + rect.h);
+  this->dirty.x = std::min(this->dirty.x, rect.x);
+  this->dirty.y = std::min(this->dirty.y, rect.y);
+  this->dirty.w = right - this->dirty.x;
+  this->dirty.h = bottom - this->dirty.y;
 }
 
 } // namespace view::sdl3
@@ -11,13 +11,17 @@
 #include "SDL_render.h"
 #include "types.hpp"
 #include <cassert>
+#include <vector>
 
 namespace view::sdl3 {
 
 template <typename Color> class Pixels;
 
 /**
- * Image data for rendering on the screen
+ * Image data for rendering on the screen.
+ * Textures with a shadow keep a copy of their pixels on the cpu, writes only
+ * go to the copy and mark the changed rect. The changed rect is uploaded
+ * with a single update on flush(), once per rendered frame
  **/
 class Texture {
 public:
@@ -31,6 +35,12 @@ public:
 
   void set_texture(SDL_Texture* tex) noexcept;
 
+  /**
+   * Allocates the shadow of the texture, the pixels are transparent until
+   * written to. Needed by the functions writing to the texture
+   **/
+  void init_shadow(ivec size) noexcept;
+
   [[nodiscard]] SDL_Texture* get_texture() const noexcept;
   [[nodiscard]] ivec get_size() const noexcept;
 
@@ -38,78 +48,71 @@ public:
 
   template <typename Color> void set_pixels(Color* pixels, ivec size) noexcept;
 
+  /**
+   * Marks the rect as changed and returns the pixels of the whole texture,
+   * only the pixels in the rect should be written to
+   **/
   template <typename Color>
-  [[nodiscard]] Pixels<Color> lock_texture() noexcept {
-    Color* ptr = nullptr;
-    i32 pitch = 0;
-    SDL_LockTexture(this->tex, nullptr, (void**)&ptr, &pitch);
-    return Pixels<Color>{ptr, this->tex};
+  [[nodiscard]] Pixels<Color> edit_pixels(irect rect) noexcept {
+    assert(!this->shadow.empty());
+    this->mark_dirty(rect);
+    return Pixels<Color>{
+        (Color*)this->shadow.data(), this->size.x * (i32)sizeof(rgba8)};
+  }
+
+  template <typename Color> [[nodiscard]] Pixels<Color> edit_pixels() noexcept {
+    return this->edit_pixels<Color>({0, 0, this->size.x, this->size.y});
   }
 
   template <typename Color> void paint(ivec pos, Color color) noexcept {
     assert(
-        pos.x >= 0 && pos.x < this->get_size().x && pos.y >= 0 &&
-        pos.y < this->get_size().y
+        pos.x >= 0 && pos.x < this->size.x && pos.y >= 0 &&
+        pos.y < this->size.y
     );
-    Color* ptr = nullptr;
-    i32 pitch = 0;
-    SDL_LockTexture(this->tex, nullptr, (void**)&ptr, &pitch);
-    ptr[pos.x + pos.y * this->get_size().x] = color;
-    SDL_UnlockTexture(this->tex);
+    this->edit_pixels<Color>({pos.x, pos.y, 1, 1})
+        .paint(pos.x + pos.y * this->size.x, color);
   }
 
   template <typename Color> void paint(i32 index, Color color) noexcept {
-    assert(index >= 0 && index < this->get_size().x * this->get_size().y);
-    Color* ptr = nullptr;
-    i32 pitch = 0;
-    SDL_LockTexture(this->tex, nullptr, (void**)&ptr, &pitch);
-    ptr[index] = color;
-    SDL_UnlockTexture(this->tex);
+    assert(index >= 0 && index < this->size.x * this->size.y);
+    this->paint({index % this->size.x, index / this->size.x}, color);
   }
 
+  // Rect changed since the last flush(), the size is 0 if nothing changed
+  [[nodiscard]] irect get_dirty_rect() const noexcept;
+
+  // Uploads the changed rect of the shadow to the texture
+  void flush() noexcept;
+
 private:
   SDL_Texture* tex = nullptr;
+  std::vector<rgba8> shadow{};
+  ivec size{};
+  irect dirty{};
+
+  void mark_dirty(irect rect) noexcept;
 };
 
 /**
- * Pixels from textures, will lock the texture until this object is freed
+ * Pixels of a texture to write to, see Texture::edit_pixels()
  **/
 template <typename Color> class Pixels {
 public:
-  explicit Pixels(Color* ptr, SDL_Texture* texture) noexcept
-      : ptr(ptr), texture(texture) {}
-
-  Pixels(const Pixels&) noexcept = delete;
-  Pixels& operator=(const Pixels&) noexcept = delete;
-
-  Pixels(Pixels&& rhs) noexcept : ptr(rhs.ptr), texture(rhs.texture) {
-    rhs.ptr = nullptr;
-    rhs.texture = nullptr;
-  };
+  explicit Pixels(Color* ptr, i32 pitch) noexcept : ptr(ptr), pitch(pitch) {}
 
-  Pixels& operator=(Pixels&& rhs) noexcept {
-    if (this == &rhs) {
-      return *this;
-    }
-
-    this->ptr = rhs.ptr;
-    this->texture = rhs.texture;
-
-    rhs.ptr = nullptr;
-    rhs.texture = nullptr;
-
-    return *this;
+  // Top left of the texture
+  Color* get_ptr() noexcept {
+    return this->ptr;
   }
 
-  ~Pixels() noexcept {
-    if (this->texture) {
-      SDL_UnlockTexture(this->texture);
-      this->texture = nullptr;
-    }
+  Color* get_ptr(ivec pos) noexcept {
+    // NOLINTNEXTLINE
+    return (Color*)((u8*)this->ptr + (i64)pos.y * this->pitch) + pos.x;
   }
 
-  Color* get_ptr() noexcept {
-    return this->ptr;
+  // Bytes between the rows
+  [[nodiscard]] i32 get_pitch() const noexcept {
+    return this->pitch;
   }
 
   void inline paint(i32 index, Color color) noexcept {
@@ -118,7 +121,7 @@ public:
 
 private:
   Color* ptr = nullptr;
-  SDL_Texture* texture = nullptr;
+  i32 pitch = 0;
 };
 
 } // namespace view::sdl3
@@ -0,0 +1,201 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "core/draw/anim.hpp"
+#include "core/draw/types.hpp"
+#include "types.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Benchmarks of the structural operations of draw::Anim.
+ * Results are written as JSON to stdout or to the file in the first arg
+ *
+ * Usage: pixel_bench [output.json]
+ **/
+
+using namespace draw;
+using Clock = std::chrono::steady_clock;
+
+const i32 CANVAS_SIZES[] = {16, 64, 256, 1024, 4096};
+const i32 FRAME_COUNTS[] = {1, 10, 100, 1000};
+
+// Each benchmark runs until either limit is reached
+const i64 MAX_ITERATIONS = 1000;
+const i64 MAX_TIME_NS = 50'000'000;
+const i64 MIN_ITERATIONS = 3;
+
+struct Result {
+  const c8* name = nullptr;
+  ivec size{};
+  i32 frames = 0;
+  i64 iterations = 0;
+  f64 mean_ns = 0.0;
+  i64 min_ns = 0;
+  i64 max_ns = 0;
+};
+
+/**
+ * Only the time spent in op is measured, reset is called after each op to
+ * bring the animation back to its original state
+ **/
+template <typename Op, typename Reset>
+Result run(const c8* name, Anim& anim, i32 frames, Op op, Reset reset) {
+  Result result{.name = name, .size = anim.get_size(), .frames = frames};
+  result.min_ns = 0x7fff'ffff'ffff'ffffLL;
+
+  i64 total_ns = 0;
+  while (result.iterations < MAX_ITERATIONS &&
+         (total_ns < MAX_TIME_NS || result.iterations < MIN_ITERATIONS)) {
+    auto start = Clock::now();
+    op();
+    auto end = Clock::now();
+    reset();
+
+    i64 ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count();
+    total_ns += ns;
+    result.min_ns = std::min(result.min_ns, ns);
+    result.max_ns = std::max(result.max_ns, ns);
+    ++result.iterations;
+  }
+
+  result.mean_ns = (f64)total_ns / (f64)result.iterations;
+  return result;
+}
+
+// Animation with a painted pixel on each frame so every slot has a cel
+void setup_anim(Anim& anim, ivec size, i32 frames) noexcept {
+  anim.init(size, RGBA8);
+  anim.insert_frames(1, frames - 1);
+  for (i32 f = 0; f < frames; ++f) {
+    anim.get_layer(f, 0).paint({f % size.x, f / size.x % size.y}, {1, 2, 3, 4});
+  }
+}
+
+void bench_anim(std::vector<Result>& results, ivec size, i32 frames) {
+  Anim anim{};
+  setup_anim(anim, size, frames);
+
+  results.push_back(run(
+      "init", anim, frames,
+      [&]() {
+        Anim other{};
+        static_cast<void>(other.init(size, RGBA8));
+      },
+      []() {}
+  ));
+
+  results.push_back(run(
+      "insert_frames", anim, frames,
+      [&]() { static_cast<void>(anim.insert_frames(0, 1)); },
+      [&]() { anim.remove_frames(0, 1); }
+  ));
+
+  results.push_back(run(
+      "insert_layers", anim, frames,
+      [&]() { static_cast<void>(anim.insert_layers(0, 1)); },
+      [&]() { anim.remove_layers(0, 1); }
+  ));
+
+  // Inserting past the capacity goes through resize_layer()
+  results.push_back(run(
+      "resize_layer", anim, frames,
+      [&]() {
+        static_cast<void>(anim.insert_layers(0, anim.get_layer_capacity()));
+      },
+      [&]() { anim.remove_layers(0, anim.get_layer_count() - 1); }
+  ));
+
+  Anim copy{};
+  results.push_back(run(
+      "copy", anim, frames,
+      [&]() { static_cast<void>(copy.copy(anim)); }, [&]() { copy.clear(); }
+  ));
+
+  u64 sink = 0U;
+  results.push_back(run(
+      "get_layer", anim, frames,
+      [&]() {
+        for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+          sink += (u64)anim.get_layer(f, 0).get_pixel(0LL)[0];
+        }
+      },
+      []() {}
+  ));
+
+  // A row across the canvas, per pixel and as a span like the brushes
+  auto layer = anim.get_layer(0, 0);
+  results.push_back(run(
+      "paint_row", anim, frames,
+      [&]() {
+        for (i32 x = 0; x < size.x; ++x) {
+          static_cast<void>(layer.paint(ivec{x, size.y / 2}, {1, 2, 3, 4}));
+        }
+      },
+      []() {}
+  ));
+
+  results.push_back(run(
+      "set_span", anim, frames,
+      [&]() {
+        static_cast<void>(
+            layer.set_span<rgba8>({0, size.y / 2}, size.x, {1, 2, 3, 4})
+        );
+      },
+      []() {}
+  ));
+
+  if (sink == 0xffff'ffff'ffff'ffffULL) {
+    std::printf("%llu\n", sink);
+  }
+}
+
+void write_json(std::FILE* file, const std::vector<Result>& results) {
+  std::fprintf(file, "{\n  \"benchmarks\": [\n");
+  for (i32 i = 0; i < (i32)results.size(); ++i) {
+    const auto& result = results[i];
+    std::fprintf(
+        file,
+        "    {\"name\": \"%s\", \"width\": %d, \"height\": %d, "
+        "\"frames\": %d, \"iterations\": %lld, \"mean_ns\": %.1f, "
+        "\"min_ns\": %lld, \"max_ns\": %lld}%s\n",
+        result.name, result.size.x, result.size.y, result.frames,
+        result.iterations, result.mean_ns, result.min_ns, result.max_ns,
+        i + 1 < (i32)results.size() ? "," : ""
+    );
+  }
+  std::fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+  std::vector<Result> results{};
+  for (i32 canvas_size : CANVAS_SIZES) {
+    for (i32 frames : FRAME_COUNTS) {
+      bench_anim(results, {canvas_size, canvas_size}, frames);
+    }
+  }
+
+  std::FILE* file = stdout;
+  if (argc > 1) {
+    // NOLINTNEXTLINE
+    file = std::fopen(argv[1], "w");
+    if (file == nullptr) {
+      std::fprintf(stderr, "Could not open %s\n", argv[1]);
+      return 1;
+    }
+  }
+
+  write_json(file, results);
+  if (file != stdout) {
+    std::fclose(file);
+  }
+  return 0;
+}
@@ -7,15 +7,26 @@
 
 #include "catch2/catch_test_macros.hpp"
 #include "core/draw/anim.hpp"
+#include "core/draw/cel.hpp"
+#include "core/draw/pool.hpp"
 #include "core/draw/types.hpp"
 #include "types.hpp"
+#include <cerrno>
 #include <cstring>
+#include <vector>
 
 const ivec size{2, 2};
 const i32 isize = size.x * size.y;
 
 using namespace draw;
 
+// Compares the flattened pixels of the layer
+i32 cmp_layer(Layer layer, const void* expected, i32 bytes) noexcept {
+  std::vector<u8> pixels(layer.get_width() * layer.get_height() * 8);
+  layer.get_pixels(pixels.data());
+  return std::memcmp(pixels.data(), expected, bytes);
+}
+
 void test_init_anim(const Anim& anim) noexcept {
   REQUIRE(anim.get_size().x == size.x);
   REQUIRE(anim.get_size().y == size.y);
@@ -36,8 +47,7 @@ TEST_CASE("Anim: init", "[draw]") {
     REQUIRE(layer.get_size().y == size.y);
 
     u32 expected_ptr[] = {0U, 0U, 0U, 0U}; // All zeroes
-    auto* ptr = layer.get_ptr();
-    REQUIRE(std::memcmp(ptr, expected_ptr, isize * sizeof(rgba8)) == 0);
+    REQUIRE(cmp_layer(layer, expected_ptr, isize * sizeof(rgba8)) == 0);
   }
 
   SECTION("rgba16") {
@@ -50,8 +60,7 @@ TEST_CASE("Anim: init", "[draw]") {
     REQUIRE(layer.get_size().y == size.y);
 
     u64 expected_ptr[] = {0U, 0U, 0U, 0U}; // All zeroes
-    auto* ptr = layer.get_ptr();
-    REQUIRE(std::memcmp(ptr, expected_ptr, isize * sizeof(rgba16)) == 0);
+    REQUIRE(cmp_layer(layer, expected_ptr, isize * sizeof(rgba16)) == 0);
   }
 }
 
@@ -75,14 +84,10 @@ TEST_CASE("Anim: Layer Resizeable", "[draw]") {
 
   REQUIRE(anim.get_layer_count() == 2);
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 0).get_ptr(), expected_ptr1, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 0), expected_ptr1, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 1).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 1), expected_ptr0, isize * sizeof(rgba8)) == 0
   );
 
   // Color the new inserted frame
@@ -95,19 +100,13 @@ TEST_CASE("Anim: Layer Resizeable", "[draw]") {
   anim.insert_layer(0);
   REQUIRE(anim.get_layer_count() == 3);
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 0).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 0), expected_ptr0, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 1).get_ptr(), expected_ptr1, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 1), expected_ptr1, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 2).get_ptr(), expected_ptr2, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 2), expected_ptr2, isize * sizeof(rgba8)) == 0
   );
 
   // Try to resize the container and check if resize is correct
@@ -116,20 +115,21 @@ TEST_CASE("Anim: Layer Resizeable", "[draw]") {
   REQUIRE(anim.get_layer_count() == org_layer_capacity + 3);
   for (i32 i = 0; i <= org_layer_capacity; ++i) {
     REQUIRE(
-        std::memcmp(
-            anim.get_layer(0, i).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
+        cmp_layer(
+            anim.get_layer(0, i), expected_ptr0,
+            isize * sizeof(rgba8)
         ) == 0
     );
   }
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, org_layer_capacity + 1).get_ptr(), expected_ptr1,
+      cmp_layer(
+          anim.get_layer(0, org_layer_capacity + 1), expected_ptr1,
           isize * sizeof(rgba8)
       ) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, org_layer_capacity + 2).get_ptr(), expected_ptr2,
+      cmp_layer(
+          anim.get_layer(0, org_layer_capacity + 2), expected_ptr2,
           isize * sizeof(rgba8)
       ) == 0
   );
@@ -157,14 +157,10 @@ TEST_CASE("Anim: Frame Resizeable", "[draw]") {
 
   REQUIRE(anim.get_frame_count() == 2);
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 0).get_ptr(), expected_ptr1, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 0), expected_ptr1, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(1, 0).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(1, 0), expected_ptr0, isize * sizeof(rgba8)) == 0
   );
 
   // Color the new inserted frame
@@ -177,19 +173,13 @@ TEST_CASE("Anim: Frame Resizeable", "[draw]") {
   anim.insert_frame(0);
   REQUIRE(anim.get_frame_count() == 3);
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(0, 0).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(0, 0), expected_ptr0, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(1, 0).get_ptr(), expected_ptr1, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(1, 0), expected_ptr1, isize * sizeof(rgba8)) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(2, 0).get_ptr(), expected_ptr2, isize * sizeof(rgba8)
-      ) == 0
+      cmp_layer(anim.get_layer(2, 0), expected_ptr2, isize * sizeof(rgba8)) == 0
   );
 
   // Try to resize the container and check if resize is correct
@@ -198,20 +188,21 @@ TEST_CASE("Anim: Frame Resizeable", "[draw]") {
   REQUIRE(anim.get_frame_count() == org_layer_capacity + 3);
   for (i32 i = 0; i <= org_layer_capacity; ++i) {
     REQUIRE(
-        std::memcmp(
-            anim.get_layer(i, 0).get_ptr(), expected_ptr0, isize * sizeof(rgba8)
+        cmp_layer(
+            anim.get_layer(i, 0), expected_ptr0,
+            isize * sizeof(rgba8)
         ) == 0
     );
   }
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(org_layer_capacity + 1, 0).get_ptr(), expected_ptr1,
+      cmp_layer(
+          anim.get_layer(org_layer_capacity + 1, 0), expected_ptr1,
           isize * sizeof(rgba8)
       ) == 0
   );
   REQUIRE(
-      std::memcmp(
-          anim.get_layer(org_layer_capacity + 2, 0).get_ptr(), expected_ptr2,
+      cmp_layer(
+          anim.get_layer(org_layer_capacity + 2, 0), expected_ptr2,
           isize * sizeof(rgba8)
       ) == 0
   );
@@ -219,3 +210,683 @@ TEST_CASE("Anim: Frame Resizeable", "[draw]") {
   REQUIRE(anim.get_layer_count() == 1);
 }
 
+
+TEST_CASE("Cel: sparse tiles", "[draw]") {
+  const ivec cel_size{TILE_SIZE * 2 + 5, TILE_SIZE + 3};
+  Cel cel{};
+  cel.init(cel_size, ColorType::RGBA8);
+
+  // Untouched cels should not hold any pixels
+  REQUIRE(cel.get_tile_count() == 0);
+  REQUIRE(*(const u32*)cel.get_pixel({cel_size.x - 1, cel_size.y - 1}) == 0U);
+
+  rgba8 color{0x11U, 0x22U, 0x33U, 0x44U};
+  Cel* slot = &cel;
+  Layer layer{&slot, cel_size, ColorType::RGBA8};
+  layer.paint({TILE_SIZE - 1, 0}, color);
+  layer.paint({TILE_SIZE, 0}, color);
+  layer.paint({cel_size.x - 1, cel_size.y - 1}, color);
+  REQUIRE(cel.get_tile_count() == 3);
+
+  REQUIRE(*(const rgba8*)layer.get_pixel({TILE_SIZE - 1, 0}) == color);
+  REQUIRE(*(const rgba8*)layer.get_pixel(TILE_SIZE) == color);
+  REQUIRE(*(const rgba8*)layer.get_pixel({0, TILE_SIZE}) != color);
+
+  std::vector<rgba8> pixels(cel_size.x * cel_size.y);
+  layer.get_pixels((data_ptr)pixels.data());
+  for (i32 i = 0; i < cel_size.x * cel_size.y; ++i) {
+    bool painted = i == TILE_SIZE - 1 || i == TILE_SIZE ||
+                   i == cel_size.x * cel_size.y - 1;
+    REQUIRE((pixels[i] == color) == painted);
+  }
+
+  Cel other{};
+  other.copy(cel);
+  REQUIRE(other.get_tile_count() == 3);
+  REQUIRE(*(const rgba8*)other.get_pixel({TILE_SIZE, 0}) == color);
+}
+
+TEST_CASE("Anim: Insert with multiple frames and layers", "[draw]") {
+  Anim anim{};
+  anim.init(size, ColorType::RGBA8);
+  anim.insert_frames(1, 2);
+  anim.insert_layers(1, 1);
+
+  // Mark each cel with its own color
+  for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      anim.get_layer(f, l).paint(0, rgba8{(u8)f, (u8)l, 0xffU, 0xffU});
+    }
+  }
+
+  // Forces both the frame and the layer slots to be resized
+  auto org_frame_capacity = anim.get_frame_capacity();
+  auto org_layer_capacity = anim.get_layer_capacity();
+  anim.insert_layers(1, org_layer_capacity);
+  anim.insert_frames(0, org_frame_capacity);
+  REQUIRE(anim.get_layer_count() == org_layer_capacity + 2);
+  REQUIRE(anim.get_frame_count() == org_frame_capacity + 3);
+
+  for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      auto pixel = *(const rgba8*)anim.get_layer(f, l).get_pixel(0);
+      if (f < org_frame_capacity || (l > 0 && l <= org_layer_capacity)) {
+        REQUIRE(pixel == color::TRANSPARENT_COLOR);
+        continue;
+      }
+
+      auto org_frame = (u8)(f - org_frame_capacity);
+      auto org_layer = (u8)(l == 0 ? 0 : l - org_layer_capacity);
+      REQUIRE(pixel == rgba8{org_frame, org_layer, 0xffU, 0xffU});
+    }
+  }
+}
+
+TEST_CASE("Anim: Copy on write", "[draw]") {
+  Anim anim{};
+  anim.init(size, ColorType::RGBA8);
+
+  rgba8 color1{0x11U, 0x11U, 0x11U, 0x11U};
+  rgba8 color2{0x22U, 0x22U, 0x22U, 0x22U};
+  u32 expected_ptr0[] = {0U, 0U, 0U, 0U};
+  u32 expected_ptr1[] = {0x11111111U, 0x11111111U, 0x11111111U, 0x11111111U};
+  u32 expected_ptr2[] = {0x22222222U, 0x22222222U, 0x11111111U, 0x11111111U};
+
+  auto layer = anim.get_layer(0, 0);
+  for (i32 i = 0; i < isize; ++i) {
+    layer.paint(i, color1);
+  }
+
+  SECTION("duplicate frame") {
+    anim.duplicate_frame(0);
+    REQUIRE(anim.get_frame_count() == 2);
+    REQUIRE(
+        cmp_layer(
+            anim.get_layer(1, 0), expected_ptr1,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+
+    // Painting the duplicate should not affect the original
+    layer = anim.get_layer(1, 0);
+    layer.paint(0, color2);
+    layer.paint(1, color2);
+    REQUIRE(
+        cmp_layer(
+            anim.get_layer(0, 0), expected_ptr1,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+    REQUIRE(
+        cmp_layer(
+            anim.get_layer(1, 0), expected_ptr2,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+  }
+
+  SECTION("copy") {
+    Anim other{};
+    other.copy(anim);
+
+    layer = anim.get_layer(0, 0);
+    layer.paint(0, color2);
+    layer.paint(1, color2);
+    REQUIRE(
+        cmp_layer(
+            other.get_layer(0, 0), expected_ptr1,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+    REQUIRE(
+        cmp_layer(
+            anim.get_layer(0, 0), expected_ptr2,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+
+    // Structural changes are not shared
+    anim.insert_layer(1);
+    REQUIRE(
+        cmp_layer(
+            anim.get_layer(0, 1), expected_ptr0,
+            isize * sizeof(rgba8)
+        ) == 0
+    );
+    REQUIRE(other.get_layer_count() == 1);
+  }
+}
+
+// Marks the first pixel of each cel with its frame and layer index
+void mark_cels(Anim& anim) noexcept {
+  for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      anim.get_layer(f, l).paint(0, rgba8{(u8)f, (u8)l, 0xffU, 0xffU});
+    }
+  }
+}
+
+rgba8 get_mark(Anim& anim, i32 frame, i32 layer) noexcept {
+  return *(const rgba8*)anim.get_layer(frame, layer).get_pixel(0);
+}
+
+TEST_CASE("Anim: Remove, move and duplicate", "[draw]") {
+  Anim anim{};
+  anim.init(size, ColorType::RGBA8);
+  anim.insert_frames(1, 4);
+  anim.insert_layers(1, 2);
+  mark_cels(anim);
+
+  SECTION("remove frames") {
+    anim.remove_frames(1, 2);
+    REQUIRE(anim.get_frame_count() == 3);
+    REQUIRE(get_mark(anim, 0, 1) == rgba8{0U, 1U, 0xffU, 0xffU});
+    REQUIRE(get_mark(anim, 1, 2) == rgba8{3U, 2U, 0xffU, 0xffU});
+    REQUIRE(get_mark(anim, 2, 0) == rgba8{4U, 0U, 0xffU, 0xffU});
+
+    // Slots that were freed should be empty once reused
+    anim.insert_frame(3);
+    REQUIRE(get_mark(anim, 3, 0) == color::TRANSPARENT_COLOR);
+  }
+
+  SECTION("remove layers") {
+    anim.remove_layer(0);
+    REQUIRE(anim.get_layer_count() == 2);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      REQUIRE(get_mark(anim, f, 0) == rgba8{(u8)f, 1U, 0xffU, 0xffU});
+      REQUIRE(get_mark(anim, f, 1) == rgba8{(u8)f, 2U, 0xffU, 0xffU});
+    }
+
+    anim.insert_layer(2);
+    REQUIRE(get_mark(anim, 4, 2) == color::TRANSPARENT_COLOR);
+  }
+
+  SECTION("move frame") {
+    anim.move_frame(0, 3);
+    REQUIRE(get_mark(anim, 0, 0) == rgba8{1U, 0U, 0xffU, 0xffU});
+    REQUIRE(get_mark(anim, 2, 1) == rgba8{3U, 1U, 0xffU, 0xffU});
+    REQUIRE(get_mark(anim, 3, 2) == rgba8{0U, 2U, 0xffU, 0xffU});
+    REQUIRE(get_mark(anim, 4, 0) == rgba8{4U, 0U, 0xffU, 0xffU});
+
+    anim.move_frame(3, 0);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      REQUIRE(get_mark(anim, f, 0) == rgba8{(u8)f, 0U, 0xffU, 0xffU});
+    }
+  }
+
+  SECTION("move layer") {
+    anim.move_layer(2, 0);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      REQUIRE(get_mark(anim, f, 0) == rgba8{(u8)f, 2U, 0xffU, 0xffU});
+      REQUIRE(get_mark(anim, f, 1) == rgba8{(u8)f, 0U, 0xffU, 0xffU});
+      REQUIRE(get_mark(anim, f, 2) == rgba8{(u8)f, 1U, 0xffU, 0xffU});
+    }
+  }
+
+  SECTION("duplicate layer") {
+    anim.duplicate_layer(1);
+    REQUIRE(anim.get_layer_count() == 4);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      REQUIRE(get_mark(anim, f, 2) == rgba8{(u8)f, 1U, 0xffU, 0xffU});
+      REQUIRE(get_mark(anim, f, 3) == rgba8{(u8)f, 2U, 0xffU, 0xffU});
+    }
+
+    anim.get_layer(0, 2).paint(0, color::TRANSPARENT_COLOR);
+    REQUIRE(get_mark(anim, 0, 1) == rgba8{0U, 1U, 0xffU, 0xffU});
+  }
+
+  SECTION("restore cels") {
+    // Removed cels are kept alive by another reference
+    Cel* cel = anim.get_cel(1, 2);
+    cel->acquire();
+    anim.remove_frame(1);
+    REQUIRE(cel->get_refs() == 1);
+
+    anim.insert_frame(1);
+    REQUIRE(anim.get_cel(1, 2) == nullptr);
+    anim.set_cel(1, 2, cel);
+    release_cel(cel);
+    REQUIRE(cel->get_refs() == 1);
+    REQUIRE(get_mark(anim, 1, 2) == rgba8{1U, 2U, 0xffU, 0xffU});
+
+    anim.set_cel(1, 2, nullptr);
+    REQUIRE(get_mark(anim, 1, 2) == color::TRANSPARENT_COLOR);
+  }
+
+  SECTION("shrink") {
+    anim.insert_frames(0, 30);
+    anim.insert_layers(0, 30);
+    REQUIRE(anim.get_frame_capacity() >= 35);
+    REQUIRE(anim.get_layer_capacity() >= 33);
+
+    anim.remove_frames(0, 30);
+    anim.remove_layers(0, 30);
+    REQUIRE(anim.get_frame_capacity() < 35);
+    REQUIRE(anim.get_layer_capacity() < 33);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+        REQUIRE(get_mark(anim, f, l) == rgba8{(u8)f, (u8)l, 0xffU, 0xffU});
+      }
+    }
+  }
+}
+
+TEST_CASE("Cel: content bounds", "[draw]") {
+  ivec cel_size{100, 70};
+  Anim anim{};
+  anim.init(cel_size, RGBA8);
+  auto layer = anim.get_layer(0, 0);
+  REQUIRE(layer.is_empty());
+
+  rgba8 color{1U, 2U, 3U, 0xffU};
+  layer.paint({40, 10}, color);
+  REQUIRE(!layer.is_empty());
+  REQUIRE(layer.get_bounds().x == 40);
+  REQUIRE(layer.get_bounds().y == 10);
+  REQUIRE(layer.get_bounds().w == 1);
+  REQUIRE(layer.get_bounds().h == 1);
+
+  layer.paint({5, 60}, color);
+  layer.paint({90, 30}, color);
+  irect bounds = layer.get_bounds();
+  REQUIRE(bounds.x == 5);
+  REQUIRE(bounds.y == 10);
+  REQUIRE(bounds.w == 86);
+  REQUIRE(bounds.h == 51);
+
+  SECTION("erase") {
+    layer.paint({5, 60}, color::TRANSPARENT_COLOR);
+    bounds = layer.get_bounds();
+    REQUIRE(bounds.x == 40);
+    REQUIRE(bounds.y == 10);
+    REQUIRE(bounds.w == 51);
+    REQUIRE(bounds.h == 21);
+
+    layer.paint({40, 10}, color::TRANSPARENT_COLOR);
+    layer.paint({90, 30}, color::TRANSPARENT_COLOR);
+    REQUIRE(layer.is_empty());
+
+    // Snapshots drop empty cels
+    Anim copy{};
+    copy.copy(anim);
+    REQUIRE(copy.get_layer(0, 0).is_empty());
+    REQUIRE(cmp_layer(copy.get_layer(0, 0), ZERO_TILE, cel_size.x * 4) == 0);
+  }
+
+  SECTION("flatten") {
+    std::vector<u8> pixels(cel_size.x * cel_size.y * 4);
+    layer.get_pixels(pixels.data());
+    REQUIRE(*(rgba8*)&pixels[(40 + 10 * cel_size.x) * 4] == color);
+    REQUIRE(*(rgba8*)&pixels[(5 + 60 * cel_size.x) * 4] == color);
+    REQUIRE(*(rgba8*)&pixels[(90 + 30 * cel_size.x) * 4] == color);
+    REQUIRE(*(rgba8*)&pixels[0] == color::TRANSPARENT_COLOR);
+  }
+}
+
+TEST_CASE("Layer: RGBA16", "[draw]") {
+  ivec cel_size{40, 35};
+  Anim anim{};
+  anim.init(cel_size, RGBA16);
+  auto layer = anim.get_layer(0, 0);
+
+  // Compares all the channels
+  REQUIRE(rgba16{1U, 2U, 3U, 4U} != rgba16{1U, 2U, 3U, 5U});
+
+  layer.paint({1, 2}, rgba8{0x12U, 0x34U, 0x56U, 0xffU});
+  REQUIRE(
+      layer.get_color<rgba16>(ivec{1, 2}) ==
+      rgba16{0x1212U, 0x3434U, 0x5656U, 0xffffU}
+  );
+
+  layer.set_color({39, 34}, rgba16{0xabcdU, 0x0102U, 0xff00U, 0x8000U});
+  REQUIRE(
+      layer.get_color<rgba16>((i64)39 + 34 * cel_size.x) ==
+      rgba16{0xabcdU, 0x0102U, 0xff00U, 0x8000U}
+  );
+  REQUIRE(layer.get_bounds().w == 39);
+  REQUIRE(layer.get_bounds().h == 33);
+
+  std::vector<rgba8> pixels(cel_size.x * cel_size.y);
+  layer.get_rgba8_pixels(pixels.data());
+  REQUIRE(pixels[1 + 2 * cel_size.x] == rgba8{0x12U, 0x34U, 0x56U, 0xffU});
+  REQUIRE(pixels[39 + 34 * cel_size.x] == rgba8{0xabU, 0x01U, 0xffU, 0x80U});
+  REQUIRE(pixels[0] == color::TRANSPARENT_COLOR);
+
+  SECTION("kernel") {
+    std::vector<rgba16> src{};
+    for (i32 i = 0; i < 7; ++i) {
+      src.push_back(
+          {(u16)(i << 8), (u16)((i << 8) | 0xff), 0xffffU, (u16)(0x80ff - i)}
+      );
+    }
+    std::vector<rgba8> dst(src.size());
+    to_rgba8(src.data(), dst.data(), (i64)src.size());
+    for (i32 i = 0; i < 7; ++i) {
+      REQUIRE(dst[i] == rgba8{(u8)i, (u8)i, 0xffU, 0x80U});
+    }
+  }
+}
+
+TEST_CASE("Layer: INDEXED8", "[draw]") {
+  ivec cel_size{40, 35};
+  Anim anim{};
+  anim.init(cel_size, INDEXED8);
+  REQUIRE(anim.get_palette() != nullptr);
+  auto layer = anim.get_layer(0, 0);
+
+  rgba8 red{0xffU, 0x00U, 0x00U, 0xffU};
+  rgba8 blue{0x00U, 0x00U, 0xffU, 0xffU};
+  layer.paint({1, 2}, red);
+  layer.paint({3, 4}, blue);
+  layer.paint({5, 6}, red);
+  REQUIRE(anim.get_palette()->get_count() == 3);
+  REQUIRE(layer.get_color<u8>(ivec{1, 2}) == 1U);
+  REQUIRE(layer.get_color<u8>(ivec{3, 4}) == 2U);
+  REQUIRE(layer.get_color<u8>(ivec{5, 6}) == 1U);
+
+  // Pixels are expanded through the palette
+  std::vector<rgba8> pixels(cel_size.x * cel_size.y);
+  layer.get_rgba8_pixels(pixels.data());
+  REQUIRE(pixels[1 + 2 * cel_size.x] == red);
+  REQUIRE(pixels[3 + 4 * cel_size.x] == blue);
+  REQUIRE(pixels[0] == color::TRANSPARENT_COLOR);
+
+  SECTION("recolor") {
+    Anim copy{};
+    copy.copy(anim);
+
+    rgba8 green{0x00U, 0xffU, 0x00U, 0xffU};
+    anim.get_palette()->set_color(1U, green);
+    layer.get_rgba8_pixels(pixels.data());
+    REQUIRE(pixels[1 + 2 * cel_size.x] == green);
+    REQUIRE(pixels[5 + 6 * cel_size.x] == green);
+
+    // Snapshots keep their own palette
+    copy.get_layer(0, 0).get_rgba8_pixels(pixels.data());
+    REQUIRE(pixels[1 + 2 * cel_size.x] == red);
+  }
+
+  SECTION("erase") {
+    layer.paint({1, 2}, color::TRANSPARENT_COLOR);
+    layer.paint({3, 4}, color::TRANSPARENT_COLOR);
+    REQUIRE(!layer.is_empty());
+    layer.paint({5, 6}, color::TRANSPARENT_COLOR);
+    REQUIRE(layer.is_empty());
+  }
+
+  SECTION("full palette") {
+    for (i32 i = 3; i < PALETTE_SIZE; ++i) {
+      layer.paint(i, rgba8{(u8)i, (u8)i, (u8)i, 0xffU});
+    }
+    REQUIRE(anim.get_palette()->get_count() == PALETTE_SIZE);
+
+    // Uses the nearest color
+    layer.paint({0, 0}, rgba8{0xfeU, 0x01U, 0x00U, 0xffU});
+    REQUIRE(layer.get_color<u8>(ivec{0, 0}) == 1U);
+  }
+}
+
+TEST_CASE("Anim: Tile dedup", "[draw]") {
+  ivec cel_size{64, 64};
+  Anim anim{};
+  anim.init(cel_size, RGBA8);
+  anim.insert_frames(1, 3);
+
+  // Same background on every frame, only frame 3 differs at the corner
+  rgba8 color{1U, 2U, 3U, 0xffU};
+  for (i32 f = 0; f < 4; ++f) {
+    auto layer = anim.get_layer(f, 0);
+    for (i32 i = 0; i < TILE_SIZE; ++i) {
+      layer.paint({i, i}, color);
+      layer.paint({i + TILE_SIZE, TILE_MASK - i}, color);
+    }
+  }
+  anim.get_layer(3, 0).paint({63, 63}, color);
+  anim.get_layer(3, 0).paint({63, 63}, color::TRANSPARENT_COLOR);
+  anim.get_layer(2, 0).paint({0, 63}, color);
+
+  auto stats = anim.get_memory_stats();
+  REQUIRE(stats.cel_count == 4);
+  REQUIRE(stats.tile_count == 10);
+  REQUIRE(stats.bytes_saved == 0);
+
+  anim.dedup_tiles();
+  stats = anim.get_memory_stats();
+  // Zeroed tile is released, the rest share 3 unique tiles
+  REQUIRE(stats.tile_refs == 9);
+  REQUIRE(stats.tile_count == 3);
+  REQUIRE(stats.bytes_saved == 6 * TILE_SIZE * TILE_SIZE * 4);
+  REQUIRE(stats.dedup_ratio == 3.0);
+
+  // Writing diverges from the shared tile
+  anim.get_layer(1, 0).paint({1, 0}, color);
+  REQUIRE(*(rgba8*)anim.get_layer(1, 0).get_pixel({1, 0}) == color);
+  for (i32 f = 0; f < 4; ++f) {
+    auto layer = anim.get_layer(f, 0);
+    REQUIRE(*(rgba8*)layer.get_pixel({5, 5}) == color);
+    REQUIRE(*(rgba8*)layer.get_pixel({37, 26}) == color);
+    if (f != 1) {
+      REQUIRE(*(rgba8*)layer.get_pixel({1, 0}) == color::TRANSPARENT_COLOR);
+    }
+  }
+  REQUIRE(anim.get_memory_stats().tile_count == 4);
+
+  // Reverting the write shares it again
+  anim.get_layer(1, 0).paint({1, 0}, color::TRANSPARENT_COLOR);
+  anim.dedup_tiles();
+  REQUIRE(anim.get_memory_stats().tile_count == 3);
+
+  // Tiles only held by the table are freed right away
+  anim.remove_frames(0, 3);
+  stats = anim.get_memory_stats();
+  REQUIRE(stats.tile_count == 2);
+  REQUIRE(get_tile_store().get_tile_count() == 2);
+  anim.dedup_tiles();
+  stats = anim.get_memory_stats();
+  REQUIRE(stats.tile_count == 2);
+  REQUIRE(stats.dedup_ratio == 1.0);
+}
+
+TEST_CASE("Layer: Restore tiles", "[draw]") {
+  Anim anim{};
+  anim.init({48, 48}, RGBA8);
+  anim.insert_frames(1, 1);
+  rgba8 color{1U, 2U, 3U, 0xffU};
+
+  auto before = anim.get_layer(0, 0);
+  auto after = anim.get_layer(1, 0);
+  REQUIRE(before.get_cel() == nullptr);
+  after.paint({40, 40}, color);
+  REQUIRE(after.get_cel()->get_tiles_size().x == 2);
+  REQUIRE(after.get_cel()->get_tiles_size().y == 2);
+
+  // Tile is shared between both cels
+  Tile* tile = after.get_cel()->get_tile(3);
+  REQUIRE(tile != nullptr);
+  REQUIRE(after.get_cel()->get_tile(0) == nullptr);
+  REQUIRE(before.set_tile(3, tile) == Error::OK);
+  REQUIRE(tile->refs == 2);
+  REQUIRE(*(rgba8*)before.get_pixel({40, 40}) == color);
+  irect bounds = before.get_bounds();
+  REQUIRE(bounds.x == 40);
+  REQUIRE(bounds.y == 40);
+  REQUIRE(bounds.w == 1);
+  REQUIRE(bounds.h == 1);
+
+  // Writing to a restored tile does not change the other cel
+  before.paint({41, 40}, color);
+  REQUIRE(tile->refs == 1);
+  REQUIRE(*(rgba8*)after.get_pixel({41, 40}) == color::TRANSPARENT_COLOR);
+
+  REQUIRE(before.set_tile(3, nullptr) == Error::OK);
+  REQUIRE(before.get_cel()->get_tile_count() == 0);
+  REQUIRE(before.is_empty());
+}
+
+TEST_CASE("Layer: Read a rect", "[draw]") {
+  ivec cel_size{70, 50};
+  Anim anim{};
+  anim.init(cel_size, RGBA8);
+  auto layer = anim.get_layer(0, 0);
+  for (i32 i = 0; i < cel_size.x; ++i) {
+    layer.paint({i, i % cel_size.y}, rgba8{(u8)i, 1U, 2U, 0xffU});
+  }
+
+  std::vector<rgba8> full(cel_size.x * cel_size.y);
+  layer.get_rgba8_pixels(full.data());
+
+  // Crosses the tiles and has a wider row than the rect
+  irect rect{30, 20, 36, 25};
+  i32 stride = 40;
+  std::vector<rgba8> pixels(stride * rect.h, rgba8{9U, 9U, 9U, 9U});
+  layer.get_rgba8_pixels(pixels.data(), stride * (i64)sizeof(rgba8), rect);
+  for (i32 y = 0; y < rect.h; ++y) {
+    for (i32 x = 0; x < rect.w; ++x) {
+      REQUIRE(
+          pixels[x + y * stride] ==
+          full[rect.x + x + (rect.y + y) * cel_size.x]
+      );
+    }
+    REQUIRE(pixels[rect.w + y * stride] == rgba8{9U, 9U, 9U, 9U});
+  }
+
+  // Empty cels are transparent
+  anim.insert_frames(1, 1);
+  auto empty = anim.get_layer(1, 0);
+  empty.get_rgba8_pixels(pixels.data(), stride * (i64)sizeof(rgba8), rect);
+  REQUIRE(pixels[0] == color::TRANSPARENT_COLOR);
+  REQUIRE(pixels[rect.w + stride] == rgba8{9U, 9U, 9U, 9U});
+}
+
+TEST_CASE("Layer: Paint a span", "[draw]") {
+  ivec cel_size{100, 70};
+  Anim anim{};
+  anim.init(cel_size, RGBA8);
+  auto layer = anim.get_layer(0, 0);
+
+  // Crosses three tiles
+  rgba8 color{1U, 2U, 3U, 0xffU};
+  REQUIRE(layer.set_span<rgba8>({20, 40}, 60, color) == Error::OK);
+  REQUIRE(layer.get_color<rgba8>(ivec{19, 40}) == color::TRANSPARENT_COLOR);
+  for (i32 x = 20; x < 80; ++x) {
+    REQUIRE(layer.get_color<rgba8>(ivec{x, 40}) == color);
+  }
+  REQUIRE(layer.get_color<rgba8>(ivec{80, 40}) == color::TRANSPARENT_COLOR);
+  REQUIRE(layer.get_cel()->get_tile_count() == 3);
+
+  irect bounds = layer.get_bounds();
+  REQUIRE(bounds.x == 20);
+  REQUIRE(bounds.y == 40);
+  REQUIRE(bounds.w == 60);
+  REQUIRE(bounds.h == 1);
+
+  REQUIRE(layer.set_span<rgba8>({10, 50}, 5, color) == Error::OK);
+  bounds = layer.get_bounds();
+  REQUIRE(bounds.x == 10);
+  REQUIRE(bounds.w == 70);
+  REQUIRE(bounds.h == 11);
+
+  // Erasing the middle of a row keeps both ends
+  REQUIRE(
+      layer.set_span<rgba8>({0, 40}, 50, color::TRANSPARENT_COLOR) ==
+      Error::OK
+  );
+  REQUIRE(
+      layer.set_span<rgba8>({10, 50}, 5, color::TRANSPARENT_COLOR) ==
+      Error::OK
+  );
+  bounds = layer.get_bounds();
+  REQUIRE(bounds.x == 50);
+  REQUIRE(bounds.y == 40);
+  REQUIRE(bounds.w == 30);
+  REQUIRE(bounds.h == 1);
+}
+
+TEST_CASE("Pool: Recycled aligned buffers", "[draw]") {
+  BufferPool pool{};
+
+  void* ptr = pool.allocate(100);
+  REQUIRE(ptr != nullptr);
+  REQUIRE((u64)ptr % BUFFER_ALIGNMENT == 0U);
+
+  // Same size class is reused
+  pool.free(ptr, 100);
+  REQUIRE(pool.get_cached_bytes() == 128);
+  REQUIRE(pool.allocate(120) == ptr);
+  REQUIRE(pool.get_cached_bytes() == 0);
+
+  std::memset(ptr, 0x12, 120);
+  REQUIRE(pool.reallocate(ptr, 120, 128) == ptr);
+  void* bigger = pool.reallocate(ptr, 128, 1000);
+  REQUIRE(bigger != ptr);
+  REQUIRE((u64)bigger % BUFFER_ALIGNMENT == 0U);
+  REQUIRE(((u8*)bigger)[119] == 0x12U);
+  REQUIRE(pool.get_cached_bytes() == 128);
+
+  auto* zeroed = (u8*)pool.allocate_zeroed(128);
+  REQUIRE(zeroed == ptr);
+  REQUIRE(zeroed[119] == 0U);
+
+  pool.free(zeroed, 128);
+  pool.free(bigger, 1000);
+  REQUIRE(pool.get_cached_bytes() == 128 + 1024);
+
+  // Pixels of the tiles are aligned too
+  Anim anim{};
+  anim.init({40, 40}, RGBA8);
+  anim.get_layer(0, 0).paint({33, 0}, rgba8{1U, 2U, 3U, 4U});
+  REQUIRE((u64)anim.get_layer(0, 0).get_pixel({32, 0}) % 64 == 0U);
+}
+
+#ifdef __unix__
+TEST_CASE("Cel: mapped tile store", "[draw]") {
+  auto& store = get_tile_store();
+  // Stays on the heap if the file cannot be created
+  Error error = store.init_mapped("pixel_draw/missing/pixel_draw.scratch");
+  i32 cause = errno;
+  REQUIRE(error == Error::IO_ERROR);
+  REQUIRE(cause == ENOENT);
+  REQUIRE_FALSE(store.is_mapped());
+  REQUIRE(store.init_mapped("pixel_draw.scratch", 1LL << 30) == Error::OK);
+  REQUIRE(store.is_mapped());
+
+  ivec cel_size{100, 70};
+  {
+    Anim anim{};
+    anim.init(cel_size, RGBA8);
+    anim.insert_frames(1, 3);
+    for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+      anim.get_layer(f, 0).paint({f * TILE_SIZE, 0}, rgba8{(u8)f, 1U, 2U, 3U});
+    }
+    REQUIRE(store.get_tile_count() == 4);
+    REQUIRE(store.get_mapped_size() == STORE_GROW_SIZE);
+
+    Anim copy{};
+    copy.copy(anim);
+    copy.get_layer(1, 0).paint({TILE_SIZE + 1, 1}, rgba8{4U, 5U, 6U, 7U});
+    REQUIRE(store.get_tile_count() == 5);
+
+    // Freed tiles are reused and zeroed
+    anim.remove_frame(1);
+    copy.clear();
+    REQUIRE(store.get_tile_count() == 3);
+    anim.get_layer(0, 0).paint({99, 69}, rgba8{8U, 9U, 10U, 11U});
+    REQUIRE(store.get_tile_count() == 4);
+
+    auto layer = anim.get_layer(0, 0);
+    REQUIRE(*(rgba8*)layer.get_pixel({99, 69}) == rgba8{8U, 9U, 10U, 11U});
+    REQUIRE(*(rgba8*)layer.get_pixel({96, 64}) == color::TRANSPARENT_COLOR);
+    REQUIRE(*(rgba8*)layer.get_pixel({0, 0}) == rgba8{0U, 1U, 2U, 3U});
+    for (i32 f = 1; f < anim.get_frame_count(); ++f) {
+      REQUIRE(
+          *(rgba8*)anim.get_layer(f, 0).get_pixel({(f + 1) * TILE_SIZE, 0}) ==
+          rgba8{(u8)(f + 1), 1U, 2U, 3U}
+      );
+    }
+  }
+
+  REQUIRE(store.get_tile_count() == 0);
+  store.clear();
+  REQUIRE(!store.is_mapped());
+}
+#endif
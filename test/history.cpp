@@ -0,0 +1,726 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-18
+ *==========================*/
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/history/caretaker.hpp"
+#include "core/history/journal.hpp"
+#include "core/history/rle.hpp"
+#include "core/history/spill.hpp"
+#include "types.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace history;
+
+const ivec size{70, 50};
+
+std::string get_journal_path() noexcept {
+  return (std::filesystem::temp_directory_path() / "pixel_history.pxlj")
+      .string();
+}
+
+void remove_journal(const std::string& path) noexcept {
+  std::error_code error{};
+  std::filesystem::remove(path, error);
+  std::filesystem::remove(path + ".bak", error);
+}
+
+// New animation with the journal at the path replayed on it
+void open_model(
+    Caretaker& caretaker, Model& model, const std::string& path,
+    draw::ColorType type = draw::RGBA8
+) noexcept {
+  REQUIRE(model.anim.init(size, type) == Error::OK);
+  model.frame_index = model.layer_index = 0;
+  model.layer = model.anim.get_layer(0, 0);
+  REQUIRE(caretaker.init(model) == Error::OK);
+  REQUIRE(caretaker.open_journal(path.c_str(), model) == Error::OK);
+}
+
+void move_to(Model& model, i32 frame, i32 layer) noexcept {
+  model.frame_index = frame;
+  model.layer_index = layer;
+  model.layer = model.anim.get_layer(frame, layer);
+}
+
+// Line of pixels on the current layer, different for every seed
+void paint(Model& model, i32 seed) noexcept {
+  for (i32 i = 0; i < 40; ++i) {
+    ivec pos{(i * 7 + seed) % size.x, (i + seed * 3) % size.y};
+    REQUIRE(
+        model.layer.paint(pos, rgba8{(u8)seed, (u8)i, 0x01U, 0xffU}) ==
+        Error::OK
+    );
+  }
+}
+
+bool is_same_anim(Model& lhs, Model& rhs) noexcept {
+  auto& lhs_anim = lhs.anim;
+  auto& rhs_anim = rhs.anim;
+  if (lhs_anim.get_type() != rhs_anim.get_type() ||
+      lhs_anim.get_frame_count() != rhs_anim.get_frame_count() ||
+      lhs_anim.get_layer_count() != rhs_anim.get_layer_count() ||
+      lhs.frame_index != rhs.frame_index ||
+      lhs.layer_index != rhs.layer_index) {
+    return false;
+  }
+
+  std::vector<u8> lhs_pixels(size.x * size.y * 8);
+  std::vector<u8> rhs_pixels(size.x * size.y * 8);
+  for (i32 f = 0; f < lhs_anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < lhs_anim.get_layer_count(); ++l) {
+      lhs_anim.get_layer(f, l).get_pixels(lhs_pixels.data());
+      rhs_anim.get_layer(f, l).get_pixels(rhs_pixels.data());
+      if (lhs_pixels != rhs_pixels) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Types of the records in the journal in order
+std::vector<RecordType> read_types(const std::string& path) noexcept {
+  std::vector<u8> bytes{};
+  REQUIRE(Journal::read(path.c_str(), bytes) == Error::OK);
+
+  std::vector<RecordType> types{};
+  i64 offset = Journal::get_header_size();
+  Record record{};
+  while (Journal::next(bytes, offset, record)) {
+    types.push_back(record.type);
+  }
+  return types;
+}
+
+// Pixels of the current layer
+std::vector<u8> get_pixels(Model& model) noexcept {
+  std::vector<u8> pixels(size.x * size.y * 4);
+  model.layer.get_pixels(pixels.data());
+  return pixels;
+}
+
+// Pushes a paint and waits for it to be captured
+u64 snap(Caretaker& caretaker, Model& model, i32 seed) noexcept {
+  paint(model, seed);
+  REQUIRE(caretaker.snap(model) == Error::OK);
+  caretaker.finish_captures();
+  return caretaker.get_current();
+}
+
+TEST_CASE("Caretaker: branches", "[history]") {
+  Caretaker caretaker{};
+  Model model{};
+  REQUIRE(model.anim.init(size, draw::RGBA8) == Error::OK);
+  model.layer = model.anim.get_layer(0, 0);
+  REQUIRE(caretaker.init(model) == Error::OK);
+
+  auto start = get_pixels(model);
+  u64 a = snap(caretaker, model, 1);
+  u64 b = snap(caretaker, model, 2);
+  auto at_b = get_pixels(model);
+  REQUIRE(caretaker.undo(model) == Error::OK);
+  auto at_a = get_pixels(model);
+  u64 c = snap(caretaker, model, 3);
+  auto at_c = get_pixels(model);
+
+  // Painting after an undo keeps the undone snapshot as a sibling
+  REQUIRE(caretaker.get_snapshot_count() == 3);
+  REQUIRE_FALSE(caretaker.can_redo());
+  REQUIRE(caretaker.undo(model) == Error::OK);
+  REQUIRE(caretaker.get_current() == a);
+  REQUIRE(caretaker.get_branch_count() == 2);
+
+  SECTION("redo goes to the last visited branch") {
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(caretaker.get_current() == c);
+    REQUIRE(get_pixels(model) == at_c);
+  }
+
+  SECTION("switch branch") {
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(caretaker.switch_branch(model) == Error::OK);
+    REQUIRE(caretaker.get_current() == b);
+    REQUIRE(get_pixels(model) == at_b);
+    REQUIRE(caretaker.switch_branch(model, -1) == Error::OK);
+    REQUIRE(caretaker.get_current() == c);
+    REQUIRE(get_pixels(model) == at_c);
+
+    // Redo follows the branch that was switched to
+    REQUIRE(caretaker.switch_branch(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(caretaker.get_current() == b);
+  }
+
+  SECTION("goto") {
+    REQUIRE(caretaker.goto_snapshot(model, b) == Error::OK);
+    REQUIRE(get_pixels(model) == at_b);
+    u64 d = snap(caretaker, model, 4);
+    auto at_d = get_pixels(model);
+
+    REQUIRE(caretaker.goto_snapshot(model, c) == Error::OK);
+    REQUIRE(get_pixels(model) == at_c);
+    REQUIRE(caretaker.goto_snapshot(model, d) == Error::OK);
+    REQUIRE(get_pixels(model) == at_d);
+    REQUIRE(caretaker.goto_snapshot(model, a) == Error::OK);
+    REQUIRE(get_pixels(model) == at_a);
+    REQUIRE(caretaker.goto_snapshot(model, NO_SNAPSHOT) == Error::OK);
+    REQUIRE(get_pixels(model) == start);
+    REQUIRE_FALSE(caretaker.can_undo());
+
+    // Redo walks back down the path of the last goto
+    while (caretaker.can_redo()) {
+      REQUIRE(caretaker.redo(model) == Error::OK);
+    }
+    REQUIRE(caretaker.get_current() == d);
+  }
+}
+
+TEST_CASE("Caretaker: snaps while capturing", "[history]") {
+  Caretaker caretaker{};
+  Model model{};
+  REQUIRE(model.anim.init(size, draw::RGBA8) == Error::OK);
+  model.layer = model.anim.get_layer(0, 0);
+  REQUIRE(caretaker.init(model) == Error::OK);
+
+  // Snaps do not wait for the captures before them, the paint in the
+  // middle changes nothing and its snapshot is dropped once collected
+  auto start = get_pixels(model);
+  paint(model, 1);
+  REQUIRE(caretaker.snap(model) == Error::OK);
+  u64 a = caretaker.get_current();
+  auto at_a = get_pixels(model);
+  paint(model, 1);
+  REQUIRE(caretaker.snap(model) == Error::OK);
+  paint(model, 2);
+  REQUIRE(caretaker.snap(model) == Error::OK);
+  u64 b = caretaker.get_current();
+  auto at_b = get_pixels(model);
+  caretaker.finish_captures();
+
+  REQUIRE(caretaker.get_snapshot_count() == 2);
+  REQUIRE(caretaker.get_current() == b);
+  REQUIRE(caretaker.undo(model) == Error::OK);
+  REQUIRE(caretaker.get_current() == a);
+  REQUIRE(get_pixels(model) == at_a);
+  REQUIRE(caretaker.undo(model) == Error::OK);
+  REQUIRE(get_pixels(model) == start);
+  REQUIRE_FALSE(caretaker.can_undo());
+  REQUIRE(caretaker.redo(model) == Error::OK);
+  REQUIRE(caretaker.redo(model) == Error::OK);
+  REQUIRE(caretaker.get_current() == b);
+  REQUIRE(get_pixels(model) == at_b);
+  REQUIRE_FALSE(caretaker.can_redo());
+}
+
+TEST_CASE("Caretaker: goto across eviction", "[history]") {
+  Caretaker caretaker{};
+  Model model{};
+  REQUIRE(model.anim.init(size, draw::RGBA8) == Error::OK);
+  model.layer = model.anim.get_layer(0, 0);
+  REQUIRE(caretaker.init(model) == Error::OK);
+
+  // Two long branches from the first snapshot, the one left is compressed
+  u64 root = snap(caretaker, model, 1);
+  u64 left = NO_SNAPSHOT;
+  for (i32 i = 0; i < 16; ++i) {
+    left = snap(caretaker, model, i + 2);
+  }
+  auto at_left = get_pixels(model);
+  REQUIRE(caretaker.goto_snapshot(model, root) == Error::OK);
+  u64 right = NO_SNAPSHOT;
+  for (i32 i = 0; i < 16; ++i) {
+    right = snap(caretaker, model, i + 20);
+  }
+  auto at_right = get_pixels(model);
+  caretaker.finish_compression();
+
+  SECTION("the path is kept") {
+    // The paint is still being captured, it goes over the budget once it
+    // is collected on the way
+    caretaker.set_budget(caretaker.get_used_bytes());
+    paint(model, 40);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    REQUIRE(caretaker.goto_snapshot(model, left) == Error::OK);
+    REQUIRE(caretaker.get_current() == left);
+    REQUIRE(get_pixels(model) == at_left);
+    caretaker.finish_compression();
+    REQUIRE(caretaker.get_used_bytes() <= caretaker.get_budget());
+
+    // Whatever is left of the other branch can still be walked to
+    if (caretaker.goto_snapshot(model, right) == Error::OK) {
+      REQUIRE(get_pixels(model) == at_right);
+    }
+    while (caretaker.can_undo()) {
+      REQUIRE(caretaker.undo(model) == Error::OK);
+    }
+  }
+
+  SECTION("dropped snapshots") {
+    caretaker.set_budget(1);
+    REQUIRE(caretaker.get_current() == right);
+    REQUIRE(caretaker.goto_snapshot(model, left) == Error::BAD_ALLOC);
+    REQUIRE(caretaker.goto_snapshot(model, root) == Error::BAD_ALLOC);
+    REQUIRE(caretaker.get_current() == right);
+    REQUIRE(get_pixels(model) == at_right);
+    REQUIRE(caretaker.switch_branch(model) == Error::OK);
+    REQUIRE(caretaker.get_current() == right);
+
+    while (caretaker.can_undo()) {
+      REQUIRE(caretaker.undo(model) == Error::OK);
+    }
+    REQUIRE(caretaker.get_snapshot_count() > 0);
+  }
+}
+
+TEST_CASE("Caretaker: spill", "[history]") {
+  Caretaker caretaker{};
+  Model model{};
+  REQUIRE(model.anim.init(size, draw::RGBA8) == Error::OK);
+  model.layer = model.anim.get_layer(0, 0);
+  REQUIRE(caretaker.init(model) == Error::OK);
+  REQUIRE(caretaker.init_spill() == Error::OK);
+
+  // Less than the snapshots near the cursor take, the older ones are
+  // compressed then spilled to the file
+  caretaker.set_budget(30000);
+  std::vector<std::vector<u8>> states{get_pixels(model)};
+  for (i32 i = 1; i <= 24; ++i) {
+    snap(caretaker, model, i);
+    caretaker.finish_compression();
+    states.push_back(get_pixels(model));
+  }
+  REQUIRE(caretaker.get_snapshot_count() == 24);
+  REQUIRE(caretaker.get_spilled_bytes() > 0);
+
+  // Read back from the file on the way
+  for (i32 i = 23; i >= 0; --i) {
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(get_pixels(model) == states[i]);
+  }
+  REQUIRE_FALSE(caretaker.can_undo());
+  for (i32 i = 1; i <= 24; ++i) {
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(get_pixels(model) == states[i]);
+  }
+  caretaker.finish_compression();
+
+  // Dropped snapshots free their bytes, the ones left still undo
+  i64 spilled = caretaker.get_spilled_bytes();
+  caretaker.set_budget(1);
+  i32 count = caretaker.get_snapshot_count();
+  REQUIRE(count < 24);
+  REQUIRE(caretaker.get_spilled_bytes() < spilled);
+  for (i32 i = 1; i <= count; ++i) {
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(get_pixels(model) == states[24 - i]);
+  }
+  REQUIRE_FALSE(caretaker.can_undo());
+}
+
+TEST_CASE("SpillFile: reuse", "[history]") {
+  SpillFile file{};
+  REQUIRE(file.open() == Error::OK);
+  REQUIRE(file.write(std::vector<u8>(100, 0x01U)) == 0);
+  REQUIRE(file.write(std::vector<u8>(50, 0x02U)) == 100);
+
+  // Freed bytes are written over before the file grows
+  file.free(0, 100);
+  REQUIRE(file.get_size() == 50);
+  REQUIRE(file.write(std::vector<u8>(60, 0x03U)) == 0);
+  REQUIRE(file.write(std::vector<u8>(40, 0x04U)) == 60);
+  REQUIRE(file.write(std::vector<u8>(10, 0x05U)) == 150);
+  REQUIRE(file.get_size() == 160);
+
+  std::vector<u8> bytes{};
+  REQUIRE(file.read(0, 60, bytes) == Error::OK);
+  REQUIRE(bytes == std::vector<u8>(60, 0x03U));
+  REQUIRE(file.read(60, 40, bytes) == Error::OK);
+  REQUIRE(bytes == std::vector<u8>(40, 0x04U));
+  REQUIRE(file.read(100, 50, bytes) == Error::OK);
+  REQUIRE(bytes == std::vector<u8>(50, 0x02U));
+  REQUIRE(file.read(150, 10, bytes) == Error::OK);
+  REQUIRE(bytes == std::vector<u8>(10, 0x05U));
+}
+
+TEST_CASE("Journal: records", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  {
+    Caretaker caretaker{};
+    Model model{};
+    open_model(caretaker, model, path);
+
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    REQUIRE(
+        caretaker.execute(
+            model, {.type = ActionType::INSERT_FRAMES, .index = 1}
+        ) == Error::OK
+    );
+    move_to(model, 1, 0);
+    paint(model, 2);
+    move_to(model, 0, 0);
+    paint(model, 3);
+    REQUIRE(caretaker.snap_cels(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.redo(model) == Error::OK);
+  }
+
+  std::vector<RecordType> expected{
+      RecordType::INIT,   RecordType::ANIM,       RecordType::PAINT,
+      RecordType::ACTION, RecordType::PAINT_CELS, RecordType::UNDO,
+      RecordType::REDO};
+  REQUIRE(read_types(path) == expected);
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: replay", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  Caretaker caretaker{};
+  Model model{};
+  open_model(caretaker, model, path);
+
+  SECTION("paint") {
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    paint(model, 2);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+  }
+
+  SECTION("action") {
+    REQUIRE(
+        caretaker.execute(
+            model, {.type = ActionType::INSERT_LAYERS, .index = 1, .count = 2}
+        ) == Error::OK
+    );
+    move_to(model, 0, 2);
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    REQUIRE(
+        caretaker.execute(
+            model, {.type = ActionType::MOVE_LAYER, .index = 2, .to = 0}
+        ) == Error::OK
+    );
+    REQUIRE(
+        caretaker.execute(
+            model, {.type = ActionType::DUPLICATE_LAYER, .index = 0}
+        ) == Error::OK
+    );
+  }
+
+  SECTION("undo and redo") {
+    for (i32 i = 1; i <= 4; ++i) {
+      paint(model, i);
+      REQUIRE(caretaker.snap(model) == Error::OK);
+    }
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.redo(model) == Error::OK);
+  }
+
+  SECTION("branch") {
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    u64 first = caretaker.get_current();
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    paint(model, 2);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    REQUIRE(caretaker.goto_snapshot(model, first) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+  }
+
+  SECTION("paint cels") {
+    REQUIRE(
+        caretaker.execute(
+            model, {.type = ActionType::INSERT_FRAMES, .index = 1}
+        ) == Error::OK
+    );
+    move_to(model, 1, 0);
+    paint(model, 1);
+    move_to(model, 0, 0);
+    paint(model, 2);
+    REQUIRE(caretaker.snap_cels(model) == Error::OK);
+  }
+
+  caretaker.close_journal(model);
+  i32 branch_count = caretaker.get_branch_count();
+  bool can_undo = caretaker.can_undo();
+  bool can_redo = caretaker.can_redo();
+
+  Caretaker replayed{};
+  Model replayed_model{};
+  open_model(replayed, replayed_model, path);
+  REQUIRE(is_same_anim(model, replayed_model));
+  REQUIRE(replayed.get_branch_count() == branch_count);
+  REQUIRE(replayed.can_undo() == can_undo);
+  REQUIRE(replayed.can_redo() == can_redo);
+  REQUIRE_FALSE(std::filesystem::exists(path + ".bak"));
+
+  // Both histories go to the same states
+  while (caretaker.can_undo()) {
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(replayed.undo(replayed_model) == Error::OK);
+    REQUIRE(is_same_anim(model, replayed_model));
+  }
+  while (caretaker.can_redo()) {
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(replayed.redo(replayed_model) == Error::OK);
+    REQUIRE(is_same_anim(model, replayed_model));
+  }
+  REQUIRE_FALSE(replayed.can_redo());
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: replay after eviction", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  // Most snapshots are dropped while painting, the replay still has to
+  // find the ones that were undone and redone
+  Model model{};
+  {
+    Caretaker caretaker{20000};
+    open_model(caretaker, model, path);
+    for (i32 i = 1; i < 24; ++i) {
+      paint(model, i);
+      REQUIRE(caretaker.snap(model) == Error::OK);
+      for (i32 j = 0; j < 2 && i % 5 == 0 && caretaker.can_undo(); ++j) {
+        REQUIRE(caretaker.undo(model) == Error::OK);
+      }
+      if (i % 7 == 0 && caretaker.can_redo()) {
+        REQUIRE(caretaker.redo(model) == Error::OK);
+      }
+      caretaker.finish_compression();
+    }
+  }
+
+  Caretaker replayed{20000};
+  Model replayed_model{};
+  open_model(replayed, replayed_model, path);
+  REQUIRE(is_same_anim(model, replayed_model));
+  REQUIRE_FALSE(std::filesystem::exists(path + ".bak"));
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: torn tail", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  Model model{};
+  {
+    Caretaker caretaker{};
+    open_model(caretaker, model, path);
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+  }
+  auto valid_size = std::filesystem::file_size(path);
+
+  // Crash while a record was being written
+  std::vector<u8> record{};
+  Journal::encode_action(
+      {.type = ActionType::INSERT_FRAMES, .index = 1}, record
+  );
+  std::FILE* file = std::fopen(path.c_str(), "ab");
+  REQUIRE(file != nullptr);
+  std::fwrite(record.data(), 1, record.size() - 3, file);
+  std::fclose(file);
+
+  {
+    Caretaker replayed{};
+    Model replayed_model{};
+    open_model(replayed, replayed_model, path);
+    REQUIRE(is_same_anim(model, replayed_model));
+    REQUIRE(std::filesystem::file_size(path) == valid_size);
+    REQUIRE_FALSE(std::filesystem::exists(path + ".bak"));
+
+    // New records follow the valid ones
+    paint(replayed_model, 2);
+    REQUIRE(replayed.snap(replayed_model) == Error::OK);
+    paint(model, 2);
+  }
+
+  Caretaker replayed{};
+  Model replayed_model{};
+  open_model(replayed, replayed_model, path);
+  REQUIRE(is_same_anim(model, replayed_model));
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: record that cannot be replayed", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  Model model{};
+  {
+    Caretaker caretaker{};
+    open_model(caretaker, model, path);
+    paint(model, 1);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+  }
+
+  // Well formed but removes a frame that does not exist
+  std::vector<u8> record{};
+  Journal::encode_action(
+      {.type = ActionType::REMOVE_FRAMES, .index = 3}, record
+  );
+  std::FILE* file = std::fopen(path.c_str(), "ab");
+  REQUIRE(file != nullptr);
+  std::fwrite(record.data(), 1, record.size(), file);
+  std::fclose(file);
+  auto size = std::filesystem::file_size(path);
+
+  Caretaker replayed{};
+  Model replayed_model{};
+  open_model(replayed, replayed_model, path);
+  REQUIRE(is_same_anim(model, replayed_model));
+  REQUIRE(std::filesystem::file_size(path + ".bak") == size);
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: rewrite", "[history]") {
+  auto path = get_journal_path();
+  remove_journal(path);
+
+  Caretaker caretaker{};
+  Model model{};
+  open_model(caretaker, model, path, draw::INDEXED8);
+
+  SECTION("over the limit") {
+    caretaker.set_journal_limit(1);
+    for (i32 i = 1; i <= 6; ++i) {
+      paint(model, i);
+      REQUIRE(caretaker.snap(model) == Error::OK);
+    }
+    caretaker.set_journal_limit(JOURNAL_LIMIT);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    caretaker.close_journal(model);
+
+    // Written again before the last paint, the moves after it are appended
+    std::vector<RecordType> expected{
+        RecordType::INIT, RecordType::ANIM, RecordType::PALETTE,
+        RecordType::PAINT, RecordType::UNDO};
+    REQUIRE(read_types(path) == expected);
+  }
+
+  SECTION("undo past the start of the journal") {
+    for (i32 i = 1; i <= 3; ++i) {
+      paint(model, i);
+      REQUIRE(caretaker.snap(model) == Error::OK);
+    }
+    caretaker.set_journal_limit(1);
+    paint(model, 4);
+    REQUIRE(caretaker.snap(model) == Error::OK);
+    caretaker.set_journal_limit(JOURNAL_LIMIT);
+
+    // Only written again once closed, the moves before it are not appended
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+    REQUIRE(caretaker.redo(model) == Error::OK);
+    REQUIRE(caretaker.undo(model) == Error::OK);
+  }
+
+  caretaker.close_journal(model);
+  Caretaker replayed{};
+  Model replayed_model{};
+  open_model(replayed, replayed_model, path);
+  REQUIRE(is_same_anim(model, replayed_model));
+  REQUIRE(replayed_model.anim.get_palette()->get_count() ==
+          model.anim.get_palette()->get_count());
+  REQUIRE_FALSE(replayed.can_undo());
+  remove_journal(path);
+}
+
+TEST_CASE("Journal: malformed records", "[history]") {
+  SECTION("cut off pixels") {
+    std::vector<u8> pixels(draw::TILE_SIZE * draw::TILE_SIZE * 4);
+    for (i32 i = 0; i < (i32)pixels.size(); ++i) {
+      pixels[i] = (i / 37) % 3 == 0 ? 0x05U : (u8)(i * 7);
+    }
+    std::vector<u8> encoded{};
+    rle_encode(pixels.data(), (i32)pixels.size(), 4, encoded);
+
+    std::vector<u8> decoded(pixels.size());
+    const u8* end = encoded.data() + encoded.size(); // NOLINT
+    for (u64 i = 0U; i < encoded.size(); ++i) {
+      // NOLINTNEXTLINE
+      const u8* cut = encoded.data() + i;
+      REQUIRE(
+          rle_decode(
+              encoded.data(), cut, decoded.data(), (i32)decoded.size(), 4
+          ) == nullptr
+      );
+    }
+    REQUIRE(
+        rle_decode(
+            encoded.data(), end, decoded.data(), (i32)decoded.size(), 4
+        ) == end
+    );
+    REQUIRE(decoded == pixels);
+
+    // Runs past the pixels
+    u8 run[] = {0xffU, 0x01U, 0x02U, 0x03U, 0x04U};
+    REQUIRE(rle_decode(run, run + 5, decoded.data(), 4 * 100, 4) == nullptr);
+  }
+
+  SECTION("actions out of the animation") {
+    draw::Anim anim{};
+    REQUIRE(anim.init(size, draw::RGBA8) == Error::OK);
+    REQUIRE(anim.insert_frames(1, 2) == Error::OK);
+
+    auto decode = [&anim](Action action) {
+      std::vector<u8> record{};
+      Journal::encode_action(action, record);
+      std::vector<u8> bytes(Journal::get_header_size());
+      bytes.insert(bytes.end(), record.begin(), record.end());
+
+      i64 offset = Journal::get_header_size();
+      Record read{};
+      REQUIRE(Journal::next(bytes, offset, read));
+      Action decoded{};
+      return Journal::decode_action(read, anim, decoded);
+    };
+
+    REQUIRE(
+        decode({.type = ActionType::REMOVE_FRAMES, .index = 1, .count = 2}) ==
+        Error::OK
+    );
+    REQUIRE(
+        decode({.type = ActionType::REMOVE_FRAMES, .index = 0, .count = 3}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(
+        decode({.type = ActionType::REMOVE_FRAMES, .index = 2, .count = 2}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(
+        decode({.type = ActionType::REMOVE_LAYERS, .index = 0}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(
+        decode({.type = ActionType::INSERT_LAYERS, .index = 2}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(
+        decode({.type = ActionType::MOVE_FRAME, .index = 0, .to = 3}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(
+        decode({.type = ActionType::DUPLICATE_LAYER, .index = 1}) ==
+        Error::BAD_ALLOC
+    );
+    REQUIRE(decode({.type = ActionType::PAINT}) == Error::BAD_ALLOC);
+  }
+}
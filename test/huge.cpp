@@ -0,0 +1,143 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-17
+ *==========================*/
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/draw/anim.hpp"
+#include "core/draw/cel.hpp"
+#include "core/draw/types.hpp"
+#include "types.hpp"
+
+// NOTE: These should never flatten a whole layer, a single 16k x 16k RGBA8
+//   layer is already 1GB
+const ivec huge_size{16384, 16384};
+const i64 huge_isize = (i64)huge_size.x * huge_size.y;
+const i32 frame_count = 48;
+
+using namespace draw;
+using color::TRANSPARENT_COLOR;
+
+rgba8 get_color(i32 index) noexcept {
+  return {(u8)index, (u8)(index >> 8), 0xff, 0xff};
+}
+
+bool is_color(const_data_ptr pixel, rgba8 color) noexcept {
+  return *(const rgba8*)pixel == color;
+}
+
+TEST_CASE("Huge: 64-bit pixel offsets", "[huge]") {
+  SECTION("RGBA8") {
+    Cel cel{};
+    cel.init(huge_size, RGBA8);
+    Cel* slot = &cel;
+    Layer layer{&slot, huge_size, RGBA8};
+
+    REQUIRE(layer.paint(huge_isize - 1, get_color(1)) == Error::OK);
+    REQUIRE(layer.paint({0, huge_size.y - 1}, get_color(2)) == Error::OK);
+    REQUIRE(layer.paint({huge_size.x - 1, 0}, get_color(3)) == Error::OK);
+
+    REQUIRE(is_color(layer.get_pixel(huge_isize - 1), get_color(1)));
+    REQUIRE(is_color(
+        layer.get_pixel({huge_size.x - 1, huge_size.y - 1}), get_color(1)
+    ));
+    REQUIRE(is_color(layer.get_pixel({0, huge_size.y - 1}), get_color(2)));
+    REQUIRE(is_color(layer.get_pixel((i64)huge_size.x - 1), get_color(3)));
+    REQUIRE(is_color(layer.get_pixel(huge_isize / 2), TRANSPARENT_COLOR));
+
+    // Only the painted tiles are allocated
+    REQUIRE(cel.get_tile_count() == 3);
+  }
+
+  SECTION("RGBA16") {
+    Anim anim{};
+    REQUIRE(anim.init(huge_size, RGBA16) == Error::OK);
+
+    auto layer = anim.get_layer(0, 0);
+    REQUIRE(layer.get_type() == RGBA16);
+
+    // Bytes of a whole layer does not fit in an i32
+    REQUIRE(huge_isize * (RGBA16 & 0x0000'ffff) > 0x7fff'ffffLL);
+
+    const auto* pixel = layer.get_pixel(huge_isize - 1);
+    for (i32 i = 0; i < 8; ++i) {
+      REQUIRE(pixel[i] == 0U);
+    }
+  }
+}
+
+TEST_CASE("Huge: Dozens of frames", "[huge]") {
+  Anim anim{};
+  REQUIRE(anim.init(huge_size, RGBA8) == Error::OK);
+  REQUIRE(anim.insert_frames(1, frame_count - 1) == Error::OK);
+  REQUIRE(anim.insert_layers(1, 3) == Error::OK);
+  REQUIRE(anim.get_frame_count() == frame_count);
+  REQUIRE(anim.get_layer_count() == 4);
+
+  // Paint a far corner pixel on every cel
+  for (i32 f = 0; f < frame_count; ++f) {
+    for (i32 l = 0; l < 4; ++l) {
+      REQUIRE(
+          anim.get_layer(f, l).paint(huge_isize - 1 - l, get_color(f)) ==
+          Error::OK
+      );
+    }
+  }
+
+  SECTION("Paint") {
+    for (i32 f = 0; f < frame_count; ++f) {
+      for (i32 l = 0; l < 4; ++l) {
+        REQUIRE(is_color(
+            anim.get_layer(f, l).get_pixel(huge_isize - 1 - l), get_color(f)
+        ));
+      }
+    }
+  }
+
+  SECTION("Duplicate and remove") {
+    REQUIRE(anim.duplicate_frame(frame_count - 1) == Error::OK);
+    REQUIRE(anim.duplicate_layer(0) == Error::OK);
+    REQUIRE(anim.get_frame_count() == frame_count + 1);
+    REQUIRE(anim.get_layer_count() == 5);
+
+    // Duplicated frame shares the cels until painted on
+    REQUIRE(
+        anim.get_layer(frame_count, 2).paint(0, get_color(0xffff)) == Error::OK
+    );
+    REQUIRE(is_color(
+        anim.get_layer(frame_count - 1, 2).get_pixel(0), TRANSPARENT_COLOR
+    ));
+    REQUIRE(is_color(
+        anim.get_layer(frame_count, 2).get_pixel(huge_isize - 2),
+        get_color(frame_count - 1)
+    ));
+
+    anim.remove_frames(0, frame_count / 2);
+    REQUIRE(anim.get_frame_count() == frame_count / 2 + 1);
+    for (i32 f = 0; f < frame_count / 2; ++f) {
+      REQUIRE(is_color(
+          anim.get_layer(f, 0).get_pixel(huge_isize - 1),
+          get_color(f + frame_count / 2)
+      ));
+      REQUIRE(is_color(
+          anim.get_layer(f, 1).get_pixel(huge_isize - 1),
+          get_color(f + frame_count / 2)
+      ));
+    }
+  }
+
+  SECTION("Copy") {
+    Anim copy{};
+    REQUIRE(copy.copy(anim) == Error::OK);
+    REQUIRE(copy.get_frame_count() == frame_count);
+
+    REQUIRE(copy.get_layer(0, 0).paint(0, get_color(0xffff)) == Error::OK);
+    REQUIRE(is_color(anim.get_layer(0, 0).get_pixel(0), TRANSPARENT_COLOR));
+    REQUIRE(is_color(
+        copy.get_layer(frame_count - 1, 3).get_pixel(huge_isize - 4),
+        get_color(frame_count - 1)
+    ));
+  }
+}
@@ -0,0 +1,512 @@
+/*==========================*
+ * Author/s:
+ *  - silentrald
+ * Version: 1.0
+ * Created: 2026-10-18
+ *==========================*/
+
+#include "catch2/catch_test_macros.hpp"
+#include "core/draw/color.hpp"
+#include "core/tool/brush.hpp"
+#include "core/tool/fill.hpp"
+#include "core/tool/utils.hpp"
+#include "types.hpp"
+#include <cstdlib>
+#include <vector>
+
+using namespace tool;
+
+const draw::ColorType color_types[] = {
+    draw::RGBA8, draw::RGBA16, draw::INDEXED8};
+
+// Colors painted on the canvas, the last one is only used by the fills
+const rgba8 colors[] = {
+    {0x00U, 0x00U, 0x00U, 0x00U},
+    {0xffU, 0x00U, 0x00U, 0xffU},
+    {0x00U, 0x80U, 0xffU, 0xffU},
+    {0x12U, 0x34U, 0x56U, 0xffU},
+};
+
+struct Canvas {
+  Model model{};
+  Texture texture{};
+  Fill fill{};
+
+  Canvas(ivec size, draw::ColorType type, i32 frames) noexcept {
+    REQUIRE(this->model.anim.init(size, type) == Error::OK);
+    this->model.layer = this->model.anim.get_layer(0, 0);
+    this->model.select_mask.assign((i64)size.x * size.y, true);
+    this->texture.init_shadow(size);
+    this->model.tex1 = &this->texture;
+
+    // Stripes that cross the tiles with some noise, the other frames are
+    // copies sharing the tiles of the first one
+    u32 seed = 7U;
+    bool painted = true;
+    auto layer = this->model.anim.get_layer(0, 0);
+    for (i32 y = 0; y < size.y; ++y) {
+      for (i32 x = 0; x < size.x; ++x) {
+        seed = seed * 1103515245U + 12345U;
+        i32 color = (x / 5 + y / 7) % 3;
+        if ((seed >> 16) % 10U == 0U) {
+          color = (i32)((seed >> 8) % 3U);
+        }
+        painted =
+            painted && layer.paint(ivec{x, y}, colors[color]) == Error::OK;
+      }
+    }
+    REQUIRE(painted);
+    for (i32 f = 1; f < frames; ++f) {
+      REQUIRE(this->model.anim.duplicate_frame(f - 1) == Error::OK);
+    }
+    // The second layer shares the tiles of the first but is not filled
+    REQUIRE(this->model.anim.duplicate_layer(0) == Error::OK);
+    if (frames > 1) {
+      // Only the first tile is no longer shared
+      auto frame = this->model.anim.get_layer(1, 0);
+      REQUIRE(frame.paint(ivec{1, 1}, colors[2]) == Error::OK);
+    }
+    this->model.anim.dedup_tiles();
+  }
+
+  // Fills at the position with the foreground color
+  u32 click(ivec pos) noexcept {
+    this->model.curr_pos = pos;
+    this->model.fg_color = colors[3];
+    event::Input evt{};
+    evt.mouse.left.state = input::MouseState::UP;
+    return this->fill.execute(this->model, evt);
+  }
+};
+
+template <typename Color>
+std::vector<Color> get_colors(const draw::Layer& layer) noexcept {
+  std::vector<Color> pixels{};
+  ivec size = layer.get_size();
+  for (i32 y = 0; y < size.y; ++y) {
+    for (i32 x = 0; x < size.x; ++x) {
+      pixels.push_back(layer.get_color<Color>(ivec{x, y}));
+    }
+  }
+  return pixels;
+}
+
+// Pixels of every cel, frames first
+template <typename Color>
+std::vector<std::vector<Color>> get_anim_colors(Model& model) noexcept {
+  std::vector<std::vector<Color>> cels{};
+  auto& anim = model.anim;
+  for (i32 f = 0; f < anim.get_frame_count(); ++f) {
+    for (i32 l = 0; l < anim.get_layer_count(); ++l) {
+      cels.push_back(get_colors<Color>(anim.get_layer(f, l)));
+    }
+  }
+  return cels;
+}
+
+// Pixel by pixel flood fill of the connected pixels with the same color
+template <typename Color>
+void flood_fill(
+    std::vector<Color>& pixels, const std::vector<bool>& mask, ivec size,
+    ivec pos, Color color
+) noexcept {
+  Color old_color = pixels[pos.x + pos.y * size.x];
+  if (old_color == color) {
+    return;
+  }
+
+  std::vector<ivec> stack{pos};
+  while (!stack.empty()) {
+    ivec p = stack.back();
+    stack.pop_back();
+    if (p.x < 0 || p.x >= size.x || p.y < 0 || p.y >= size.y) {
+      continue;
+    }
+
+    i32 i = p.x + p.y * size.x;
+    if (!mask[i] || pixels[i] != old_color) {
+      continue;
+    }
+
+    pixels[i] = color;
+    stack.push_back({p.x - 1, p.y});
+    stack.push_back({p.x + 1, p.y});
+    stack.push_back({p.x, p.y - 1});
+    stack.push_back({p.x, p.y + 1});
+  }
+}
+
+// Pixel by pixel replace of the selected pixels with the old color
+template <typename Color>
+void replace_colors(
+    std::vector<Color>& pixels, const std::vector<bool>& mask,
+    Color old_color, Color color
+) noexcept {
+  for (i32 i = 0; i < (i32)pixels.size(); ++i) {
+    if (mask[i] && pixels[i] == old_color) {
+      pixels[i] = color;
+    }
+  }
+}
+
+// Whether the texture shows the current layer
+bool is_uploaded(Canvas& canvas) noexcept {
+  ivec size = canvas.model.anim.get_size();
+  std::vector<rgba8> pixels((i64)size.x * size.y);
+  canvas.model.layer.get_rgba8_pixels(pixels.data());
+  auto texture = canvas.texture.edit_pixels<rgba8>();
+  for (i32 i = 0; i < (i32)pixels.size(); ++i) {
+    // NOLINTNEXTLINE
+    if (texture.get_ptr()[i] != pixels[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Selections with edges inside the tiles
+void select(Model& model, i32 selection) noexcept {
+  ivec size = model.anim.get_size();
+  for (i32 y = 0; y < size.y; ++y) {
+    for (i32 x = 0; x < size.x; ++x) {
+      bool selected = true;
+      if (selection == 1) {
+        selected = x >= 3 && x < size.x - 5 && y >= 31 && y < size.y - 1;
+      } else if (selection == 2) {
+        selected = (x / 3 + y / 2) % 4 != 0;
+      }
+      model.select_mask[x + y * size.x] = selected;
+    }
+  }
+}
+
+template <typename Color>
+void test_scan_fill(ivec size, draw::ColorType type) noexcept {
+  const ivec clicks[] = {{0, 0}, {size.x - 1, size.y - 1}, {33, 31},
+                         {31, 33}, {size.x / 2, size.y - 1}};
+  for (i32 selection = 0; selection < 3; ++selection) {
+    Canvas canvas{size, type, 1};
+    auto& model = canvas.model;
+    select(model, selection);
+    model.layer.get_rgba8_pixels(canvas.texture.edit_pixels<rgba8>().get_ptr());
+
+    auto expected = get_colors<Color>(model.layer);
+    Color color = model.layer.to_color<Color>(colors[3]);
+    for (ivec pos : clicks) {
+      bool selected = model.select_mask[pos.x + pos.y * size.x];
+      bool changed = selected && expected[pos.x + pos.y * size.x] != color;
+      if (selected) {
+        flood_fill(expected, model.select_mask, size, pos, color);
+      }
+
+      u32 flags = canvas.click(pos);
+      REQUIRE(flags == (changed ? event::Flag::SNAPSHOT : event::Flag::NONE));
+      REQUIRE(get_colors<Color>(model.layer) == expected);
+      REQUIRE(is_uploaded(canvas));
+    }
+
+    // The other layer shared the tiles but is left as is
+    auto other = get_colors<Color>(model.anim.get_layer(0, 1));
+    Canvas original{size, type, 1};
+    REQUIRE(other == get_colors<Color>(original.model.layer));
+  }
+}
+
+template <typename Color>
+void test_replace_fill(ivec size, draw::ColorType type, FillScope scope) {
+  const ivec clicks[] = {{0, 0}, {size.x - 1, size.y - 1}, {33, 31}};
+  for (i32 selection = 0; selection < 3; ++selection) {
+    Canvas canvas{size, type, 3};
+    auto& model = canvas.model;
+    select(model, selection);
+    canvas.fill.set_mode(FillMode::GLOBAL);
+    canvas.fill.set_scope(scope);
+    canvas.fill.set_frame_range(1, -1);
+    // The fill starts from the current cel
+    model.frame_index = 1;
+    model.layer = model.anim.get_layer(1, 0);
+    model.layer.get_rgba8_pixels(canvas.texture.edit_pixels<rgba8>().get_ptr());
+
+    auto expected = get_anim_colors<Color>(model);
+    Color color = model.layer.to_color<Color>(colors[3]);
+    i32 layer_count = model.anim.get_layer_count();
+    for (ivec pos : clicks) {
+      i32 index = pos.x + pos.y * size.x;
+      bool selected = model.select_mask[index];
+      Color old_color = model.layer.get_color<Color>(pos);
+      bool changed = false;
+      for (i32 c = 0; selected && c < (i32)expected.size(); ++c) {
+        i32 frame = c / layer_count;
+        i32 layer = c % layer_count;
+        bool in_scope = scope == FillScope::ALL ||
+                        (layer == 0 && (scope == FillScope::FRAMES
+                                            ? frame >= 1
+                                            : frame == model.frame_index));
+        if (in_scope) {
+          auto before = expected[c];
+          replace_colors(expected[c], model.select_mask, old_color, color);
+          changed = changed || before != expected[c];
+        }
+      }
+
+      u32 flags = canvas.click(pos);
+      u32 snapshot = scope == FillScope::CEL ? event::Flag::SNAPSHOT
+                                             : event::Flag::SNAPSHOT_CELS;
+      REQUIRE(flags == (changed ? snapshot : event::Flag::NONE));
+      REQUIRE(get_anim_colors<Color>(model) == expected);
+      REQUIRE(is_uploaded(canvas));
+    }
+  }
+}
+
+TEST_CASE("Fill: contiguous", "[tool]") {
+  for (ivec size : {ivec{70, 50}, ivec{64, 64}}) {
+    for (auto type : color_types) {
+      draw::visit(type, [&](auto zero) {
+        using Color = decltype(zero);
+        test_scan_fill<Color>(size, type);
+      });
+    }
+  }
+}
+
+TEST_CASE("Fill: full palette", "[tool]") {
+  const ivec size{70, 50};
+  Canvas canvas{size, draw::INDEXED8, 1};
+  auto& model = canvas.model;
+  auto* palette = model.anim.get_palette();
+  for (i32 i = palette->get_count(); i < draw::PALETTE_SIZE; ++i) {
+    (void)palette->get_index(rgba8{(u8)i, 0xf0U, 0xe0U, 0xffU});
+  }
+  REQUIRE(palette->get_count() == draw::PALETTE_SIZE);
+  model.layer.get_rgba8_pixels(canvas.texture.edit_pixels<rgba8>().get_ptr());
+
+  // The color is not in the palette, the layer stores the nearest one
+  REQUIRE(canvas.click({0, 0}) == event::Flag::SNAPSHOT);
+  REQUIRE(palette->get_color(model.layer.get_color<u8>({0, 0})) != colors[3]);
+  REQUIRE(is_uploaded(canvas));
+}
+
+TEST_CASE("Fill: global", "[tool]") {
+  for (ivec size : {ivec{70, 50}, ivec{64, 64}}) {
+    for (auto type : color_types) {
+      for (auto scope : {FillScope::CEL, FillScope::FRAMES, FillScope::ALL}) {
+        draw::visit(type, [&](auto zero) {
+          using Color = decltype(zero);
+          test_replace_fill<Color>(size, type, scope);
+        });
+      }
+    }
+  }
+}
+
+// Pixels of the spans in a size.x * size.y grid, counted once per span
+std::vector<i32>
+get_coverage(const std::vector<Span>& spans, ivec size) noexcept {
+  std::vector<i32> coverage((i64)size.x * size.y, 0);
+  for (const auto& span : spans) {
+    for (i32 x = span.x; x < span.x + span.width; ++x) {
+      ++coverage[x + span.y * size.x];
+    }
+  }
+  return coverage;
+}
+
+// Pixel by pixel stamp of the brush on every point of the line
+std::vector<i32>
+stamp_line(const Brush& brush, ivec start, ivec end, ivec size) noexcept {
+  std::vector<i32> coverage((i64)size.x * size.y, 0);
+  ivec d{std::abs(end.x - start.x), -std::abs(end.y - start.y)};
+  ivec step{start.x < end.x ? 1 : -1, start.y < end.y ? 1 : -1};
+  i32 error = d.x + d.y;
+  ivec pos = start;
+  while (true) {
+    for (const auto& span : brush.get_stamp()) {
+      i32 y = pos.y + span.y;
+      for (i32 x = pos.x + span.x; x < pos.x + span.x + span.width; ++x) {
+        if (x >= 0 && x < size.x && y >= 0 && y < size.y) {
+          coverage[x + y * size.x] = 1;
+        }
+      }
+    }
+    if (pos.x == end.x && pos.y == end.y) {
+      break;
+    }
+
+    i32 error2 = 2 * error;
+    if (error2 >= d.y) {
+      error += d.y;
+      pos.x += step.x;
+    }
+    if (error2 <= d.x) {
+      error += d.x;
+      pos.y += step.y;
+    }
+  }
+  return coverage;
+}
+
+// Whether the spans are inside the canvas, sorted and not touching
+bool is_clipped_and_merged(
+    const std::vector<Span>& spans, ivec size
+) noexcept {
+  for (i32 i = 0; i < (i32)spans.size(); ++i) {
+    const auto& span = spans[i];
+    if (span.width <= 0 || span.x < 0 || span.x + span.width > size.x ||
+        span.y < 0 || span.y >= size.y) {
+      return false;
+    }
+    if (i > 0) {
+      const auto& last = spans[i - 1];
+      if (span.y < last.y ||
+          (span.y == last.y && span.x <= last.x + last.width)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether the pixel is in the stamp of the brush
+bool is_stamped(const Brush& brush, ivec pos) noexcept {
+  for (const auto& span : brush.get_stamp()) {
+    if (span.y == pos.y && pos.x >= span.x && pos.x < span.x + span.width) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TEST_CASE("Brush: circle stamp", "[tool]") {
+  Brush brush{};
+  brush.set_shape(BrushShape::CIRCLE);
+  for (i32 size = 1; size <= 24; ++size) {
+    brush.set_size(size);
+    const auto& stamp = brush.get_stamp();
+    i32 start = -(size / 2);
+    REQUIRE(stamp.size() == (u64)size);
+
+    // Mirrored around the center on both axes and the diagonal, the center
+    // of even sizes is between two pixels
+    bool symmetric = true;
+    for (i32 y = start; y < start + size; ++y) {
+      for (i32 x = start; x < start + size; ++x) {
+        ivec mirror{2 * start + size - 1 - x, 2 * start + size - 1 - y};
+        bool stamped = is_stamped(brush, {x, y});
+        symmetric = symmetric && stamped == is_stamped(brush, {mirror.x, y}) &&
+                    stamped == is_stamped(brush, {x, mirror.y}) &&
+                    stamped == is_stamped(brush, {y, x});
+      }
+    }
+    REQUIRE(symmetric);
+
+    // The middle row is full, the corners are cut once it is big enough
+    REQUIRE(stamp[size / 2].x == start);
+    REQUIRE(stamp[size / 2].width == size);
+    REQUIRE(is_stamped(brush, {start, start}) == (size <= 2));
+  }
+}
+
+TEST_CASE("Brush: custom stamp", "[tool]") {
+  // Rows with gaps, the last row is empty
+  const ivec bitmap_size{5, 4};
+  const std::vector<bool> bitmap{
+      true,  false, true,  false, true,  //
+      false, true,  true,  true,  false, //
+      true,  true,  false, false, true,  //
+      false, false, false, false, false, //
+  };
+  Brush brush{};
+  brush.set_bitmap(bitmap, bitmap_size);
+  REQUIRE(brush.get_shape() == BrushShape::CUSTOM);
+
+  const std::vector<Span> expected{
+      {-2, -2, 1}, {0, -2, 1}, {2, -2, 1}, {-1, -1, 3}, {-2, 0, 2}, {2, 0, 1},
+  };
+  const auto& stamp = brush.get_stamp();
+  REQUIRE(stamp.size() == expected.size());
+  for (i32 i = 0; i < (i32)stamp.size(); ++i) {
+    REQUIRE(stamp[i].x == expected[i].x);
+    REQUIRE(stamp[i].y == expected[i].y);
+    REQUIRE(stamp[i].width == expected[i].width);
+  }
+
+  // Moving by a pixel fills the gaps of the first row, the overlapping spans
+  // are merged. The third row still has a gap
+  const ivec size{20, 10};
+  std::vector<Span> spans{};
+  brush.sweep({5, 5}, {6, 5}, size, spans);
+  REQUIRE(is_clipped_and_merged(spans, size));
+  const std::vector<Span> merged{{3, 3, 6}, {4, 4, 4}, {3, 5, 3}, {7, 5, 2}};
+  REQUIRE(spans.size() == merged.size());
+  for (i32 i = 0; i < (i32)spans.size(); ++i) {
+    REQUIRE(spans[i].x == merged[i].x);
+    REQUIRE(spans[i].y == merged[i].y);
+    REQUIRE(spans[i].width == merged[i].width);
+  }
+  REQUIRE(get_coverage(spans, size) == stamp_line(brush, {5, 5}, {6, 5}, size));
+}
+
+TEST_CASE("Brush: sweep", "[tool]") {
+  const ivec size{40, 30};
+  // Lines inside, across the edges and outside of the canvas
+  const ivec lines[][2] = {
+      {{10, 10}, {10, 10}}, {{3, 4}, {30, 9}},   {{20, 2}, {24, 27}},
+      {{5, 25}, {35, 5}},   {{-6, -4}, {8, 6}},  {{35, 20}, {47, 33}},
+      {{-3, 15}, {44, 15}}, {{12, -8}, {12, 40}}, {{-9, -9}, {-3, -2}},
+  };
+
+  std::vector<Brush> brushes{};
+  for (auto shape : {BrushShape::SQUARE, BrushShape::CIRCLE}) {
+    for (i32 brush_size : {1, 2, 5, 8, 13}) {
+      Brush brush{};
+      brush.set_shape(shape);
+      brush.set_size(brush_size);
+      brushes.push_back(brush);
+    }
+  }
+  Brush custom{};
+  custom.set_bitmap(
+      {true, false, false, true, false, true, true, false, true}, {3, 3}
+  );
+  brushes.push_back(custom);
+
+  std::vector<Span> spans{};
+  for (const auto& brush : brushes) {
+    for (const auto& line : lines) {
+      brush.sweep(line[0], line[1], size, spans);
+      auto coverage = get_coverage(spans, size);
+      // Each pixel under the line is in exactly one span
+      REQUIRE(is_clipped_and_merged(spans, size));
+      REQUIRE(coverage == stamp_line(brush, line[0], line[1], size));
+    }
+  }
+}
+
+TEST_CASE("Draw: full palette", "[tool]") {
+  const ivec size{40, 30};
+  Canvas canvas{size, draw::INDEXED8, 1};
+  auto& model = canvas.model;
+  auto* palette = model.anim.get_palette();
+  for (i32 i = palette->get_count(); i < draw::PALETTE_SIZE; ++i) {
+    (void)palette->get_index(rgba8{(u8)i, 0x10U, 0x20U, 0xffU});
+  }
+  REQUIRE(palette->get_count() == draw::PALETTE_SIZE);
+  model.layer.get_rgba8_pixels(canvas.texture.edit_pixels<rgba8>().get_ptr());
+
+  // Not in the palette, the layer stores the nearest color
+  const rgba8 color{0x7fU, 0xeeU, 0x01U, 0xffU};
+  Brush brush{};
+  brush.set_size(5);
+  std::vector<Span> spans{};
+  brush.sweep({3, 4}, {30, 20}, size, spans);
+  utils::draw_spans(
+      &model.layer, canvas.texture, size, spans, color, model.select_mask
+  );
+  REQUIRE(is_uploaded(canvas));
+  utils::draw_line(
+      &model.layer, canvas.texture, size, {0, 29}, {39, 0}, color,
+      model.select_mask
+  );
+  REQUIRE(is_uploaded(canvas));
+}